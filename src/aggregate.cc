@@ -0,0 +1,97 @@
+#include "aggregate.h"
+
+#include <unordered_map>
+
+#include "base_storage.h"
+
+namespace storage {
+
+namespace {
+
+long Measure(const value_t &value, IndexField measure) {
+    return measure == IndexField::kCountCoins ? value.GetCountCoins()
+                                              : value.GetBirthYear();
+}
+
+// Runs one task per slice of the storage, each filling its own partial
+// table, and merges the partials once all of them are done. Group is the
+// key the partials are hashed on: an interned field is grouped by its
+// address, so a record costs a pointer hash instead of a string hash.
+template <typename Group, typename GroupOf, typename TextOf>
+aggregates_t Aggregated(const BaseStorage &storage, IndexField measure,
+                        ThreadPool &pool, GroupOf group_of, TextOf text_of) {
+    using partial_t = std::unordered_map<Group, Aggregate>;
+    const long now = Data::Now();
+    const auto fill = [&](std::size_t part, std::size_t parts) {
+        partial_t partial;
+        storage.ForEachPart(part, parts,
+                            [&](const key_t &, const value_t &value) {
+                                if (value.IsExpired(now)) return;
+                                partial[group_of(value)].Add(
+                                    Measure(value, measure));
+                            });
+        return partial;
+    };
+    aggregates_t result;
+    const auto merge = [&](const partial_t &partial) {
+        for (const auto &[group, aggregate] : partial)
+            result[text_of(group)].Merge(aggregate);
+    };
+    // A pool task that waited on the pool could wait forever.
+    if (ThreadPool::InWorker()) {
+        merge(fill(0, 1));
+        return result;
+    }
+    const std::size_t parts = std::max<std::size_t>(pool.Size(), 1) * 4;
+    std::vector<std::future<partial_t>> partials;
+    for (std::size_t part = 0; part < parts; ++part)
+        partials.push_back(pool.Submit([&fill, part, parts] {
+            return fill(part, parts);
+        }));
+    for (auto &partial : partials) partial.wait();
+    for (auto &partial : partials) merge(partial.get());
+    return result;
+}
+
+}  // namespace
+
+aggregates_t BaseStorage::GroupBy(IndexField group_by, IndexField measure,
+                                  ThreadPool &pool) const {
+    if (measure != IndexField::kCountCoins &&
+        measure != IndexField::kBirthYear)
+        throw std::invalid_argument("Field Error!");
+    const auto text_of_interned = [](const std::string *text) {
+        return *text;
+    };
+    switch (group_by) {
+        case IndexField::kSurname:
+            return Aggregated<const std::string *>(
+                *this, measure, pool,
+                [](const value_t &value) { return &value.GetSurname(); },
+                text_of_interned);
+        case IndexField::kCity:
+            return Aggregated<const std::string *>(
+                *this, measure, pool,
+                [](const value_t &value) { return &value.GetCity(); },
+                text_of_interned);
+        case IndexField::kName:
+            return Aggregated<std::string>(
+                *this, measure, pool,
+                [](const value_t &value) { return value.GetName(); },
+                [](const std::string &text) { return text; });
+        case IndexField::kBirthYear:
+            return Aggregated<int>(
+                *this, measure, pool,
+                [](const value_t &value) { return value.GetBirthYear(); },
+                [](int year) { return std::to_string(year); });
+        case IndexField::kCountCoins:
+            return Aggregated<long>(
+                *this, measure, pool,
+                [](const value_t &value) { return value.GetCountCoins(); },
+                [](long coins) { return std::to_string(coins); });
+        default:
+            throw std::invalid_argument("Field Error!");
+    }
+}
+
+}  // namespace storage
@@ -0,0 +1,44 @@
+#pragma once
+
+#include <climits>
+#include <map>
+#include <string>
+
+namespace storage {
+
+// Running count, sum, minimum and maximum of one numeric field over a group
+// of records. Partial aggregates of disjoint sets of records merge into the
+// aggregate of their union. The sum is 128 bits wide, so no number of long
+// values that fits in the count can overflow it.
+struct Aggregate {
+    // __extension__ keeps -Wpedantic from flagging the GCC and Clang type.
+    __extension__ using sum_t = __int128;
+
+    unsigned long count = 0;
+    sum_t sum = 0;
+    long min = LONG_MAX;
+    long max = LONG_MIN;
+
+    void Add(long value) {
+        ++count;
+        sum += value;
+        if (value < min) min = value;
+        if (value > max) max = value;
+    }
+    void Merge(const Aggregate &other) {
+        count += other.count;
+        sum += other.sum;
+        if (other.min < min) min = other.min;
+        if (other.max > max) max = other.max;
+    }
+    double Average() const {
+        return count > 0 ? static_cast<double>(sum) / static_cast<double>(count)
+                         : 0;
+    }
+};
+
+// Aggregates by the text of the group field (the year as digits for
+// kBirthYear).
+using aggregates_t = std::map<std::string, Aggregate>;
+
+}  // namespace storage
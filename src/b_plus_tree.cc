@@ -0,0 +1,172 @@
+#include "b_plus_tree.h"
+
+#include <algorithm>
+
+namespace storage {
+
+template <typename Key, typename Value>
+bool BPlusTree::Emplace(Key &&key, Value &&value) {
+    auto iterator = data_.find(key);
+    if (iterator != data_.end()) {
+        if (!iterator.value().IsExpired()) return false;
+        index_.Remove(iterator.key(), iterator.value());
+        iterator.value() = std::forward<Value>(value);
+    } else {
+        iterator =
+            data_.insert(std::forward<Key>(key), std::forward<Value>(value))
+                .first;
+    }
+    expiry_.Add(iterator.key(), iterator.value());
+    index_.Add(iterator.key(), iterator.value());
+    return true;
+}
+
+bool BPlusTree::Set(const key_t &key, const value_t &value) {
+    return Emplace(key, value);
+}
+
+bool BPlusTree::Set(key_t &&key, value_t &&value) {
+    return Emplace(std::move(key), std::move(value));
+}
+
+const value_t *BPlusTree::Lookup(const key_t &key) {
+    auto iterator = data_.find(key);
+    if (iterator == data_.end() || iterator.value().IsExpired())
+        return nullptr;
+    return &iterator.value();
+}
+
+std::optional<value_t> BPlusTree::Get(const key_t &key) {
+    const value_t *value = Lookup(key);
+    if (value == nullptr) return std::nullopt;
+    return *value;
+}
+
+bool BPlusTree::Get(const key_t &key, const reader_t &reader) {
+    const value_t *value = Lookup(key);
+    if (value == nullptr) return false;
+    reader(*value);
+    return true;
+}
+
+bool BPlusTree::Exists(const key_t &key) { return Lookup(key) != nullptr; }
+
+bool BPlusTree::Rename(const key_t &old_key, const key_t &new_key) {
+    if (Lookup(old_key) == nullptr || Exists(new_key)) return false;
+    // Sweeps an expired record under new_key before the move.
+    Del(new_key);
+    auto iterator = data_.find(old_key);
+    value_t value = std::move(iterator.value());
+    expiry_.Remove(old_key);
+    index_.Remove(old_key, value);
+    data_.erase(old_key);
+    iterator = data_.insert(new_key, std::move(value)).first;
+    expiry_.Add(iterator.key(), iterator.value());
+    index_.Add(iterator.key(), iterator.value());
+    return true;
+}
+
+// As in HashTable, an expired record is swept but does not count.
+bool BPlusTree::Del(const key_t &key) {
+    auto iterator = data_.find(key);
+    if (iterator == data_.end()) return false;
+    const bool live = !iterator.value().IsExpired();
+    expiry_.Remove(key);
+    index_.Remove(key, iterator.value());
+    data_.erase(key);
+    return live;
+}
+
+std::vector<key_t> BPlusTree::Keys() const {
+    return CollectKeys([](const value_t &) { return true; }, false);
+}
+
+std::size_t BPlusTree::Size() const { return data_.size(); }
+
+bool BPlusTree::Update(const key_t &key, const optional_value_t &value) {
+    auto iterator = data_.find(key);
+    if (iterator == data_.end() || iterator.value().IsExpired()) return false;
+    ApplyUpdate(key, value, iterator.value(), index_, expiry_);
+    return true;
+}
+
+// Leaves are allocated as the tree grows, so there is nothing to size up
+// front.
+void BPlusTree::Reserve(std::size_t) {}
+
+unsigned int BPlusTree::BulkLoad(std::vector<record_t> &&records,
+                                 ThreadPool &) {
+    return Load(std::move(records));
+}
+
+unsigned int BPlusTree::Load(std::vector<record_t> &&records) {
+    if (!data_.empty()) {
+        unsigned int count = 0;
+        for (auto &[key, value] : records)
+            if (Emplace(std::move(key), std::move(value))) ++count;
+        return count;
+    }
+    // An empty tree is filled bottom-up from the sorted records.
+    data_.assignSorted(SortedByKey(std::move(records)));
+    for (auto it = data_.begin(); it != data_.end(); ++it) {
+        expiry_.Add(it.key(), it.value());
+        index_.Add(it.key(), it.value());
+    }
+    return static_cast<unsigned int>(data_.size());
+}
+
+bool BPlusTree::CreateIndex(IndexField field) {
+    if (!index_.Enable(field)) return false;
+    for (auto it = data_.begin(); it != data_.end(); ++it)
+        index_.Add(it.key(), it.value());
+    return true;
+}
+
+void BPlusTree::ForEach(const visitor_t &visitor) const {
+    for (auto it = data_.begin(); it != data_.end(); ++it)
+        visitor(it.key(), it.value());
+}
+
+void BPlusTree::ForEachPart(std::size_t part, std::size_t parts,
+                            const visitor_t &visitor) const {
+    const auto bounds = data_.split(parts);
+    if (part + 1 >= bounds.size()) return;
+    for (auto it = bounds[part]; it != bounds[part + 1]; ++it)
+        visitor(it.key(), it.value());
+}
+
+unsigned int BPlusTree::Scan(const key_t &from, const key_t &to,
+                             std::size_t limit, const visitor_t &visitor) {
+    unsigned int count = 0;
+    const long now = Data::Now();
+    for (auto it = data_.lower_bound(from);
+         it != data_.end() && (limit == 0 || count < limit); ++it) {
+        if (!to.empty() && !(it.key() < to)) break;
+        if (it.value().IsExpired(now)) continue;
+        visitor(it.key(), it.value());
+        ++count;
+    }
+    return count;
+}
+
+// The cursor is the key to resume at, so it holds whatever is inserted or
+// erased in between.
+std::string BPlusTree::ScanKeys(const std::string &cursor, std::size_t count,
+                                std::vector<key_t> &keys) {
+    const long now = Data::Now();
+    count = std::max<std::size_t>(count, 1);
+    for (auto it = data_.lower_bound(cursor); it != data_.end(); ++it) {
+        if (it.value().IsExpired(now)) continue;
+        if (count-- == 0) return it.key();
+        keys.push_back(it.key());
+    }
+    return key_t();
+}
+
+void BPlusTree::DeleteOldData() { SweepExpired(expiry_); }
+
+std::vector<std::string> BPlusTree::Find(const optional_value_t &value) {
+    return FindLive(index_, value, false);
+}
+
+}  // namespace storage
@@ -0,0 +1,261 @@
+#include "base_storage.h"
+
+#include <algorithm>
+#include <deque>
+#include <iomanip>
+
+namespace storage {
+
+std::string BaseStorage::TTL(const key_t &key) {
+    std::string ttl = "null";
+    Get(key, [&ttl](const value_t &value) {
+        if (const auto left = value.TTL()) ttl = std::to_string(*left);
+    });
+    return ttl;
+}
+
+// The hash engines size their tables for the whole file first; the trees
+// have nothing to reserve and ignore the count.
+unsigned int BaseStorage::Upload(const std::string &filename) {
+    RecordReader reader(filename);
+    Reserve(reader.CountLines());
+    unsigned int count = 0;
+    key_t key;
+    value_t value;
+    while (reader.Next(key, value))
+        if (Set(std::move(key), std::move(value))) ++count;
+    return count;
+}
+
+unsigned int BaseStorage::Export(const std::string &filename) {
+    std::ofstream file(filename);
+    if (!file.is_open()) throw std::invalid_argument("File Error!");
+    return WriteRecords(file);
+}
+
+void BaseStorage::ShowAll() const {
+    BufferedOutput out(std::cout);
+    out << std::setw(5) << "№"
+        << " | " << std::setw(13) << "Фамилия"
+        << " | " << std::setw(13) << "Имя"
+        << " | " << std::setw(5) << "Год"
+        << " | " << std::setw(13) << "Город"
+        << " | " << std::setw(14) << "Количество коинов"
+        << " |\n";
+    PrintRecords(out);
+}
+
+unsigned int BaseStorage::SaveSnapshot(const std::string &filename) const {
+    SnapshotWriter writer(filename);
+    ForEach([&writer](const key_t &key, const value_t &value) {
+        writer.Add(key, value);
+    });
+    return writer.Finish();
+}
+
+// The single-threaded engines cannot be read while the caller goes on
+// writing, so the records are copied up front and only the encoding and
+// disk writes move to the background.
+std::future<unsigned int> BaseStorage::SaveSnapshotAsync(
+    const std::string &filename, std::uint32_t tag) {
+    auto writer = std::make_unique<SnapshotWriter>(filename, tag);
+    const long now = Data::Now();
+    return WriteSnapshotAsync(
+        std::move(writer),
+        MapParts<std::vector<record_t>>(
+            [now](const key_t &key, const value_t &value,
+                  std::vector<record_t> &records) {
+                if (!value.IsExpired(now)) records.emplace_back(key, value);
+            }));
+}
+
+unsigned int BaseStorage::LoadSnapshot(const std::string &filename) {
+    SnapshotReader reader(filename);
+    std::vector<record_t> records(reader.Count());
+    std::size_t loaded = 0;
+    const long now = Data::Now();
+    while (loaded < records.size() &&
+           reader.Next(records[loaded].first, records[loaded].second))
+        if (!records[loaded].second.IsExpired(now)) ++loaded;
+    records.resize(loaded);
+    return BulkLoad(std::move(records), ThreadPool::Shared());
+}
+
+// The sorted slices are merged pairwise, in rounds that halve their count.
+std::vector<key_t> BaseStorage::CollectKeys(
+    const std::function<bool(const value_t &)> &filter, bool sorted) const {
+    const long now = Data::Now();
+    auto parts = MapParts<std::vector<key_t>>(
+        [&](const key_t &key, const value_t &value, std::vector<key_t> &keys) {
+            if (!value.IsExpired(now) && filter(value)) keys.push_back(key);
+        });
+    if (parts.size() == 1) {
+        if (sorted) std::sort(parts.front().begin(), parts.front().end());
+        return std::move(parts.front());
+    }
+    if (sorted) {
+        std::vector<std::future<void>> sorts;
+        for (auto &part : parts)
+            sorts.push_back(ThreadPool::Shared().Submit(
+                [&part] { std::sort(part.begin(), part.end()); }));
+        for (auto &sort : sorts) sort.wait();
+    }
+    std::size_t total = 0;
+    for (const auto &part : parts) total += part.size();
+    std::vector<key_t> keys;
+    keys.reserve(total);
+    std::vector<std::size_t> bounds{0};
+    for (auto &part : parts) {
+        keys.insert(keys.end(), std::make_move_iterator(part.begin()),
+                    std::make_move_iterator(part.end()));
+        bounds.push_back(keys.size());
+    }
+    while (sorted && bounds.size() > 2) {
+        std::vector<std::size_t> next{0};
+        for (std::size_t i = 2; i < bounds.size(); i += 2) {
+            std::inplace_merge(
+                keys.begin() + static_cast<std::ptrdiff_t>(bounds[i - 2]),
+                keys.begin() + static_cast<std::ptrdiff_t>(bounds[i - 1]),
+                keys.begin() + static_cast<std::ptrdiff_t>(bounds[i]));
+            next.push_back(bounds[i]);
+        }
+        if (bounds.size() % 2 == 0) next.push_back(bounds.back());
+        bounds.swap(next);
+    }
+    return keys;
+}
+
+std::vector<key_t> BaseStorage::FindLive(const FieldIndex &index,
+                                         const optional_value_t &value,
+                                         bool sorted) {
+    if (!index.Covers(value))
+        return CollectKeys(
+            [&value](const value_t &data) { return MatchesAny(value, data); },
+            sorted);
+    auto keys = index.Find(value);
+    keys.erase(
+        std::remove_if(keys.begin(), keys.end(),
+                       [this](const key_t &key) { return !Exists(key); }),
+        keys.end());
+    return keys;
+}
+
+// Slices are formatted on the shared pool, at most kPendingParts per worker
+// ahead of the one being written, and each is written out and freed as soon
+// as it and every slice before it are done. Every task is waited for before
+// an error leaves, as in MapParts.
+unsigned int BaseStorage::WriteParts(std::ostream &out,
+                                     const format_t &format) const {
+    ThreadPool &pool = ThreadPool::Shared();
+    unsigned int count = 0;
+    if (RunsSerially(pool)) {
+        ForEach([&](const key_t &key, const value_t &value) {
+            if (format(key, value, out)) ++count;
+        });
+        return count;
+    }
+    struct Formatted {
+        std::stringstream text;
+        unsigned int count = 0;
+    };
+    const std::size_t parts = pool.Size() * 4;
+    const auto submit = [this, &pool, &format, parts](std::size_t part) {
+        return pool.Submit([this, &format, part, parts] {
+            Formatted formatted;
+            ForEachPart(part, parts,
+                        [&](const key_t &key, const value_t &value) {
+                            if (format(key, value, formatted.text))
+                                ++formatted.count;
+                        });
+            return formatted;
+        });
+    };
+    std::deque<std::future<Formatted>> pending;
+    std::size_t next = 0;
+    try {
+        for (; next < parts && pending.size() < kPendingParts * pool.Size();
+             ++next)
+            pending.push_back(submit(next));
+        while (!pending.empty()) {
+            Formatted formatted = pending.front().get();
+            pending.pop_front();
+            if (next < parts) pending.push_back(submit(next++));
+            if (formatted.count > 0) out << formatted.text.rdbuf();
+            count += formatted.count;
+        }
+    } catch (...) {
+        for (auto &future : pending) future.wait();
+        throw;
+    }
+    return count;
+}
+
+unsigned int BaseStorage::WriteRecords(std::ostream &out) const {
+    const long now = Data::Now();
+    return WriteParts(out, [now](const key_t &key, const value_t &value,
+                                 std::ostream &text) {
+        if (value.IsExpired(now)) return false;
+        WriteRecord(text, key, value);
+        return true;
+    });
+}
+
+void BaseStorage::PrintRecords(std::ostream &out) const {
+    WriteParts(out, [](const key_t &key, const value_t &value,
+                       std::ostream &text) {
+        value.Print(key, text);
+        return true;
+    });
+}
+
+bool BaseStorage::MatchesAny(const optional_value_t &query,
+                             const value_t &value) {
+    return (query.surname && value.GetSurname() == *query.surname) ||
+           (query.name && value.GetName() == *query.name) ||
+           (query.birth_year && value.GetBirthYear() == *query.birth_year) ||
+           (query.city && value.GetCity() == *query.city) ||
+           (query.count_coins && value.GetCountCoins() == *query.count_coins);
+}
+
+// Sorting pointers keeps the records themselves from being shuffled
+// around, and the stable sort keeps the first record of each key.
+std::vector<record_t> BaseStorage::SortedByKey(
+    std::vector<record_t> &&records) {
+    std::vector<record_t *> order(records.size());
+    for (std::size_t i = 0; i < records.size(); ++i) order[i] = &records[i];
+    std::stable_sort(order.begin(), order.end(),
+                     [](const record_t *lhs, const record_t *rhs) {
+                         return lhs->first < rhs->first;
+                     });
+    std::vector<record_t> sorted;
+    sorted.reserve(order.size());
+    for (record_t *record : order)
+        if (sorted.empty() || sorted.back().first != record->first)
+            sorted.push_back(std::move(*record));
+    return sorted;
+}
+
+void BaseStorage::ApplyUpdate(const key_t &key,
+                              const optional_value_t &update, value_t &value,
+                              FieldIndex &index, ExpiryIndex &expiry) {
+    index.Remove(key, value);
+    if (update.surname) value.SetSurname(*update.surname);
+    if (update.name) value.SetName(*update.name);
+    if (update.birth_year) value.SetBirthYear(*update.birth_year);
+    if (update.city) value.SetCity(*update.city);
+    if (update.count_coins) value.SetCountCoins(*update.count_coins);
+    if (update.expiry_time) {
+        value.SetTimeLife(*update.expiry_time);
+        expiry.Add(key, value);
+    }
+    index.Add(key, value);
+}
+
+// ExpiryIndex only hands out a key's current expiry, so every entry it
+// pops is a record that is due.
+void BaseStorage::SweepExpired(ExpiryIndex &expiry) {
+    const long now = Data::Now();
+    while (auto entry = expiry.PopDue(now)) Del(entry->second);
+}
+
+}  // namespace storage
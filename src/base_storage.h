@@ -1,17 +1,31 @@
 #pragma once
 #include <fstream>
+#include <functional>
+#include <future>
 #include <iostream>
 #include <list>
 #include <optional>
 #include <sstream>
 #include <vector>
 
+#include "aggregate.h"
+#include "batch.h"
 #include "data.h"
+#include "expiry_index.h"
+#include "field_index.h"
+#include "query.h"
+#include "record_io.h"
+#include "scan.h"
+#include "snapshot.h"
+#include "thread_pool.h"
 
 namespace storage {
 
 using value_t = Data;
 using optional_value_t = OptionalData;
+using reader_t = std::function<void(const value_t &)>;
+using visitor_t = std::function<void(const key_t &, const value_t &)>;
+using record_t = std::pair<key_t, value_t>;
 
 class BaseStorage {
    public:
@@ -19,19 +33,191 @@ class BaseStorage {
     virtual ~BaseStorage() = default;
 
     virtual bool Set(const key_t &key, const value_t &value) = 0;
+    virtual bool Set(key_t &&key, value_t &&value) = 0;
     [[nodiscard]] virtual std::optional<value_t> Get(const key_t &key) = 0;
+    virtual bool Get(const key_t &key, const reader_t &reader) = 0;
     virtual bool Rename(const key_t &old_key, const key_t &new_key) = 0;
     virtual bool Del(const key_t &key) = 0;
     [[nodiscard]] virtual std::vector<key_t> Keys() const = 0;
+    [[nodiscard]] virtual std::size_t Size() const = 0;
     virtual bool Update(const key_t &key, const optional_value_t &value) = 0;
     virtual bool Exists(const key_t &key) = 0;
     [[nodiscard]] virtual std::vector<std::string> Find(
         const optional_value_t &value) = 0;
-    [[nodiscard]] virtual std::string TTL(const key_t &key) = 0;
-    virtual unsigned int Upload(const std::string &filename) = 0;
-    virtual unsigned int Export(const std::string &filename) = 0;
+    // TTL, Upload, Export and ShowAll are written once against Get, Set,
+    // Reserve and the full passes, which is all they need from an engine.
+    [[nodiscard]] std::string TTL(const key_t &key);
+    unsigned int Upload(const std::string &filename);
+    unsigned int Export(const std::string &filename);
+    // Snapshots go through ForEach and come back through BulkLoad, so
+    // every engine shares one format and the bulk-loading path.
+    unsigned int SaveSnapshot(const std::string &filename) const;
+    unsigned int LoadSnapshot(const std::string &filename);
+    // Captures the records as they are now and writes them to a snapshot
+    // with the given tag on a background thread; the storage must outlive
+    // the future. Here the live records are copied in slices on the shared
+    // pool; the concurrent engine freezes its shards instead of copying.
+    virtual std::future<unsigned int> SaveSnapshotAsync(
+        const std::string &filename, std::uint32_t tag);
     virtual void DeleteOldData() = 0;
-    virtual void ShowAll() const = 0;
+    virtual bool CreateIndex(IndexField field) = 0;
+    virtual void Reserve(std::size_t count) = 0;
+    virtual unsigned int BulkLoad(std::vector<record_t> &&records,
+                                  ThreadPool &pool) = 0;
+    void ShowAll() const;
+    virtual void ForEach(const visitor_t &visitor) const = 0;
+    // Visits slice `part` of `parts` disjoint slices that together make up
+    // ForEach, so that several threads can share one pass. The tree engines
+    // slice by key range and visit each slice in key order.
+    virtual void ForEachPart(std::size_t part, std::size_t parts,
+                             const visitor_t &visitor) const = 0;
+    // Visits the live records with from <= key < to in key order, at most
+    // limit of them (0 for no limit); an empty `to` means no upper bound.
+    // Returns the number of records visited. The visitor gets references
+    // into the storage itself and must not modify it: a write can move or
+    // free records still to be visited. Only the concurrent engine hands
+    // out copies, so its visitor may write back.
+    virtual unsigned int Scan(const key_t &from, const key_t &to,
+                              std::size_t limit, const visitor_t &visitor) = 0;
+    unsigned int ScanPrefix(const key_t &prefix, std::size_t limit,
+                            const visitor_t &visitor) {
+        return Scan(prefix, PrefixEnd(prefix), limit, visitor);
+    }
+    // SCAN-style cursor over the live keys: appends about `count` keys and
+    // returns the cursor for the next call, empty once every key was
+    // covered; the first call passes an empty cursor too. A cursor stays
+    // valid while the storage grows or rehashes: every key present for the
+    // whole scan is returned, keys added or removed meanwhile may or may
+    // not be.
+    virtual std::string ScanKeys(const std::string &cursor, std::size_t count,
+                                 std::vector<key_t> &keys) = 0;
+    // Aggregates `measure` (kCountCoins or kBirthYear) over the live
+    // records grouped by the value of `group_by`, in one pass split into
+    // slices that run on the pool (see ForEachPart).
+    [[nodiscard]] aggregates_t GroupBy(IndexField group_by, IndexField measure,
+                                       ThreadPool &pool) const;
+    // Keys of the live records that match the predicate. The compiled plan
+    // runs inside the engine's own pass over the records, or over the
+    // candidates of a secondary index when the plan can use one.
+    [[nodiscard]] std::vector<key_t> Query(const Predicate &predicate) {
+        return Select(QueryPlan(predicate));
+    }
+    [[nodiscard]] virtual std::vector<key_t> Select(const QueryPlan &plan);
+
+    // Batched Get, Set and Del with the same per-key results, in order;
+    // MultiSet and MultiDel return how many keys they stored or removed.
+    // The hash engines hash the whole batch up front and prefetch buckets
+    // ahead of the key being worked on (see Pipelined).
+    [[nodiscard]] virtual std::vector<std::optional<value_t>> MultiGet(
+        const std::vector<key_t> &keys) {
+        std::vector<std::optional<value_t>> values;
+        values.reserve(keys.size());
+        for (const auto &key : keys) values.push_back(Get(key));
+        return values;
+    }
+    virtual unsigned int MultiSet(std::vector<record_t> &&records) {
+        unsigned int count = 0;
+        for (auto &[key, value] : records)
+            if (Set(std::move(key), std::move(value))) ++count;
+        return count;
+    }
+    virtual unsigned int MultiDel(const std::vector<key_t> &keys) {
+        unsigned int count = 0;
+        for (const auto &key : keys)
+            if (Del(key)) ++count;
+        return count;
+    }
+
+   protected:
+    // Below this many records a full pass stays on the calling thread.
+    static constexpr std::size_t kParallelRecords = std::size_t{1} << 14;
+    // Formatted slices a streaming pass lets wait per worker.
+    static constexpr std::size_t kPendingParts = 2;
+
+    // Writes a record to the stream, or skips it and returns false.
+    using format_t = std::function<bool(const key_t &, const value_t &,
+                                        std::ostream &)>;
+
+    // The engine's secondary indexes, for Select to draw candidates from.
+    virtual const FieldIndex *Indexes() const { return nullptr; }
+
+    // Runs visit(key, value, output) over the slices of ForEachPart on the
+    // shared pool, one output per slice, and returns the outputs in slice
+    // order. The visit must be safe to run on several threads at once.
+    template <typename Output, typename Visit>
+    std::vector<Output> MapParts(Visit visit) const;
+    // Full passes built on MapParts for Keys, Find, Export and ShowAll.
+    // CollectKeys returns the live records that pass the
+    // filter. With `sorted`, each slice is sorted on its own thread and the
+    // sorted slices are merged; the tree engines leave it off, as their
+    // slices are key ranges that already come out in order.
+    std::vector<key_t> CollectKeys(
+        const std::function<bool(const value_t &)> &filter,
+        bool sorted) const;
+    // Find from the engine's indexes when they cover the query, dropping
+    // the keys that expired, and from a full pass otherwise.
+    std::vector<key_t> FindLive(const FieldIndex &index,
+                                const optional_value_t &value, bool sorted);
+    // Find's test: the record equals the query on any field it sets.
+    static bool MatchesAny(const optional_value_t &query,
+                           const value_t &value);
+    // For the tree engines, which fill an empty tree bottom-up: the records
+    // sorted by key, keeping the first of several with one key as a run of
+    // Set would.
+    static std::vector<record_t> SortedByKey(std::vector<record_t> &&records);
+    // DeleteOldData for the engines that sweep through Del.
+    void SweepExpired(ExpiryIndex &expiry);
+    // Update once the engine has found the live record: sets the fields
+    // the update carries and refreshes the record's index and expiry
+    // entries.
+    static void ApplyUpdate(const key_t &key, const optional_value_t &update,
+                            value_t &value, FieldIndex &index,
+                            ExpiryIndex &expiry);
+
+   private:
+    // Formats every record to `out` in ForEach order, or slice order when
+    // the slices run on the pool; returns how many were written.
+    unsigned int WriteParts(std::ostream &out, const format_t &format) const;
+    // Writes the live records for Export; returns how many were written.
+    unsigned int WriteRecords(std::ostream &out) const;
+    void PrintRecords(std::ostream &out) const;
+    // Whether a full pass should stay on the calling thread: the storage
+    // is small, the pool has a single worker, or this is one of its tasks.
+    bool RunsSerially(const ThreadPool &pool) const {
+        return Size() < kParallelRecords || pool.Size() < 2 ||
+               ThreadPool::InWorker();
+    }
 };
 
+// Every future is waited for before any result is taken, so that no task
+// outlives the references it holds if one of them threw.
+template <typename Output, typename Visit>
+std::vector<Output> BaseStorage::MapParts(Visit visit) const {
+    ThreadPool &pool = ThreadPool::Shared();
+    std::vector<Output> outputs;
+    if (RunsSerially(pool)) {
+        outputs.emplace_back();
+        ForEach([&](const key_t &key, const value_t &value) {
+            visit(key, value, outputs.back());
+        });
+        return outputs;
+    }
+    const std::size_t parts = pool.Size() * 4;
+    std::vector<std::future<Output>> futures;
+    for (std::size_t part = 0; part < parts; ++part) {
+        futures.push_back(pool.Submit([this, &visit, part, parts] {
+            Output output;
+            ForEachPart(part, parts,
+                        [&](const key_t &key, const value_t &value) {
+                            visit(key, value, output);
+                        });
+            return output;
+        }));
+    }
+    for (auto &future : futures) future.wait();
+    outputs.reserve(parts);
+    for (auto &future : futures) outputs.push_back(future.get());
+    return outputs;
+}
+
 }  // namespace storage
\ No newline at end of file
@@ -0,0 +1,24 @@
+#pragma once
+
+#include <cstddef>
+
+namespace storage {
+
+// Software pipeline for batched operations: step i of `count` is prepared
+// in two prefetch stages that run kBatchDistance and 2 * kBatchDistance
+// steps ahead of it, so the cache misses of several keys are in flight at
+// once. `far` may only touch memory that is cheap to address (a bucket
+// array slot); `near` may read what `far` fetched to find the next line.
+constexpr std::size_t kBatchDistance = 4;
+
+template <typename Far, typename Near, typename Process>
+void Pipelined(std::size_t count, Far far, Near near, Process process) {
+    for (std::size_t i = 0; i < count + 2 * kBatchDistance; ++i) {
+        if (i < count) far(i);
+        if (i >= kBatchDistance && i - kBatchDistance < count)
+            near(i - kBatchDistance);
+        if (i >= 2 * kBatchDistance) process(i - 2 * kBatchDistance);
+    }
+}
+
+}  // namespace storage
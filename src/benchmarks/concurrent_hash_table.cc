@@ -0,0 +1,112 @@
+#include <atomic>
+#include <chrono>
+#include <iomanip>
+#include <iostream>
+#include <mutex>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "../concurrent_hash_table.h"
+
+namespace {
+
+const int kPreloadKeys = 200000;
+const int kOpsPerThread = 200000;
+
+std::atomic<long> checksum{0};
+
+const storage::value_t kRecord("Williams", "Mary", 1982, "Philadelphia",
+                               1234L);
+
+// What callers had to do before: one mutex around a single HashTable.
+class GlobalLockHashTable {
+   public:
+    bool Set(const storage::key_t &key, const storage::value_t &value) {
+        std::lock_guard lock(mutex_);
+        return table_.Set(key, value);
+    }
+    bool Get(const storage::key_t &key, const storage::reader_t &reader) {
+        std::lock_guard lock(mutex_);
+        return table_.Get(key, reader);
+    }
+    bool Del(const storage::key_t &key) {
+        std::lock_guard lock(mutex_);
+        return table_.Del(key);
+    }
+
+   private:
+    std::mutex mutex_;
+    storage::HashTable table_;
+};
+
+std::string MakeKey(unsigned long index) {
+    return "key" + std::to_string(index);
+}
+
+template <typename Table>
+double Run(Table &table, unsigned int threads, int write_percent) {
+    std::atomic<bool> start{false};
+    std::vector<std::thread> workers;
+    for (unsigned int t = 0; t < threads; ++t) {
+        workers.emplace_back([&, t] {
+            std::mt19937 generator(t + 1);
+            std::uniform_int_distribution<unsigned long> keys(
+                0, 2 * kPreloadKeys);
+            std::uniform_int_distribution<int> percent(0, 99);
+            long coins = 0;
+            while (!start.load(std::memory_order_acquire)) {
+            }
+            for (int i = 0; i < kOpsPerThread; ++i) {
+                const std::string key = MakeKey(keys(generator));
+                if (percent(generator) >= write_percent) {
+                    table.Get(key, [&](const storage::value_t &value) {
+                        coins += value.GetCountCoins();
+                    });
+                } else if (i % 2 == 0) {
+                    table.Set(key, kRecord);
+                } else {
+                    table.Del(key);
+                }
+            }
+            checksum += coins;
+        });
+    }
+    const auto begin = std::chrono::steady_clock::now();
+    start.store(true, std::memory_order_release);
+    for (auto &worker : workers) worker.join();
+    const std::chrono::duration<double> elapsed =
+        std::chrono::steady_clock::now() - begin;
+    return threads * static_cast<double>(kOpsPerThread) / elapsed.count();
+}
+
+template <typename Table>
+void Report(const std::string &engine, unsigned int max_threads) {
+    for (int write_percent : {0, 10, 50}) {
+        for (unsigned int threads = 1; threads <= max_threads; threads *= 2) {
+            Table table;
+            for (unsigned long i = 0; i < kPreloadKeys; ++i)
+                table.Set(MakeKey(2 * i), kRecord);
+            const double ops = Run(table, threads, write_percent);
+            std::cout << std::left << std::setw(24) << engine << std::right
+                      << std::setw(8) << write_percent << std::setw(9)
+                      << threads << std::setw(16) << std::fixed
+                      << std::setprecision(0) << ops << std::endl;
+        }
+    }
+}
+
+}  // namespace
+
+int main(int argc, char **argv) {
+    unsigned int max_threads = std::thread::hardware_concurrency();
+    if (argc > 1) max_threads = static_cast<unsigned int>(std::stoul(argv[1]));
+    if (max_threads == 0) max_threads = 1;
+    std::cout << std::left << std::setw(24) << "engine" << std::right
+              << std::setw(8) << "write%" << std::setw(9) << "threads"
+              << std::setw(16) << "ops/sec" << std::endl;
+    Report<GlobalLockHashTable>("HashTable+mutex", max_threads);
+    Report<storage::ConcurrentHashTable>("ConcurrentHashTable", max_threads);
+    return 0;
+}
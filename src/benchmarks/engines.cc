@@ -0,0 +1,185 @@
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <iostream>
+#include <numeric>
+#include <random>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "../controller.h"
+
+// Times every storage operation on every engine, for several key
+// distributions and dataset sizes, and prints one CSV row per measurement:
+//   engine,distribution,size,operation,ops,seconds,ns_per_op,ops_per_sec
+// Usage: bench [size...]; the sizes default to 10000 and 100000.
+
+namespace {
+
+const storage::value_t kRecord("Williams", "Mary", 1982, "Philadelphia",
+                               1234L);
+const char kExportFile[] = "bench_records.txt";
+
+// Keeps the compiler from dropping reads whose results are never used.
+long checksum = 0;
+
+struct Engine {
+    const char *name;
+    storage::TypeHashTable type;
+};
+
+const Engine kEngines[] = {
+    {"HashTable", storage::TypeHashTable::kHashTable},
+    {"SelfBalancingTree", storage::TypeHashTable::kSelfBalancingTree},
+    {"OpenAddressingHashTable",
+     storage::TypeHashTable::kOpenAddressingHashTable},
+    {"ConcurrentHashTable", storage::TypeHashTable::kConcurrentHashTable},
+    {"BPlusTree", storage::TypeHashTable::kBPlusTree},
+};
+
+const char *const kDistributions[] = {"sequential", "random", "zipfian"};
+
+// Fixed width, so that sequential indices are also sequential keys.
+std::string MakeKey(std::size_t index) {
+    char key[24];
+    std::snprintf(key, sizeof(key), "user%012zu", index);
+    return key;
+}
+
+// Order in which an operation touches the `size` preloaded keys. Zipfian
+// draws (s = 0.99) repeat the popular keys, as a cache-heavy workload would.
+std::vector<std::size_t> MakeOrder(const std::string &distribution,
+                                   std::size_t size) {
+    std::vector<std::size_t> order(size);
+    std::mt19937_64 generator(42);
+    if (distribution == "zipfian") {
+        std::vector<double> cdf(size);
+        double total = 0;
+        for (std::size_t i = 0; i < size; ++i)
+            cdf[i] = total += 1.0 / std::pow(static_cast<double>(i + 1), 0.99);
+        std::uniform_real_distribution<double> uniform(0, total);
+        // Rank r goes to a scattered key, so popular keys are not
+        // neighbours in the trees.
+        std::vector<std::size_t> keys(size);
+        std::iota(keys.begin(), keys.end(), 0);
+        std::shuffle(keys.begin(), keys.end(), generator);
+        for (auto &index : order) {
+            const auto rank = static_cast<std::size_t>(
+                std::lower_bound(cdf.begin(), cdf.end(), uniform(generator)) -
+                cdf.begin());
+            index = keys[std::min(rank, size - 1)];
+        }
+        return order;
+    }
+    std::iota(order.begin(), order.end(), 0);
+    if (distribution == "random")
+        std::shuffle(order.begin(), order.end(), generator);
+    return order;
+}
+
+template <typename Operation>
+double Time(Operation operation) {
+    const auto begin = std::chrono::steady_clock::now();
+    operation();
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() -
+                                         begin)
+        .count();
+}
+
+void Emit(const Engine &engine, const std::string &distribution,
+          std::size_t size, const char *operation, std::size_t ops,
+          double seconds) {
+    const double per_op = ops > 0 ? seconds / static_cast<double>(ops) : 0;
+    std::printf("%s,%s,%zu,%s,%zu,%.6f,%.1f,%.0f\n", engine.name,
+                distribution.c_str(), size, operation, ops, seconds,
+                per_op * 1e9, per_op > 0 ? 1 / per_op : 0);
+    std::fflush(stdout);
+}
+
+void Run(const Engine &engine, const std::string &distribution,
+         std::size_t size) {
+    std::vector<std::string> keys(size);
+    for (std::size_t i = 0; i < size; ++i) keys[i] = MakeKey(i);
+    const auto order = MakeOrder(distribution, size);
+    const auto report = [&](const char *operation, std::size_t ops,
+                            double seconds) {
+        Emit(engine, distribution, size, operation, ops, seconds);
+    };
+    const auto each_key = [&](auto operation) {
+        return Time([&] {
+            for (std::size_t index : order) operation(keys[index]);
+        });
+    };
+
+    storage::Controller storage(engine.type);
+    report("Set", size, each_key([&](const std::string &key) {
+               storage.Set(key, kRecord);
+           }));
+    // A zipfian run leaves keys out; the rest of the operations want all.
+    for (const auto &key : keys) storage.Set(key, kRecord);
+    report("Get", size, each_key([&](const std::string &key) {
+               storage.Get(key, [](const storage::value_t &value) {
+                   checksum += value.GetCountCoins();
+               });
+           }));
+    storage::optional_value_t update;
+    update.count_coins = 4321L;
+    report("Update", size, each_key([&](const std::string &key) {
+               storage.Update(key, update);
+           }));
+    const std::size_t scans = 10;
+    storage::optional_value_t filter;
+    filter.city = "Nowhere";
+    report("Find", scans, Time([&] {
+               for (std::size_t i = 0; i < scans; ++i)
+                   checksum += static_cast<long>(storage.Find(filter).size());
+           }));
+    report("Keys", scans, Time([&] {
+               for (std::size_t i = 0; i < scans; ++i)
+                   checksum += static_cast<long>(storage.Keys().size());
+           }));
+    // Zipfian draws repeat keys, and a key renamed or deleted once is gone
+    // the second time, so these count the operations that took effect.
+    std::size_t renamed = 0;
+    const double rename_seconds = each_key([&](const std::string &key) {
+        renamed += storage.Rename(key, key + "r");
+    });
+    report("Rename", renamed, rename_seconds);
+    report("Export", size,
+           Time([&] { checksum += storage.Export(kExportFile); }));
+    std::size_t deleted = 0;
+    const double del_seconds = each_key([&](const std::string &key) {
+        deleted += storage.Del(key + "r");
+    });
+    report("Del", deleted, del_seconds);
+
+    storage::Controller uploaded(engine.type);
+    report("Upload", size,
+           Time([&] { checksum += uploaded.Upload(kExportFile); }));
+    std::remove(kExportFile);
+
+    storage::Controller expiring(engine.type);
+    storage::value_t expired = kRecord;
+    expired.SetExpiryTime(storage::Data::Now() - 1);
+    for (const auto &key : keys) expiring.Set(key, expired);
+    report("DeleteOldData", size, Time([&] { expiring.DeleteOldData(); }));
+}
+
+}  // namespace
+
+int main(int argc, char **argv) {
+    std::vector<std::size_t> sizes;
+    for (int i = 1; i < argc; ++i) sizes.push_back(std::stoul(argv[i]));
+    if (sizes.empty()) sizes = {10000, 100000};
+    std::printf(
+        "engine,distribution,size,operation,ops,seconds,ns_per_op,"
+        "ops_per_sec\n");
+    for (std::size_t size : sizes)
+        for (const auto &engine : kEngines)
+            for (const char *distribution : kDistributions)
+                Run(engine, distribution, size);
+    std::cerr << "checksum " << checksum << '\n';
+    return 0;
+}
@@ -0,0 +1,234 @@
+#include "column_store.h"
+
+#include <algorithm>
+#include <functional>
+
+#if defined(__AVX2__) || defined(__SSE2__)
+#include <immintrin.h>
+#endif
+
+namespace storage {
+
+namespace {
+
+// Each kernel ORs into bitmap bit i for every column[i] == value. The
+// vector steps cover 8 or 4 rows starting at a multiple of that, so their
+// bits never straddle two bitmap words. SSE2 is part of x86-64, so it is
+// the baseline there; building with -mavx2 switches to the wider kernels.
+void MatchEqual(const std::uint32_t *column, std::size_t count,
+                std::uint32_t value, std::uint64_t *bitmap) {
+    std::size_t i = 0;
+#if defined(__AVX2__)
+    const __m256i needle = _mm256_set1_epi32(static_cast<int>(value));
+    for (; i + 8 <= count; i += 8) {
+        const __m256i lanes =
+            _mm256_loadu_si256(reinterpret_cast<const __m256i *>(column + i));
+        const auto mask = static_cast<std::uint64_t>(_mm256_movemask_ps(
+            _mm256_castsi256_ps(_mm256_cmpeq_epi32(lanes, needle))));
+        bitmap[i / 64] |= mask << (i % 64);
+    }
+#elif defined(__SSE2__)
+    const __m128i needle = _mm_set1_epi32(static_cast<int>(value));
+    for (; i + 4 <= count; i += 4) {
+        const __m128i lanes =
+            _mm_loadu_si128(reinterpret_cast<const __m128i *>(column + i));
+        const auto mask = static_cast<std::uint64_t>(
+            _mm_movemask_ps(_mm_castsi128_ps(_mm_cmpeq_epi32(lanes, needle))));
+        bitmap[i / 64] |= mask << (i % 64);
+    }
+#endif
+    for (; i < count; ++i)
+        bitmap[i / 64] |= std::uint64_t{column[i] == value} << (i % 64);
+}
+
+void MatchEqual(const std::uint64_t *column, std::size_t count,
+                std::uint64_t value, std::uint64_t *bitmap) {
+    std::size_t i = 0;
+#if defined(__AVX2__)
+    const __m256i needle =
+        _mm256_set1_epi64x(static_cast<long long>(value));
+    for (; i + 4 <= count; i += 4) {
+        const __m256i lanes =
+            _mm256_loadu_si256(reinterpret_cast<const __m256i *>(column + i));
+        const auto mask = static_cast<std::uint64_t>(_mm256_movemask_pd(
+            _mm256_castsi256_pd(_mm256_cmpeq_epi64(lanes, needle))));
+        bitmap[i / 64] |= mask << (i % 64);
+    }
+#elif defined(__SSE2__)
+    // SSE2 has no 64-bit compare: a lane matches when both of its 32-bit
+    // halves do.
+    const __m128i needle = _mm_set1_epi64x(static_cast<long long>(value));
+    for (; i + 2 <= count; i += 2) {
+        const __m128i lanes =
+            _mm_loadu_si128(reinterpret_cast<const __m128i *>(column + i));
+        const __m128i halves = _mm_cmpeq_epi32(lanes, needle);
+        const __m128i both = _mm_and_si128(
+            halves, _mm_shuffle_epi32(halves, _MM_SHUFFLE(2, 3, 0, 1)));
+        const auto mask = static_cast<std::uint64_t>(
+            _mm_movemask_pd(_mm_castsi128_pd(both)));
+        bitmap[i / 64] |= mask << (i % 64);
+    }
+#endif
+    for (; i < count; ++i)
+        bitmap[i / 64] |= std::uint64_t{column[i] == value} << (i % 64);
+}
+
+void MatchText(const std::unordered_map<std::string, std::uint32_t> &codes,
+               const std::vector<std::uint32_t> &column,
+               const std::string &text, std::uint64_t *bitmap) {
+    auto code = codes.find(text);
+    if (code != codes.end())
+        MatchEqual(column.data(), column.size(), code->second, bitmap);
+}
+
+}  // namespace
+
+std::uint32_t ColumnStore::Encode(Dictionary &dictionary,
+                                  const std::string &text) {
+    auto entry = dictionary.codes.find(text);
+    if (entry == dictionary.codes.end()) {
+        std::uint32_t code;
+        if (dictionary.free.empty()) {
+            code = static_cast<std::uint32_t>(dictionary.uses.size());
+            dictionary.texts.emplace_back();
+            dictionary.uses.emplace_back();
+        } else {
+            code = dictionary.free.back();
+            dictionary.free.pop_back();
+        }
+        entry = dictionary.codes.emplace(text, code).first;
+        dictionary.texts[code] = &entry->first;
+    }
+    ++dictionary.uses[entry->second];
+    return entry->second;
+}
+
+void ColumnStore::Release(Dictionary &dictionary, std::uint32_t code) {
+    if (--dictionary.uses[code] != 0) return;
+    dictionary.codes.erase(*dictionary.texts[code]);
+    dictionary.texts[code] = nullptr;
+    dictionary.free.push_back(code);
+}
+
+std::size_t ColumnStore::Codes() const {
+    return surname_codes_.codes.size() + name_codes_.codes.size() +
+           city_codes_.codes.size();
+}
+
+std::size_t ColumnStore::SlotOf(const key_t &key) const {
+    const std::size_t mask = slots_.size() - 1;
+    std::size_t slot = std::hash<key_t>{}(key) & mask;
+    while (slots_[slot] != kNoRow && keys_[slots_[slot]] != key)
+        slot = (slot + 1) & mask;
+    return slot;
+}
+
+// Backward-shift deletion: each row after the hole that may sit there
+// without passing its home slot moves back into it, so lookups never need
+// tombstones.
+void ColumnStore::EraseSlot(std::size_t slot) {
+    const std::size_t mask = slots_.size() - 1;
+    for (std::size_t next = (slot + 1) & mask; slots_[next] != kNoRow;
+         next = (next + 1) & mask) {
+        const std::size_t home = std::hash<key_t>{}(keys_[slots_[next]]) & mask;
+        if (((next - home) & mask) >= ((next - slot) & mask)) {
+            slots_[slot] = slots_[next];
+            slot = next;
+        }
+    }
+    slots_[slot] = kNoRow;
+}
+
+// Kept at most half full.
+void ColumnStore::Grow() {
+    slots_.assign(std::max<std::size_t>(slots_.size() * 2, 16), kNoRow);
+    for (std::size_t row = 0; row < keys_.size(); ++row)
+        slots_[SlotOf(keys_[row])] = row;
+}
+
+// The new codes are taken before the old ones are released, so a field
+// that keeps its text keeps its code.
+void ColumnStore::Add(const key_t &key, const Data &value) {
+    if ((keys_.size() + 1) * 2 > slots_.size()) Grow();
+    const std::size_t slot = SlotOf(key);
+    const bool added = slots_[slot] == kNoRow;
+    if (added) {
+        slots_[slot] = keys_.size();
+        keys_.push_back(key);
+        surnames_.emplace_back();
+        names_.emplace_back();
+        cities_.emplace_back();
+        birth_years_.emplace_back();
+        count_coins_.emplace_back();
+    }
+    const std::size_t index = slots_[slot];
+    const std::uint32_t surname = Encode(surname_codes_, value.GetSurname());
+    const std::uint32_t name = Encode(name_codes_, value.GetName());
+    const std::uint32_t city = Encode(city_codes_, value.GetCity());
+    if (!added) {
+        Release(surname_codes_, surnames_[index]);
+        Release(name_codes_, names_[index]);
+        Release(city_codes_, cities_[index]);
+    }
+    surnames_[index] = surname;
+    names_[index] = name;
+    cities_[index] = city;
+    birth_years_[index] = static_cast<std::uint32_t>(value.GetBirthYear());
+    count_coins_[index] = static_cast<std::uint64_t>(value.GetCountCoins());
+}
+
+void ColumnStore::Remove(const key_t &key) {
+    if (slots_.empty()) return;
+    const std::size_t slot = SlotOf(key);
+    const std::size_t index = slots_[slot];
+    if (index == kNoRow) return;
+    EraseSlot(slot);
+    Release(surname_codes_, surnames_[index]);
+    Release(name_codes_, names_[index]);
+    Release(city_codes_, cities_[index]);
+    const std::size_t last = keys_.size() - 1;
+    if (index != last) {
+        slots_[SlotOf(keys_[last])] = index;
+        keys_[index] = std::move(keys_[last]);
+        surnames_[index] = surnames_[last];
+        names_[index] = names_[last];
+        cities_[index] = cities_[last];
+        birth_years_[index] = birth_years_[last];
+        count_coins_[index] = count_coins_[last];
+    }
+    keys_.pop_back();
+    surnames_.pop_back();
+    names_.pop_back();
+    cities_.pop_back();
+    birth_years_.pop_back();
+    count_coins_.pop_back();
+}
+
+std::vector<key_t> ColumnStore::Find(const OptionalData &value) const {
+    const std::size_t count = keys_.size();
+    std::vector<std::uint64_t> bitmap((count + 63) / 64);
+    if (value.surname)
+        MatchText(surname_codes_.codes, surnames_, *value.surname,
+                  bitmap.data());
+    if (value.name)
+        MatchText(name_codes_.codes, names_, *value.name, bitmap.data());
+    if (value.city)
+        MatchText(city_codes_.codes, cities_, *value.city, bitmap.data());
+    if (value.birth_year)
+        MatchEqual(birth_years_.data(), count,
+                   static_cast<std::uint32_t>(*value.birth_year),
+                   bitmap.data());
+    if (value.count_coins)
+        MatchEqual(count_coins_.data(), count,
+                   static_cast<std::uint64_t>(*value.count_coins),
+                   bitmap.data());
+    std::vector<key_t> result;
+    for (std::size_t word = 0; word < bitmap.size(); ++word)
+        for (std::uint64_t bits = bitmap[word]; bits != 0; bits &= bits - 1)
+            result.push_back(keys_[word * 64 + static_cast<std::size_t>(
+                                                   __builtin_ctzll(bits))]);
+    std::sort(result.begin(), result.end());
+    return result;
+}
+
+}  // namespace storage
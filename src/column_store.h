@@ -0,0 +1,64 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "data.h"
+
+namespace storage {
+
+// Column-wise shadow copy of the records' fields: one dense array per
+// field, with the text fields dictionary-encoded to 32-bit codes. Find
+// compares whole columns against the query with SIMD kernels that set a
+// bit per matching row, and only then turns the set bits back into keys.
+// A removed row is filled with the last one, so the columns stay dense,
+// and a code is freed for reuse once no row holds it. Rows are found by an
+// open-addressing table of row numbers hashed by key, so each key is
+// stored once, in the key column.
+class ColumnStore {
+   public:
+    // Adding a key that is already stored overwrites its row.
+    void Add(const key_t &key, const Data &value);
+    void Remove(const key_t &key);
+    // Keys whose record matches any field the query sets, sorted.
+    std::vector<key_t> Find(const OptionalData &value) const;
+    std::size_t Size() const { return keys_.size(); }
+    // Distinct texts encoded now, over all the text columns.
+    std::size_t Codes() const;
+
+   private:
+    static constexpr std::size_t kNoRow = static_cast<std::size_t>(-1);
+
+    struct Dictionary {
+        std::unordered_map<std::string, std::uint32_t> codes;
+        // By code: the text, or nullptr once freed, and the rows using it.
+        std::vector<const std::string *> texts;
+        std::vector<std::size_t> uses;
+        std::vector<std::uint32_t> free;
+    };
+
+    // Takes a use of the text's code, giving it one if it has none.
+    static std::uint32_t Encode(Dictionary &dictionary,
+                                const std::string &text);
+    static void Release(Dictionary &dictionary, std::uint32_t code);
+
+    // The slot that holds the key's row, or the empty slot it would take.
+    std::size_t SlotOf(const key_t &key) const;
+    void EraseSlot(std::size_t slot);
+    void Grow();
+
+    std::vector<std::size_t> slots_;
+    std::vector<key_t> keys_;
+    std::vector<std::uint32_t> surnames_;
+    std::vector<std::uint32_t> names_;
+    std::vector<std::uint32_t> cities_;
+    std::vector<std::uint32_t> birth_years_;
+    std::vector<std::uint64_t> count_coins_;
+    Dictionary surname_codes_;
+    Dictionary name_codes_;
+    Dictionary city_codes_;
+};
+
+}  // namespace storage
@@ -0,0 +1,402 @@
+#include "concurrent_hash_table.h"
+
+#include <algorithm>
+#include <exception>
+#include <limits>
+#include <mutex>
+
+namespace storage {
+
+std::size_t ConcurrentHashTable::ShardIndex(std::string_view key) const {
+    return ShardOf(std::hash<std::string_view>{}(key));
+}
+
+// The shard tables pick buckets from the low bits of the same hash, so the
+// shard comes from the high ones to keep the two independent.
+std::size_t ConcurrentHashTable::ShardOf(hash_t hash) {
+    return static_cast<std::size_t>(
+        hash >> (std::numeric_limits<hash_t>::digits - kShardBits));
+}
+
+std::vector<std::size_t> ConcurrentHashTable::GroupByShard(
+    const std::vector<hash_t> &hashes,
+    std::array<std::size_t, kShardCount + 1> &starts) {
+    starts.fill(0);
+    for (hash_t hash : hashes) ++starts[ShardOf(hash) + 1];
+    for (std::size_t shard = 0; shard < kShardCount; ++shard)
+        starts[shard + 1] += starts[shard];
+    std::array<std::size_t, kShardCount> next;
+    std::copy(starts.begin(), starts.end() - 1, next.begin());
+    std::vector<std::size_t> order(hashes.size());
+    for (std::size_t i = 0; i < hashes.size(); ++i)
+        order[next[ShardOf(hashes[i])]++] = i;
+    return order;
+}
+
+void ConcurrentHashTable::Preserve(Shard &shard, const key_t &key) {
+    if (!shard.frozen || shard.before.count(key) != 0) return;
+    const value_t *value = shard.table.Lookup(key);
+    shard.before.emplace(key, value == nullptr ? std::optional<value_t>()
+                                               : std::optional(*value));
+}
+
+bool ConcurrentHashTable::Set(const key_t &key, const value_t &value) {
+    Shard &shard = GetShard(key);
+    std::unique_lock lock(shard.mutex);
+    Preserve(shard, key);
+    return shard.table.Set(key, value);
+}
+
+bool ConcurrentHashTable::Set(key_t &&key, value_t &&value) {
+    Shard &shard = GetShard(key);
+    std::unique_lock lock(shard.mutex);
+    Preserve(shard, key);
+    return shard.table.Set(std::move(key), std::move(value));
+}
+
+std::optional<value_t> ConcurrentHashTable::Get(const key_t &key) {
+    Shard &shard = GetShard(key);
+    std::shared_lock lock(shard.mutex);
+    const value_t *value = shard.table.Lookup(key);
+    if (value == nullptr) return std::nullopt;
+    return *value;
+}
+
+bool ConcurrentHashTable::Get(const key_t &key, const reader_t &reader) {
+    Shard &shard = GetShard(key);
+    std::shared_lock lock(shard.mutex);
+    const value_t *value = shard.table.Lookup(key);
+    if (value == nullptr) return false;
+    reader(*value);
+    return true;
+}
+
+bool ConcurrentHashTable::Exists(const key_t &key) {
+    Shard &shard = GetShard(key);
+    std::shared_lock lock(shard.mutex);
+    return shard.table.Contains(key);
+}
+
+bool ConcurrentHashTable::Del(const key_t &key) {
+    Shard &shard = GetShard(key);
+    std::unique_lock lock(shard.mutex);
+    Preserve(shard, key);
+    return shard.table.Del(key);
+}
+
+bool ConcurrentHashTable::Update(const key_t &key,
+                                 const optional_value_t &value) {
+    Shard &shard = GetShard(key);
+    std::unique_lock lock(shard.mutex);
+    Preserve(shard, key);
+    return shard.table.Update(key, value);
+}
+
+bool ConcurrentHashTable::Rename(const key_t &old_key, const key_t &new_key) {
+    Shard &old_shard = GetShard(old_key);
+    Shard &new_shard = GetShard(new_key);
+    if (&old_shard == &new_shard) {
+        std::unique_lock lock(old_shard.mutex);
+        Preserve(old_shard, old_key);
+        Preserve(old_shard, new_key);
+        return old_shard.table.Rename(old_key, new_key);
+    }
+    std::scoped_lock lock(old_shard.mutex, new_shard.mutex);
+    Preserve(old_shard, old_key);
+    Preserve(new_shard, new_key);
+    if (new_shard.table.Contains(new_key)) return false;
+    auto value = old_shard.table.Take(old_key);
+    if (!value) return false;
+    return new_shard.table.Set(key_t(new_key), std::move(*value));
+}
+
+std::vector<key_t> ConcurrentHashTable::Keys() const {
+    return CollectKeys([](const value_t &) { return true; }, true);
+}
+
+std::size_t ConcurrentHashTable::Size() const {
+    std::size_t size = 0;
+    for (const auto &shard : shards_) {
+        std::shared_lock lock(shard.mutex);
+        size += shard.table.Size();
+    }
+    return size;
+}
+
+std::vector<std::string> ConcurrentHashTable::Find(
+    const optional_value_t &value) {
+    std::vector<std::string> result;
+    for (auto &shard : shards_) {
+        std::shared_lock lock(shard.mutex);
+        auto found = shard.table.Find(value);
+        result.insert(result.end(), std::make_move_iterator(found.begin()),
+                      std::make_move_iterator(found.end()));
+    }
+    std::sort(result.begin(), result.end());
+    return result;
+}
+
+void ConcurrentHashTable::DeleteOldData() {
+    for (auto &shard : shards_) {
+        std::unique_lock lock(shard.mutex);
+        // A snapshot still owed this shard may be older than the expiry
+        // being cleaned up; the next pass gets it.
+        if (shard.frozen) continue;
+        shard.table.DeleteOldData();
+    }
+}
+
+bool ConcurrentHashTable::CreateIndex(IndexField field) {
+    bool created = false;
+    for (auto &shard : shards_) {
+        std::unique_lock lock(shard.mutex);
+        created = shard.table.CreateIndex(field) || created;
+    }
+    return created;
+}
+
+void ConcurrentHashTable::Reserve(std::size_t count) {
+    const std::size_t per_shard = count / kShardCount + 1;
+    for (auto &shard : shards_) {
+        std::unique_lock lock(shard.mutex);
+        shard.table.Reserve(per_shard);
+    }
+}
+
+unsigned int ConcurrentHashTable::BulkLoad(std::vector<record_t> &&records,
+                                           ThreadPool &pool) {
+    std::array<std::vector<record_t>, kShardCount> parts;
+    for (auto &record : records)
+        parts[ShardIndex(record.first)].push_back(std::move(record));
+    const auto load = [this, &parts, &pool](std::size_t i) {
+        std::unique_lock lock(shards_[i].mutex);
+        for (const auto &record : parts[i]) Preserve(shards_[i], record.first);
+        return shards_[i].table.BulkLoad(std::move(parts[i]), pool);
+    };
+    unsigned int count = 0;
+    // A pool task that waited on the pool could wait forever.
+    if (ThreadPool::InWorker()) {
+        for (std::size_t i = 0; i < kShardCount; ++i) count += load(i);
+        return count;
+    }
+    std::vector<std::future<unsigned int>> loaded;
+    loaded.reserve(kShardCount);
+    for (std::size_t i = 0; i < kShardCount; ++i)
+        loaded.push_back(pool.Submit([&load, i] { return load(i); }));
+    // Every shard is waited for before any result is taken, so that no task
+    // outlives `parts` or keeps its shard locked if another one threw.
+    for (auto &shard_count : loaded) shard_count.wait();
+    for (auto &shard_count : loaded) count += shard_count.get();
+    return count;
+}
+
+std::vector<record_t> ConcurrentHashTable::Thaw(Shard &shard) {
+    std::vector<record_t> records;
+    std::unique_lock lock(shard.mutex);
+    shard.table.ForEach([&](const key_t &key, const value_t &value) {
+        if (shard.before.count(key) == 0) records.emplace_back(key, value);
+    });
+    for (auto &[key, value] : shard.before)
+        if (value) records.emplace_back(key, std::move(*value));
+    shard.before.clear();
+    shard.frozen = false;
+    return records;
+}
+
+// Freezing every shard under all the locks at once is what makes the
+// snapshot a single point in time. After that each shard is locked only
+// while its records are copied out, so writers wait for one shard's copy
+// at most and never for the disk.
+std::future<unsigned int> ConcurrentHashTable::SaveSnapshotAsync(
+    const std::string &filename, std::uint32_t tag) {
+    if (snapshot_running_.exchange(true))
+        throw std::invalid_argument("Snapshot Error!");
+    std::shared_ptr<SnapshotWriter> writer;
+    try {
+        writer = std::make_shared<SnapshotWriter>(filename, tag);
+    } catch (...) {
+        snapshot_running_ = false;
+        throw;
+    }
+    {
+        std::array<std::unique_lock<std::shared_mutex>, kShardCount> locks;
+        for (std::size_t i = 0; i < kShardCount; ++i) {
+            locks[i] = std::unique_lock(shards_[i].mutex);
+            shards_[i].frozen = true;
+        }
+    }
+    return std::async(std::launch::async, [this, writer] {
+        std::size_t next = 0;
+        try {
+            for (; next < kShardCount; ++next)
+                for (const auto &[key, value] : Thaw(shards_[next]))
+                    writer->Add(key, value);
+            const unsigned int count = writer->Finish();
+            snapshot_running_ = false;
+            return count;
+        } catch (...) {
+            for (; next < kShardCount; ++next) Thaw(shards_[next]);
+            snapshot_running_ = false;
+            throw;
+        }
+    });
+}
+
+void ConcurrentHashTable::ForEach(const visitor_t &visitor) const {
+    for (const auto &shard : shards_) {
+        std::shared_lock lock(shard.mutex);
+        shard.table.ForEach(visitor);
+    }
+}
+
+// Each shard answers from its own indexes, or scans itself, under a
+// shared lock.
+std::vector<key_t> ConcurrentHashTable::Select(const QueryPlan &plan) {
+    std::vector<key_t> keys;
+    for (auto &shard : shards_) {
+        std::shared_lock lock(shard.mutex);
+        auto found = shard.table.Select(plan);
+        keys.insert(keys.end(), std::make_move_iterator(found.begin()),
+                    std::make_move_iterator(found.end()));
+    }
+    return keys;
+}
+
+// With more parts than shards, each shard is cut into as many pieces as it
+// takes to go round, and a part gets a run of those pieces.
+void ConcurrentHashTable::ForEachPart(std::size_t part, std::size_t parts,
+                                      const visitor_t &visitor) const {
+    const std::size_t pieces = (parts + kShardCount - 1) / kShardCount;
+    const auto [first, last] = PartRange(part, parts, kShardCount * pieces);
+    for (std::size_t i = first; i < last; ++i) {
+        const Shard &shard = shards_[i / pieces];
+        std::shared_lock lock(shard.mutex);
+        shard.table.ForEachPart(i % pieces, pieces, visitor);
+    }
+}
+
+// The records in range are copied out one shard at a time, so the visitor
+// runs with no lock held and may write back to the storage.
+unsigned int ConcurrentHashTable::Scan(const key_t &from, const key_t &to,
+                                       std::size_t limit,
+                                       const visitor_t &visitor) {
+    std::vector<record_t> records;
+    const long now = Data::Now();
+    ForEach([&](const key_t &key, const value_t &value) {
+        if (InRange(key, from, to) && !value.IsExpired(now))
+            records.emplace_back(key, value);
+    });
+    std::vector<std::pair<const key_t *, const value_t *>> found;
+    found.reserve(records.size());
+    for (const auto &[key, value] : records) found.emplace_back(&key, &value);
+    return VisitSorted(found, limit, visitor);
+}
+
+// The cursor keeps the shard in its low kShardBits and the position inside
+// the shard's table above them.
+std::string ConcurrentHashTable::ScanKeys(const std::string &cursor,
+                                          std::size_t count,
+                                          std::vector<key_t> &keys) {
+    std::uint64_t position = DecodeCursor(cursor);
+    std::size_t shard = position & (kShardCount - 1);
+    std::uint64_t bucket = position >> kShardBits;
+    const std::size_t target = keys.size() + std::max<std::size_t>(count, 1);
+    while (keys.size() < target) {
+        {
+            std::shared_lock lock(shards_[shard].mutex);
+            bucket = shards_[shard].table.ScanBuckets(
+                bucket, target - keys.size(),
+                [&keys](const key_t &key, const value_t &) {
+                    keys.push_back(key);
+                });
+        }
+        if (bucket != 0) continue;
+        if (++shard == kShardCount) return EncodeCursor(0);
+    }
+    return EncodeCursor((bucket << kShardBits) | shard);
+}
+
+// A batch is grouped by shard so that each shard is locked once for all
+// of its keys, which then go through the shard table's prefetch pipeline.
+std::vector<std::optional<value_t>> ConcurrentHashTable::MultiGet(
+    const std::vector<key_t> &keys) {
+    std::vector<hash_t> hashes(keys.size());
+    for (std::size_t i = 0; i < keys.size(); ++i)
+        hashes[i] = std::hash<std::string_view>{}(keys[i]);
+    std::array<std::size_t, kShardCount + 1> starts;
+    const auto order = GroupByShard(hashes, starts);
+    std::vector<std::optional<value_t>> values(keys.size());
+    for (std::size_t s = 0; s < kShardCount; ++s) {
+        if (starts[s] == starts[s + 1]) continue;
+        const std::size_t *batch = order.data() + starts[s];
+        const HashTable &table = shards_[s].table;
+        std::shared_lock lock(shards_[s].mutex);
+        Pipelined(
+            starts[s + 1] - starts[s],
+            [&](std::size_t i) { table.PrefetchBucket(hashes[batch[i]]); },
+            [&](std::size_t i) { table.PrefetchEntry(hashes[batch[i]]); },
+            [&](std::size_t i) {
+                const std::size_t k = batch[i];
+                if (const value_t *value = table.Lookup(keys[k], hashes[k]))
+                    values[k] = *value;
+            });
+    }
+    return values;
+}
+
+unsigned int ConcurrentHashTable::MultiSet(std::vector<record_t> &&records) {
+    std::vector<hash_t> hashes(records.size());
+    for (std::size_t i = 0; i < records.size(); ++i)
+        hashes[i] = std::hash<std::string_view>{}(records[i].first);
+    std::array<std::size_t, kShardCount + 1> starts;
+    const auto order = GroupByShard(hashes, starts);
+    unsigned int count = 0;
+    for (std::size_t s = 0; s < kShardCount; ++s) {
+        if (starts[s] == starts[s + 1]) continue;
+        const std::size_t *batch = order.data() + starts[s];
+        Shard &shard = shards_[s];
+        HashTable &table = shard.table;
+        std::unique_lock lock(shard.mutex);
+        table.Reserve(starts[s + 1] - starts[s]);
+        Pipelined(
+            starts[s + 1] - starts[s],
+            [&](std::size_t i) { table.PrefetchBucket(hashes[batch[i]]); },
+            [&](std::size_t i) { table.PrefetchEntry(hashes[batch[i]]); },
+            [&](std::size_t i) {
+                auto &[key, value] = records[batch[i]];
+                Preserve(shard, key);
+                if (table.Set(std::move(key), std::move(value),
+                              hashes[batch[i]]))
+                    ++count;
+            });
+    }
+    return count;
+}
+
+unsigned int ConcurrentHashTable::MultiDel(const std::vector<key_t> &keys) {
+    std::vector<hash_t> hashes(keys.size());
+    for (std::size_t i = 0; i < keys.size(); ++i)
+        hashes[i] = std::hash<std::string_view>{}(keys[i]);
+    std::array<std::size_t, kShardCount + 1> starts;
+    const auto order = GroupByShard(hashes, starts);
+    unsigned int count = 0;
+    for (std::size_t s = 0; s < kShardCount; ++s) {
+        if (starts[s] == starts[s + 1]) continue;
+        const std::size_t *batch = order.data() + starts[s];
+        Shard &shard = shards_[s];
+        HashTable &table = shard.table;
+        std::unique_lock lock(shard.mutex);
+        Pipelined(
+            starts[s + 1] - starts[s],
+            [&](std::size_t i) { table.PrefetchBucket(hashes[batch[i]]); },
+            [&](std::size_t i) { table.PrefetchEntry(hashes[batch[i]]); },
+            [&](std::size_t i) {
+                const key_t &key = keys[batch[i]];
+                Preserve(shard, key);
+                if (table.Del(key, hashes[batch[i]])) ++count;
+            });
+    }
+    return count;
+}
+
+}  // namespace storage
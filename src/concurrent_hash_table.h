@@ -0,0 +1,88 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <shared_mutex>
+#include <unordered_map>
+
+#include "hash_table.h"
+
+namespace storage {
+
+// Lock-striped engine: keys are spread over independent HashTable shards by
+// the top bits of their hash, and each shard has its own reader/writer lock.
+// A shard grows incrementally under its own lock, so a resize never stalls
+// the other shards.
+class ConcurrentHashTable : public BaseStorage {
+   public:
+    ConcurrentHashTable() = default;
+    ConcurrentHashTable(const ConcurrentHashTable &other) = delete;
+    ConcurrentHashTable(const ConcurrentHashTable &&other) = delete;
+    ConcurrentHashTable &operator=(const ConcurrentHashTable &other) = delete;
+    ~ConcurrentHashTable() = default;
+
+    bool Set(const key_t &key, const value_t &value) override final;
+    bool Set(key_t &&key, value_t &&value) override final;
+    std::optional<value_t> Get(const key_t &key) override final;
+    bool Get(const key_t &key, const reader_t &reader) override final;
+    bool Rename(const key_t &old_key, const key_t &new_key) override final;
+    bool Del(const key_t &key) override final;
+    std::vector<key_t> Keys() const override final;
+    std::size_t Size() const override final;
+    bool Update(const key_t &key, const optional_value_t &value) override final;
+    bool Exists(const key_t &key) override final;
+    std::vector<std::string> Find(const optional_value_t &value) override final;
+    std::future<unsigned int> SaveSnapshotAsync(
+        const std::string &filename, std::uint32_t tag) override final;
+    void ForEach(const visitor_t &visitor) const override final;
+    void ForEachPart(std::size_t part, std::size_t parts,
+                     const visitor_t &visitor) const override final;
+    unsigned int Scan(const key_t &from, const key_t &to, std::size_t limit,
+                      const visitor_t &visitor) override final;
+    std::string ScanKeys(const std::string &cursor, std::size_t count,
+                         std::vector<key_t> &keys) override final;
+    std::vector<std::optional<value_t>> MultiGet(
+        const std::vector<key_t> &keys) override final;
+    unsigned int MultiSet(std::vector<record_t> &&records) override final;
+    unsigned int MultiDel(const std::vector<key_t> &keys) override final;
+    std::vector<key_t> Select(const QueryPlan &plan) override final;
+    void DeleteOldData() override final;
+    bool CreateIndex(IndexField field) override final;
+    void Reserve(std::size_t count) override final;
+    unsigned int BulkLoad(std::vector<record_t> &&records,
+                          ThreadPool &pool) override final;
+
+   private:
+    static constexpr unsigned int kShardBits = 6;
+    static constexpr std::size_t kShardCount = std::size_t{1} << kShardBits;
+
+    // While a background snapshot has not reached a shard, the shard is
+    // frozen: the first write to a key keeps the record as it was when the
+    // snapshot began (nothing if the key did not exist), and the snapshot
+    // reads those in place of the live records.
+    struct Shard {
+        mutable std::shared_mutex mutex;
+        HashTable table;
+        bool frozen = false;
+        std::unordered_map<key_t, std::optional<value_t>> before;
+    };
+
+    std::size_t ShardIndex(std::string_view key) const;
+    static std::size_t ShardOf(hash_t hash);
+    // Counting sort of a batch by shard: shard s gets the batch positions
+    // order[starts[s]] up to order[starts[s + 1]], in batch order.
+    static std::vector<std::size_t> GroupByShard(
+        const std::vector<hash_t> &hashes,
+        std::array<std::size_t, kShardCount + 1> &starts);
+    Shard &GetShard(std::string_view key) {
+        return shards_[ShardIndex(key)];
+    }
+    // Called under the shard's unique lock before the key is changed.
+    static void Preserve(Shard &shard, const key_t &key);
+    static std::vector<record_t> Thaw(Shard &shard);
+
+    std::array<Shard, kShardCount> shards_;
+    std::atomic<bool> snapshot_running_{false};
+};
+
+}  // namespace storage
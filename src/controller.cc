@@ -1,5 +1,11 @@
 #include "controller.h"
 
+#include <algorithm>
+#include <cstdio>
+#include <deque>
+#include <fstream>
+#include <iterator>
+
 namespace storage {
 
 Controller::Controller(TypeHashTable type) {
@@ -7,35 +13,145 @@ Controller::Controller(TypeHashTable type) {
         key_value_storage_ = std::make_unique<HashTable>();
     } else if (type == TypeHashTable::kSelfBalancingTree) {
         key_value_storage_ = std::make_unique<SelfBalancingBinarySearchTree>();
+    } else if (type == TypeHashTable::kOpenAddressingHashTable) {
+        key_value_storage_ = std::make_unique<OpenAddressingHashTable>();
+    } else if (type == TypeHashTable::kConcurrentHashTable) {
+        key_value_storage_ = std::make_unique<ConcurrentHashTable>();
+    } else if (type == TypeHashTable::kBPlusTree) {
+        key_value_storage_ = std::make_unique<BPlusTree>();
     }
+    ordered_ = type == TypeHashTable::kSelfBalancingTree ||
+               type == TypeHashTable::kBPlusTree;
+}
+
+Controller::~Controller() {
+    if (snapshot_.valid()) snapshot_.wait();
+}
+
+std::size_t Controller::LogStripe(const key_t &key) const {
+    return std::hash<key_t>{}(key) % kLogStripes;
+}
+
+// Writes to the same key hold the same stripe while they are applied and
+// appended, so they reach the log in the order they hit the storage. The
+// wait for the disk happens after the locks are released, which lets the
+// log batch the fsync with other writers.
+template <typename Operation>
+bool Controller::Logged(std::size_t stripe, std::size_t other_stripe,
+                        const std::string &entry, Operation operation) {
+    std::uint64_t sequence;
+    {
+        std::shared_lock checkpoint(checkpoint_mutex_);
+        std::unique_lock first(log_stripes_[std::min(stripe, other_stripe)]);
+        std::unique_lock<std::mutex> second;
+        if (stripe != other_stripe)
+            second = std::unique_lock(
+                log_stripes_[std::max(stripe, other_stripe)]);
+        if (!operation()) return false;
+        sequence = log_->Append(entry);
+    }
+    log_->WaitDurable(sequence);
+    return true;
 }
 
 bool Controller::Set(const key_t &key, const value_t &value) {
-    return key_value_storage_->Set(key, value);
+    if (!log_) return key_value_storage_->Set(key, value);
+    const std::size_t stripe = LogStripe(key);
+    return Logged(stripe, stripe, LogEntry::EncodeSet(key, value),
+                  [&] { return key_value_storage_->Set(key, value); });
+}
+
+bool Controller::Set(key_t &&key, value_t &&value) {
+    if (!log_) return key_value_storage_->Set(std::move(key), std::move(value));
+    const std::size_t stripe = LogStripe(key);
+    return Logged(stripe, stripe, LogEntry::EncodeSet(key, value), [&] {
+        return key_value_storage_->Set(std::move(key), std::move(value));
+    });
 }
 
 std::optional<value_t> Controller::Get(const key_t &key) {
     return key_value_storage_->Get(key);
 }
 
+bool Controller::Get(const key_t &key, const reader_t &reader) {
+    return key_value_storage_->Get(key, reader);
+}
+
 bool Controller::Rename(const key_t &old_key, const key_t &new_key) {
-    return key_value_storage_->Rename(old_key, new_key);
+    if (!log_) return key_value_storage_->Rename(old_key, new_key);
+    return Logged(LogStripe(old_key), LogStripe(new_key),
+                  LogEntry::EncodeRename(old_key, new_key),
+                  [&] { return key_value_storage_->Rename(old_key, new_key); });
 }
 
-bool Controller::Del(const key_t &key) { return key_value_storage_->Del(key); }
+bool Controller::Del(const key_t &key) {
+    if (!log_) return key_value_storage_->Del(key);
+    const std::size_t stripe = LogStripe(key);
+    return Logged(stripe, stripe, LogEntry::EncodeDel(key),
+                  [&] { return key_value_storage_->Del(key); });
+}
 
 std::vector<key_t> Controller::Keys() const {
     return key_value_storage_->Keys();
 }
 
 bool Controller::Update(const key_t &key, const optional_value_t &value) {
-    return key_value_storage_->Update(key, value);
+    if (!log_) return key_value_storage_->Update(key, value);
+    const std::size_t stripe = LogStripe(key);
+    return Logged(stripe, stripe, LogEntry::EncodeUpdate(key, value),
+                  [&] { return key_value_storage_->Update(key, value); });
 }
 
 bool Controller::Exists(const key_t &key) {
     return key_value_storage_->Exists(key);
 }
 
+std::vector<std::optional<value_t>> Controller::MultiGet(
+    const std::vector<key_t> &keys) {
+    return key_value_storage_->MultiGet(keys);
+}
+
+// Each write of a batch goes through its stripe like a single one, but the
+// whole batch waits for only the last of its log entries to reach disk.
+template <typename Operation>
+unsigned int Controller::LoggedBatch(std::size_t count, Operation operation) {
+    unsigned int done = 0;
+    std::uint64_t sequence = 0;
+    {
+        std::shared_lock checkpoint(checkpoint_mutex_);
+        for (std::size_t i = 0; i < count; ++i) {
+            if (const auto appended = operation(i)) {
+                sequence = *appended;
+                ++done;
+            }
+        }
+    }
+    if (done > 0) log_->WaitDurable(sequence);
+    return done;
+}
+
+unsigned int Controller::MultiSet(std::vector<record_t> &&records) {
+    if (!log_) return key_value_storage_->MultiSet(std::move(records));
+    return LoggedBatch(records.size(), [&](std::size_t i) {
+        auto &[key, value] = records[i];
+        std::lock_guard stripe(log_stripes_[LogStripe(key)]);
+        std::string entry = LogEntry::EncodeSet(key, value);
+        if (!key_value_storage_->Set(std::move(key), std::move(value)))
+            return std::optional<std::uint64_t>();
+        return std::optional(log_->Append(entry));
+    });
+}
+
+unsigned int Controller::MultiDel(const std::vector<key_t> &keys) {
+    if (!log_) return key_value_storage_->MultiDel(keys);
+    return LoggedBatch(keys.size(), [&](std::size_t i) {
+        std::lock_guard stripe(log_stripes_[LogStripe(keys[i])]);
+        if (!key_value_storage_->Del(keys[i]))
+            return std::optional<std::uint64_t>();
+        return std::optional(log_->Append(LogEntry::EncodeDel(keys[i])));
+    });
+}
+
 std::vector<std::string> Controller::Find(const optional_value_t &value) {
     return key_value_storage_->Find(value);
 }
@@ -48,12 +164,72 @@ unsigned int Controller::Upload(const std::string &filename) {
     unsigned int str_cout = 0;
     try {
         str_cout = key_value_storage_->Upload(filename);
+        if (log_) Checkpoint();
     } catch (const std::invalid_argument &e) {
         std::cerr << e.what() << '\n';
     }
     return str_cout;
 }
 
+// Chunks are parsed on the pool at most two per thread ahead of the one
+// being loaded, and each is loaded as soon as it is ready, in file order,
+// so duplicate keys resolve the same way as in a sequential Upload and no
+// more than the window is held in memory at once. An empty tree only gets
+// its sorted bulk build from a single BulkLoad, so there the chunks are
+// gathered, still in file order, and loaded together at the end.
+UploadStats Controller::UploadParallel(const std::string &filename,
+                                       std::size_t threads) {
+    UploadStats stats;
+    const auto start = std::chrono::steady_clock::now();
+    try {
+        RecordReader reader(filename);
+        ThreadPool pool(threads);
+        const std::size_t lines = reader.CountLines();
+        key_value_storage_->Reserve(lines);
+        const auto chunks = reader.Split(pool.Size() * kUploadChunks);
+        const auto parse = [&pool](std::string_view chunk) {
+            return pool.Submit([chunk]() mutable {
+                const auto lines = std::count(chunk.begin(), chunk.end(), '\n');
+                std::vector<record_t> records;
+                records.reserve(static_cast<std::size_t>(lines) + 1);
+                record_t record;
+                while (RecordReader::Next(chunk, record.first, record.second))
+                    records.push_back(std::move(record));
+                return records;
+            });
+        };
+        const bool gather = ordered_ && key_value_storage_->Size() == 0;
+        std::vector<record_t> gathered;
+        if (gather) gathered.reserve(lines);
+        std::deque<std::future<std::vector<record_t>>> parsed;
+        std::size_t next = 0;
+        for (; next < chunks.size() && parsed.size() < 2 * pool.Size(); ++next)
+            parsed.push_back(parse(chunks[next]));
+        while (!parsed.empty()) {
+            std::vector<record_t> records = parsed.front().get();
+            parsed.pop_front();
+            if (next < chunks.size()) parsed.push_back(parse(chunks[next++]));
+            if (gather)
+                gathered.insert(gathered.end(),
+                                std::make_move_iterator(records.begin()),
+                                std::make_move_iterator(records.end()));
+            else
+                stats.records +=
+                    key_value_storage_->BulkLoad(std::move(records), pool);
+        }
+        if (gather)
+            stats.records +=
+                key_value_storage_->BulkLoad(std::move(gathered), pool);
+        if (log_) Checkpoint();
+    } catch (const std::invalid_argument &e) {
+        std::cerr << e.what() << '\n';
+    }
+    stats.seconds = std::chrono::duration<double>(
+                        std::chrono::steady_clock::now() - start)
+                        .count();
+    return stats;
+}
+
 unsigned int Controller::Export(const std::string &filename) {
     unsigned int str_cout = 0;
     try {
@@ -64,8 +240,182 @@ unsigned int Controller::Export(const std::string &filename) {
     return str_cout;
 }
 
+unsigned int Controller::SaveSnapshot(const std::string &filename) {
+    unsigned int count = 0;
+    try {
+        count = key_value_storage_->SaveSnapshot(filename);
+    } catch (const std::invalid_argument &e) {
+        std::cerr << e.what() << '\n';
+    }
+    return count;
+}
+
+unsigned int Controller::LoadSnapshot(const std::string &filename) {
+    unsigned int count = 0;
+    try {
+        count = key_value_storage_->LoadSnapshot(filename);
+        if (log_) Checkpoint();
+    } catch (const std::invalid_argument &e) {
+        std::cerr << e.what() << '\n';
+    }
+    return count;
+}
+
+std::shared_future<unsigned int> Controller::SaveSnapshotAsync(
+    const std::string &filename) {
+    std::lock_guard lock(snapshot_mutex_);
+    if (snapshot_.valid()) snapshot_.wait();
+    snapshot_ = key_value_storage_->SaveSnapshotAsync(filename, 0).share();
+    return snapshot_;
+}
+
+unsigned int Controller::Scan(const key_t &from, const key_t &to,
+                              std::size_t limit, const visitor_t &visitor) {
+    return key_value_storage_->Scan(from, to, limit, visitor);
+}
+
+unsigned int Controller::ScanPrefix(const key_t &prefix, std::size_t limit,
+                                    const visitor_t &visitor) {
+    return key_value_storage_->ScanPrefix(prefix, limit, visitor);
+}
+
+std::string Controller::ScanKeys(const std::string &cursor, std::size_t count,
+                                 std::vector<key_t> &keys) {
+    return key_value_storage_->ScanKeys(cursor, count, keys);
+}
+
+std::vector<key_t> Controller::Query(const Predicate &predicate) {
+    return key_value_storage_->Query(predicate);
+}
+
+aggregates_t Controller::GroupBy(IndexField group_by,
+                                 IndexField measure) const {
+    return key_value_storage_->GroupBy(group_by, measure,
+                                       ThreadPool::Shared());
+}
+
 void Controller::DeleteOldData() { key_value_storage_->DeleteOldData(); }
 
+bool Controller::CreateIndex(IndexField field) {
+    return key_value_storage_->CreateIndex(field);
+}
+
+unsigned int Controller::EnableLog(const std::string &log_path,
+                                   const std::string &snapshot_path,
+                                   WalOptions options) {
+    std::uint32_t generation = 0;
+    if (std::ifstream(snapshot_path).is_open()) {
+        generation = SnapshotReader::ReadTag(snapshot_path);
+        key_value_storage_->LoadSnapshot(snapshot_path);
+    }
+    const auto apply = [this](LogEntry &entry) { Apply(entry); };
+    // The log kept by a background checkpoint whose snapshot was never
+    // saved goes first; the current log then starts one generation later.
+    const std::string old_log_path = log_path + ".old";
+    unsigned int replayed = 0;
+    const auto old_generation =
+        WriteAheadLog::Replay(old_log_path, generation, apply, replayed);
+    if (old_generation && *old_generation > generation)
+        throw std::invalid_argument("Log Error!");
+    if (old_generation == generation)
+        ++generation;
+    else
+        std::remove(old_log_path.c_str());
+    unsigned int replayed_current = 0;
+    const auto log_generation =
+        WriteAheadLog::Replay(log_path, generation, apply, replayed_current);
+    replayed += replayed_current;
+    // A log older than the snapshot was already folded into it by a
+    // checkpoint that stopped before starting the log over.
+    if (log_generation && *log_generation > generation)
+        throw std::invalid_argument("Log Error!");
+    if (log_generation != generation)
+        WriteAheadLog::Create(log_path, generation);
+    log_ = std::make_unique<WriteAheadLog>(log_path, options);
+    snapshot_path_ = snapshot_path;
+    old_log_path_ = old_log_path;
+    log_generation_ = generation;
+    return replayed;
+}
+
+void Controller::Apply(LogEntry &entry) {
+    switch (entry.op) {
+        case LogOp::kSet:
+            key_value_storage_->Set(std::move(entry.key),
+                                    std::move(entry.value));
+            break;
+        case LogOp::kUpdate:
+            if (entry.expiry)
+                entry.update.expiry_time = static_cast<unsigned long>(
+                    std::max(*entry.expiry - Data::Now(), 0L));
+            key_value_storage_->Update(entry.key, entry.update);
+            break;
+        case LogOp::kDel:
+            key_value_storage_->Del(entry.key);
+            break;
+        case LogOp::kRename:
+            key_value_storage_->Rename(entry.key, entry.new_key);
+            break;
+    }
+}
+
+unsigned int Controller::Checkpoint() {
+    if (!log_) return 0;
+    std::lock_guard lock(snapshot_mutex_);
+    if (snapshot_.valid()) snapshot_.wait();
+    return WriteCheckpoint();
+}
+
+unsigned int Controller::WriteCheckpoint() {
+    std::unique_lock lock(checkpoint_mutex_);
+    SnapshotWriter writer(snapshot_path_, log_generation_ + 1);
+    key_value_storage_->ForEach([&writer](const key_t &key,
+                                          const value_t &value) {
+        writer.Add(key, value);
+    });
+    const unsigned int count = writer.Finish();
+    log_->Reset(++log_generation_);
+    std::remove(old_log_path_.c_str());
+    return count;
+}
+
+// The log is started over and the records captured under one exclusive
+// lock, so the snapshot holds exactly what the old log led up to. A kept
+// log left by a checkpoint that failed cannot be set aside again without
+// losing it, so a full checkpoint folds it in instead.
+std::shared_future<unsigned int> Controller::CheckpointAsync() {
+    if (!log_) throw std::invalid_argument("Log Error!");
+    std::lock_guard snapshot_lock(snapshot_mutex_);
+    if (snapshot_.valid()) snapshot_.wait();
+    if (std::ifstream(old_log_path_).is_open()) {
+        std::promise<unsigned int> saved;
+        saved.set_value(WriteCheckpoint());
+        snapshot_ = saved.get_future().share();
+        return snapshot_;
+    }
+    std::future<unsigned int> saved;
+    {
+        std::unique_lock lock(checkpoint_mutex_);
+        log_->Reset(++log_generation_, old_log_path_);
+        saved = key_value_storage_->SaveSnapshotAsync(snapshot_path_,
+                                                      log_generation_);
+    }
+    const std::string old_log_path = old_log_path_;
+    snapshot_ =
+        std::async(std::launch::async,
+                   [saved = std::move(saved), old_log_path]() mutable {
+                       const unsigned int count = saved.get();
+                       std::remove(old_log_path.c_str());
+                       return count;
+                   })
+            .share();
+    return snapshot_;
+}
+
+void Controller::SyncLog() {
+    if (log_) log_->Sync();
+}
+
 void Controller::ShowAll() const { key_value_storage_->ShowAll(); }
 
 }  // namespace storage
\ No newline at end of file
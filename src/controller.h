@@ -1,12 +1,39 @@
 #pragma once
 
+#include <array>
+#include <chrono>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <shared_mutex>
+#include <thread>
+
+#include "b_plus_tree.h"
 #include "base_storage.h"
+#include "concurrent_hash_table.h"
 #include "hash_table.h"
+#include "open_addressing_hash_table.h"
 #include "self_balancing_binary_search_tree.h"
+#include "write_ahead_log.h"
 
 namespace storage {
 
-enum class TypeHashTable { kHashTable = 0, kSelfBalancingTree };
+enum class TypeHashTable {
+    kHashTable = 0,
+    kSelfBalancingTree,
+    kOpenAddressingHashTable,
+    kConcurrentHashTable,
+    kBPlusTree
+};
+
+struct UploadStats {
+    unsigned int records = 0;
+    double seconds = 0;
+    double RecordsPerSecond() const {
+        return seconds > 0 ? records / seconds : 0;
+    }
+};
+
 class Controller {
    public:
     explicit Controller(TypeHashTable type = TypeHashTable::kHashTable);
@@ -14,24 +41,105 @@ class Controller {
     Controller(const Controller &&) = delete;
     Controller &operator=(const Controller &) = delete;
     Controller &operator=(const Controller &&) = delete;
-    ~Controller() = default;
+    ~Controller();
 
     bool Set(const key_t &key, const value_t &value);
+    bool Set(key_t &&key, value_t &&value);
     [[nodiscard]] std::optional<value_t> Get(const key_t &key);
+    bool Get(const key_t &key, const reader_t &reader);
     bool Rename(const key_t &old_key, const key_t &new_key);
     bool Del(const key_t &key);
     [[nodiscard]] std::vector<key_t> Keys() const;
     bool Update(const key_t &key, const optional_value_t &value);
     bool Exists(const key_t &key);
+    // Batched Get, Set and Del; see BaseStorage::MultiGet. With the log
+    // enabled a batch still logs every write but waits for the disk once.
+    [[nodiscard]] std::vector<std::optional<value_t>> MultiGet(
+        const std::vector<key_t> &keys);
+    unsigned int MultiSet(std::vector<record_t> &&records);
+    unsigned int MultiDel(const std::vector<key_t> &keys);
     [[nodiscard]] std::vector<std::string> Find(const optional_value_t &value);
     [[nodiscard]] std::string TTL(const key_t &key);
     unsigned int Upload(const std::string &filename);
+    UploadStats UploadParallel(
+        const std::string &filename,
+        std::size_t threads = std::thread::hardware_concurrency());
     unsigned int Export(const std::string &filename);
+    unsigned int SaveSnapshot(const std::string &filename);
+    unsigned int LoadSnapshot(const std::string &filename);
+    // Writes a point-in-time snapshot on a background thread while the
+    // storage goes on serving. The future yields the number of records
+    // saved; errors are thrown here or from the future, not printed.
+    std::shared_future<unsigned int> SaveSnapshotAsync(
+        const std::string &filename);
+    // Ordered range scan over [from, to); see BaseStorage::Scan. The tree
+    // engines descend straight to `from`, the hash engines gather and sort.
+    unsigned int Scan(const key_t &from, const key_t &to, std::size_t limit,
+                      const visitor_t &visitor);
+    unsigned int ScanPrefix(const key_t &prefix, std::size_t limit,
+                            const visitor_t &visitor);
+    // Resumable cursor over the keys; see BaseStorage::ScanKeys. Prefer it
+    // to Keys() on large storages, which copies every key at once.
+    std::string ScanKeys(const std::string &cursor, std::size_t count,
+                         std::vector<key_t> &keys);
+    // Keys of the live records matching the predicate; see
+    // BaseStorage::Query.
+    [[nodiscard]] std::vector<key_t> Query(const Predicate &predicate);
+    // Per-group count, sum, min, max and average of `measure` over the live
+    // records, on the shared pool; see BaseStorage::GroupBy. Throws
+    // std::invalid_argument for a field that cannot be grouped or measured.
+    [[nodiscard]] aggregates_t GroupBy(IndexField group_by,
+                                       IndexField measure) const;
     void ShowAll() const;
     void DeleteOldData();
+    bool CreateIndex(IndexField field);
+
+    // Loads snapshot_path if it exists, replays log_path on top of it and
+    // from then on logs every Set, Update, Del and Rename made through this
+    // controller; bulk loads checkpoint instead of logging each record.
+    // Returns the number of replayed entries. Meant to be called once,
+    // before the controller is shared; throws std::invalid_argument when a
+    // file cannot be read or written.
+    unsigned int EnableLog(const std::string &log_path,
+                           const std::string &snapshot_path,
+                           WalOptions options = WalOptions());
+    // Saves a snapshot and starts the log over; returns the records saved.
+    unsigned int Checkpoint();
+    // Checkpoint with the snapshot written in the background, as in
+    // SaveSnapshotAsync. The log starts over at once; what it held is kept
+    // next to it under a ".old" suffix until the snapshot is saved, and is
+    // replayed first by EnableLog if it never was. Throws
+    // std::invalid_argument when the log is not enabled.
+    std::shared_future<unsigned int> CheckpointAsync();
+    void SyncLog();
 
    private:
+    static constexpr std::size_t kLogStripes = 64;
+    // UploadParallel cuts the file into this many chunks per thread, so
+    // loading the first chunks overlaps parsing the rest.
+    static constexpr std::size_t kUploadChunks = 8;
+
+    std::size_t LogStripe(const key_t &key) const;
+    template <typename Operation>
+    bool Logged(std::size_t stripe, std::size_t other_stripe,
+                const std::string &entry, Operation operation);
+    template <typename Operation>
+    unsigned int LoggedBatch(std::size_t count, Operation operation);
+    void Apply(LogEntry &entry);
+    // Checkpoint for a caller that holds snapshot_mutex_.
+    unsigned int WriteCheckpoint();
+
     std::unique_ptr<BaseStorage> key_value_storage_;
+    // The tree engines, which build an empty tree in one sorted pass.
+    bool ordered_ = false;
+    std::mutex snapshot_mutex_;
+    std::shared_future<unsigned int> snapshot_;
+    std::unique_ptr<WriteAheadLog> log_;
+    std::string snapshot_path_;
+    std::string old_log_path_;
+    std::uint32_t log_generation_ = 0;
+    std::shared_mutex checkpoint_mutex_;
+    std::array<std::mutex, kLogStripes> log_stripes_;
 };
 
 }  // namespace storage
\ No newline at end of file
@@ -3,51 +3,71 @@
 #include <chrono>
 #include <iomanip>
 #include <iostream>
+#include <limits>
 #include <optional>
 #include <string>
 
+#include "string_pool.h"
+
 namespace storage {
 
 using key_t = std::string;
 using hash_t = unsigned long;
 
+// A record is kept compact: surname and city are interned in the
+// StringPool, so a record holds a pointer to a shared copy, and the expiry
+// is one absolute time in seconds with kNoExpiry standing for none. The
+// name stays a std::string, which holds short names inline.
 class Data {
    public:
     Data() = default;
-    Data(const std::string &surname, const std::string &name, int birth_year,
-         const std::string &city, long count_coins,
+    Data(std::string surname, std::string name, int birth_year,
+         std::string city, long count_coins,
          std::optional<unsigned long> time_life = std::nullopt);
-    Data(const Data &other);
-    Data(const Data &&other) { (*this) = std::move(other); }
-    Data &operator=(const Data &other);
+    Data(const Data &other) = default;
+    Data(Data &&other) noexcept = default;
+    Data &operator=(const Data &other) = default;
+    Data &operator=(Data &&other) noexcept = default;
     bool operator==(const storage::Data &other) const;
 
     ~Data() = default;
 
-    std::string GetSurname() const { return surname_; }
-    void SetSurname(const std::string &surname) { surname_ = surname; }
-    std::string GetName() const { return name_; }
-    void SetName(const std::string &name) { name_ = name; }
+    const std::string &GetSurname() const { return *surname_; }
+    void SetSurname(std::string surname) {
+        surname_ = StringPool::Intern(surname);
+    }
+    const std::string &GetName() const { return name_; }
+    void SetName(std::string name) { name_ = std::move(name); }
     int GetBirthYear() const { return birth_year_; }
     void SetBirthYear(int birth_year) { birth_year_ = birth_year; }
     long GetCountCoins() const { return count_coins_; }
     void SetCountCoins(long count_coins) { count_coins_ = count_coins; }
-    std::optional<long> GetTimeLife() const { return expiry_time_; }
+    std::optional<long> GetTimeLife() const {
+        if (expiry_time_ == kNoExpiry) return std::nullopt;
+        return expiry_time_;
+    }
     std::optional<long> TTL() const;
+    bool IsExpired() const;
+    bool IsExpired(long now) const { return expiry_time_ <= now; }
+    static long Now();
     void SetTimeLife(unsigned long time_life);
-    std::string GetCity() const { return city_; }
-    void SetCity(const std::string &city) { city_ = city; }
+    void SetExpiryTime(std::optional<long> expiry_time) {
+        expiry_time_ = expiry_time.value_or(kNoExpiry);
+    }
+    const std::string &GetCity() const { return *city_; }
+    void SetCity(std::string city) { city_ = StringPool::Intern(city); }
     void Clear();
-    void Print(const key_t &key) const;
+    void Print(const key_t &key, std::ostream &out = std::cout) const;
 
    private:
-    std::string surname_;
+    static constexpr long kNoExpiry = std::numeric_limits<long>::max();
+
     std::string name_;
-    int birth_year_;
-    std::string city_;
-    long count_coins_;
-    std::chrono::time_point<std::chrono::system_clock> created_time_;
-    std::optional<unsigned long> expiry_time_;
+    const std::string *surname_ = StringPool::Empty();
+    const std::string *city_ = StringPool::Empty();
+    long count_coins_ = 0;
+    long expiry_time_ = kNoExpiry;
+    int birth_year_ = 0;
 };
 
 struct OptionalData {
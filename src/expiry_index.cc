@@ -0,0 +1,51 @@
+#include "expiry_index.h"
+
+namespace storage {
+
+void ExpiryIndex::Add(const key_t &key, const Data &value) {
+    const std::optional<long> expiry = value.GetTimeLife();
+    if (!expiry) {
+        Remove(key);
+        return;
+    }
+    auto [current, inserted] = current_.try_emplace(key, *expiry);
+    if (!inserted) {
+        if (current->second == *expiry) return;
+        current->second = *expiry;
+    }
+    heap_.emplace(*expiry, key);
+    CompactIfStale();
+}
+
+void ExpiryIndex::Remove(const key_t &key) {
+    if (current_.erase(key) != 0) CompactIfStale();
+}
+
+std::optional<ExpiryIndex::entry_t> ExpiryIndex::PopDue(long now) {
+    while (!heap_.empty() && heap_.top().first <= now) {
+        entry_t entry = heap_.top();
+        heap_.pop();
+        const auto current = current_.find(entry.second);
+        if (current == current_.end() || current->second != entry.first)
+            continue;
+        current_.erase(current);
+        return entry;
+    }
+    return std::nullopt;
+}
+
+void ExpiryIndex::Clear() {
+    heap_ = decltype(heap_)();
+    current_.clear();
+}
+
+void ExpiryIndex::CompactIfStale() {
+    if (heap_.size() <= 2 * current_.size() + kSlack) return;
+    std::vector<entry_t> entries;
+    entries.reserve(current_.size());
+    for (const auto &[key, expiry] : current_)
+        entries.emplace_back(expiry, key);
+    heap_ = decltype(heap_)(std::greater<entry_t>(), std::move(entries));
+}
+
+}  // namespace storage
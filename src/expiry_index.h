@@ -0,0 +1,44 @@
+#pragma once
+
+#include <functional>
+#include <optional>
+#include <queue>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "data.h"
+
+namespace storage {
+
+// Min-heap of (expiry time, key) for the records that carry a TTL, so
+// DeleteOldData only looks at keys that are actually due. The current
+// expiry of each key is kept beside the heap: an entry superseded by a new
+// TTL, a delete or a rename is skipped when it comes due, and the heap is
+// rebuilt from the current expiries once superseded entries make up most
+// of it, so repeated TTL updates do not grow it without bound.
+class ExpiryIndex {
+   public:
+    using entry_t = std::pair<long, key_t>;
+
+    // Sets the key's expiry to the value's, replacing any earlier one; a
+    // value without a TTL removes the key.
+    void Add(const key_t &key, const Data &value);
+    void Remove(const key_t &key);
+    std::optional<entry_t> PopDue(long now);
+    bool Empty() const { return current_.empty(); }
+    std::size_t Size() const { return current_.size(); }
+    void Clear();
+
+   private:
+    // Superseded entries tolerated on top of one per current expiry.
+    static constexpr std::size_t kSlack = 64;
+
+    void CompactIfStale();
+
+    std::priority_queue<entry_t, std::vector<entry_t>, std::greater<entry_t>>
+        heap_;
+    std::unordered_map<key_t, long> current_;
+};
+
+}  // namespace storage
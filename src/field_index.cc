@@ -0,0 +1,158 @@
+#include "field_index.h"
+
+#include <algorithm>
+
+namespace storage {
+
+bool FieldIndex::Enable(IndexField field) {
+    switch (field) {
+        case IndexField::kSurname:
+            if (surname_) return false;
+            surname_.emplace();
+            break;
+        case IndexField::kName:
+            if (name_) return false;
+            name_.emplace();
+            break;
+        case IndexField::kCity:
+            if (city_) return false;
+            city_.emplace();
+            break;
+        case IndexField::kBirthYear:
+            if (birth_year_) return false;
+            birth_year_.emplace();
+            break;
+        case IndexField::kCountCoins:
+            if (count_coins_) return false;
+            count_coins_.emplace();
+            break;
+        case IndexField::kColumns:
+            if (columns_) return false;
+            columns_.emplace();
+            break;
+    }
+    return true;
+}
+
+bool FieldIndex::IsEnabled(IndexField field) const {
+    switch (field) {
+        case IndexField::kSurname:
+            return surname_.has_value();
+        case IndexField::kName:
+            return name_.has_value();
+        case IndexField::kCity:
+            return city_.has_value();
+        case IndexField::kBirthYear:
+            return birth_year_.has_value();
+        case IndexField::kCountCoins:
+            return count_coins_.has_value();
+        case IndexField::kColumns:
+            return columns_.has_value();
+    }
+    return false;
+}
+
+bool FieldIndex::Empty() const {
+    return !surname_ && !name_ && !city_ && !birth_year_ && !count_coins_ &&
+           !columns_;
+}
+
+bool FieldIndex::Covers(const OptionalData &value) const {
+    if (!value.surname && !value.name && !value.city && !value.birth_year &&
+        !value.count_coins)
+        return false;
+    return columns_ || IndexesCover(value);
+}
+
+bool FieldIndex::IndexesCover(const OptionalData &value) const {
+    return (!value.surname || surname_) && (!value.name || name_) &&
+           (!value.city || city_) && (!value.birth_year || birth_year_) &&
+           (!value.count_coins || count_coins_);
+}
+
+void FieldIndex::Add(hash_index_t &index, const std::string &field,
+                     const key_t &key) {
+    index[field].insert(key);
+}
+
+void FieldIndex::Remove(hash_index_t &index, const std::string &field,
+                        const key_t &key) {
+    auto keys = index.find(field);
+    if (keys == index.end()) return;
+    keys->second.erase(key);
+    if (keys->second.empty()) index.erase(keys);
+}
+
+void FieldIndex::Add(const key_t &key, const Data &value) {
+    if (surname_) Add(*surname_, value.GetSurname(), key);
+    if (name_) Add(*name_, value.GetName(), key);
+    if (city_) Add(*city_, value.GetCity(), key);
+    if (birth_year_) birth_year_->emplace(value.GetBirthYear(), key);
+    if (count_coins_) count_coins_->emplace(value.GetCountCoins(), key);
+    if (columns_) columns_->Add(key, value);
+}
+
+void FieldIndex::Remove(const key_t &key, const Data &value) {
+    if (surname_) Remove(*surname_, value.GetSurname(), key);
+    if (name_) Remove(*name_, value.GetName(), key);
+    if (city_) Remove(*city_, value.GetCity(), key);
+    if (birth_year_) birth_year_->erase({value.GetBirthYear(), key});
+    if (count_coins_) count_coins_->erase({value.GetCountCoins(), key});
+    if (columns_) columns_->Remove(key);
+}
+
+void FieldIndex::Collect(const hash_index_t &index, const std::string &field,
+                         std::vector<key_t> &result) {
+    auto keys = index.find(field);
+    if (keys != index.end())
+        result.insert(result.end(), keys->second.begin(), keys->second.end());
+}
+
+void FieldIndex::Collect(const ordered_index_t &index, long field,
+                         std::vector<key_t> &result) {
+    for (auto it = index.lower_bound({field, key_t()});
+         it != index.end() && it->first == field; ++it)
+        result.push_back(it->second);
+}
+
+bool FieldIndex::Match(IndexField field, const std::string &text,
+                       std::vector<key_t> &keys) const {
+    const std::optional<hash_index_t> *index = nullptr;
+    if (field == IndexField::kSurname) index = &surname_;
+    if (field == IndexField::kName) index = &name_;
+    if (field == IndexField::kCity) index = &city_;
+    if (index == nullptr || !*index) return false;
+    Collect(**index, text, keys);
+    return true;
+}
+
+bool FieldIndex::MatchRange(IndexField field, long low, long high,
+                            std::vector<key_t> &keys) const {
+    const std::optional<ordered_index_t> *index = nullptr;
+    if (field == IndexField::kBirthYear) index = &birth_year_;
+    if (field == IndexField::kCountCoins) index = &count_coins_;
+    if (index == nullptr || !*index) return false;
+    for (auto it = (*index)->lower_bound({low, key_t()});
+         it != (*index)->end() && it->first <= high; ++it)
+        keys.push_back(it->second);
+    return true;
+}
+
+std::vector<key_t> FieldIndex::Find(const OptionalData &value) const {
+    // A hash or ordered index only visits the matches, so it is preferred
+    // over a full column scan whenever it can answer the query.
+    if (columns_ && !IndexesCover(value)) return columns_->Find(value);
+    std::vector<key_t> result;
+    if (value.surname && surname_) Collect(*surname_, *value.surname, result);
+    if (value.name && name_) Collect(*name_, *value.name, result);
+    if (value.city && city_) Collect(*city_, *value.city, result);
+    if (value.birth_year && birth_year_)
+        Collect(*birth_year_, *value.birth_year, result);
+    if (value.count_coins && count_coins_)
+        Collect(*count_coins_, *value.count_coins, result);
+    std::sort(result.begin(), result.end());
+    result.erase(std::unique(result.begin(), result.end()), result.end());
+    return result;
+}
+
+}  // namespace storage
@@ -0,0 +1,72 @@
+#pragma once
+
+#include <optional>
+#include <set>
+#include <unordered_map>
+#include <unordered_set>
+#include <utility>
+#include <vector>
+
+#include "column_store.h"
+#include "data.h"
+
+namespace storage {
+
+// kColumns is not one field but a ColumnStore over all of them, which
+// answers any query with a vectorized scan.
+enum class IndexField {
+    kSurname,
+    kName,
+    kBirthYear,
+    kCity,
+    kCountCoins,
+    kColumns
+};
+
+// Optional secondary indexes over the Data fields. Text fields get a hash
+// index, numeric fields an ordered one. An engine reports every record it
+// stores or drops through Add/Remove, and Find answers a query from the
+// indexes when every field the query sets is indexed, or from the column
+// store when there is one.
+class FieldIndex {
+   public:
+    bool Enable(IndexField field);
+    bool IsEnabled(IndexField field) const;
+    bool Empty() const;
+    bool Covers(const OptionalData &value) const;
+
+    void Add(const key_t &key, const Data &value);
+    void Remove(const key_t &key, const Data &value);
+    std::vector<key_t> Find(const OptionalData &value) const;
+    // Append the keys whose text field equals text, or whose numeric field
+    // lies in [low, high]; false, with nothing added, when the field has
+    // no index of its own.
+    bool Match(IndexField field, const std::string &text,
+               std::vector<key_t> &keys) const;
+    bool MatchRange(IndexField field, long low, long high,
+                    std::vector<key_t> &keys) const;
+
+   private:
+    using hash_index_t =
+        std::unordered_map<std::string, std::unordered_set<key_t>>;
+    using ordered_index_t = std::set<std::pair<long, key_t>>;
+
+    bool IndexesCover(const OptionalData &value) const;
+    static void Add(hash_index_t &index, const std::string &field,
+                    const key_t &key);
+    static void Remove(hash_index_t &index, const std::string &field,
+                       const key_t &key);
+    static void Collect(const hash_index_t &index, const std::string &field,
+                        std::vector<key_t> &result);
+    static void Collect(const ordered_index_t &index, long field,
+                        std::vector<key_t> &result);
+
+    std::optional<hash_index_t> surname_;
+    std::optional<hash_index_t> name_;
+    std::optional<hash_index_t> city_;
+    std::optional<ordered_index_t> birth_year_;
+    std::optional<ordered_index_t> count_coins_;
+    std::optional<ColumnStore> columns_;
+};
+
+}  // namespace storage
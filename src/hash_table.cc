@@ -3,199 +3,356 @@
 #include <algorithm>
 namespace storage {
 
-HashTable::HashTable() : size_(10), count_structs_(0) {
-    data_.resize(size_, std::list<std::pair<key_t, value_t>>{});
+HashTable::HashTable()
+    : size_(kInitialSize),
+      count_structs_(0),
+      rehash_index_(0),
+      reserved_(0) {
+    data_.resize(size_, bucket_t{});
 }
 
-hash_t HashTable::GetHash(const key_t &key) const {
-    return std::hash<std::string>{}(key) % size_;
+hash_t HashTable::GetHash(std::string_view key) const {
+    return std::hash<std::string_view>{}(key);
 }
 
-bool HashTable::Exists(const key_t &key) {
-    hash_t index = GetHash(key);
-    return std::any_of(data_[index].begin(), data_[index].end(),
-                       [&](const auto &elm) { return elm.first == key; });
+HashTable::Slot HashTable::FindSlot(std::string_view key, hash_t hash) {
+    auto matches = [&](const auto &elm) { return elm.first == key; };
+    auto &bucket = data_[hash % size_];
+    auto entry = std::find_if(bucket.begin(), bucket.end(), matches);
+    if (entry != bucket.end() || !IsRehashing()) return {&bucket, entry};
+    auto &old_bucket = old_data_[hash % old_data_.size()];
+    auto old_entry = std::find_if(old_bucket.begin(), old_bucket.end(), matches);
+    if (old_entry != old_bucket.end()) return {&old_bucket, old_entry};
+    return {&bucket, entry};
 }
 
-void HashTable::Rehash() {
-    size_ *= 2;
-    std::vector<std::list<std::pair<key_t, value_t>>> new_data(
-        size_, std::list<std::pair<key_t, value_t>>{});
-    for (auto &list : data_) {
-        for (auto &[key, value] : list) {
-            const auto new_hash = GetHash(key);
-            auto &new_list = new_data[new_hash];
-            new_list.emplace_back(key, value);
+bool HashTable::Contains(std::string_view key) const {
+    return Lookup(key) != nullptr;
+}
+
+const value_t *HashTable::Lookup(std::string_view key, hash_t hash) const {
+    for (const auto &[current_key, value] : data_[hash % size_])
+        if (current_key == key) return value.IsExpired() ? nullptr : &value;
+    if (IsRehashing())
+        for (const auto &[current_key, value] :
+             old_data_[hash % old_data_.size()])
+            if (current_key == key)
+                return value.IsExpired() ? nullptr : &value;
+    return nullptr;
+}
+
+bool HashTable::Exists(const key_t &key) { return Contains(key); }
+
+void HashTable::StartRehash() {
+    if (IsRehashing()) RehashStep(old_data_.size());
+    if (!IsRehashing()) Grow(std::max(size_ * 2, reserved_));
+}
+
+void HashTable::Grow(std::size_t size) {
+    old_data_ = std::move(data_);
+    size_ = size;
+    data_ = std::vector<bucket_t>(size_, bucket_t{});
+    rehash_index_ = 0;
+    reserved_ = 0;
+}
+
+void HashTable::RehashStep(std::size_t buckets) {
+    for (; buckets > 0 && rehash_index_ < old_data_.size();
+         --buckets, ++rehash_index_) {
+        auto &list = old_data_[rehash_index_];
+        while (!list.empty()) {
+            auto &new_list = data_[GetHash(list.front().first) % size_];
+            new_list.splice(new_list.end(), list, list.begin());
         }
     }
-    data_ = std::move(new_data);
+    if (rehash_index_ == old_data_.size()) {
+        std::vector<bucket_t>().swap(old_data_);
+        rehash_index_ = 0;
+        if (reserved_ > size_) Grow(reserved_);
+    }
 }
 
-bool HashTable::Set(const key_t &key, const value_t &value) {
-    if (Exists(key)) return false;
+template <typename Key, typename Value>
+bool HashTable::Emplace(hash_t hash, Key &&key, Value &&value) {
+    if (IsRehashing()) RehashStep(kRehashStep);
+    Slot slot = FindSlot(key, hash);
+    if (slot.Found()) {
+        if (!slot.entry->second.IsExpired()) return false;
+        index_.Remove(slot.entry->first, slot.entry->second);
+        slot.entry->second = std::forward<Value>(value);
+        expiry_.Add(slot.entry->first, slot.entry->second);
+        index_.Add(slot.entry->first, slot.entry->second);
+        return true;
+    }
+    const auto &[new_key, new_value] = slot.bucket->emplace_back(
+        std::forward<Key>(key), std::forward<Value>(value));
+    expiry_.Add(new_key, new_value);
+    index_.Add(new_key, new_value);
     ++count_structs_;
-    hash_t index = GetHash(key);
-    if (index >= data_.size()) data_.resize(size_);
-    auto &list = data_[index];
-    list.emplace_back(key, value);
-    if (count_structs_ > size_ * 0.75) Rehash();
+    if (std::size_t{count_structs_} * 4 > size_ * 3) StartRehash();
     return true;
 }
 
+bool HashTable::Set(const key_t &key, const value_t &value) {
+    return Emplace(GetHash(key), key, value);
+}
+
+bool HashTable::Set(key_t &&key, value_t &&value) {
+    const hash_t hash = GetHash(key);
+    return Emplace(hash, std::move(key), std::move(value));
+}
+
+bool HashTable::Set(key_t &&key, value_t &&value, hash_t hash) {
+    return Emplace(hash, std::move(key), std::move(value));
+}
+
 std::optional<value_t> HashTable::Get(const key_t &key) {
-    if (!Exists(key)) return std::nullopt;
-    hash_t index = GetHash(key);
-    for (const auto &[current_key, value] : data_[index])
-        if (current_key == key) return value;
-    return std::nullopt;
+    const value_t *value = Lookup(key);
+    if (value == nullptr) return std::nullopt;
+    return *value;
+}
+
+bool HashTable::Get(const key_t &key, const reader_t &reader) {
+    const value_t *value = Lookup(key);
+    if (value == nullptr) return false;
+    reader(*value);
+    return true;
 }
 
 std::vector<std::string> HashTable::Find(const optional_value_t &value) {
-    std::vector<std::string> result;
-    for (const auto &list : data_) {
-        for (const auto &[key, data] : list) {
-            if ((value.name && data.GetName() == *value.name) ||
-                (value.surname && data.GetSurname() == *value.surname) ||
-                (value.birth_year &&
-                 data.GetBirthYear() == *value.birth_year) ||
-                (value.city && data.GetCity() == *value.city) ||
-                (value.count_coins &&
-                 data.GetCountCoins() == *value.count_coins)) {
-                result.push_back(key);
-            }
-        }
+    return FindLive(index_, value, true);
+}
+
+bool HashTable::Del(const key_t &key) { return Del(key, GetHash(key)); }
+
+// An expired record is swept here, but it was already gone for the caller.
+bool HashTable::Del(const key_t &key, hash_t hash) {
+    if (IsRehashing()) RehashStep(kRehashStep);
+    Slot slot = FindSlot(key, hash);
+    if (!slot.Found()) return false;
+    const bool live = !slot.entry->second.IsExpired();
+    Erase(slot);
+    return live;
+}
+
+std::optional<value_t> HashTable::Take(const key_t &key) {
+    if (IsRehashing()) RehashStep(kRehashStep);
+    Slot slot = FindSlot(key);
+    if (!slot.Found()) return std::nullopt;
+    std::optional<value_t> value;
+    if (!slot.entry->second.IsExpired())
+        value = std::move(slot.entry->second);
+    Erase(slot);
+    return value;
+}
+
+void HashTable::Erase(Slot slot) {
+    expiry_.Remove(slot.entry->first);
+    index_.Remove(slot.entry->first, slot.entry->second);
+    slot.bucket->erase(slot.entry);
+    --count_structs_;
+}
+
+void HashTable::ForEach(const visitor_t &visitor) const {
+    for (const auto *table : {&old_data_, &data_})
+        for (const auto &list : *table)
+            for (const auto &[key, value] : list) visitor(key, value);
+}
+
+// While a rehash is under way both bucket arrays are cut into the same
+// fractions, so every slice takes its share of each.
+void HashTable::ForEachPart(std::size_t part, std::size_t parts,
+                            const visitor_t &visitor) const {
+    for (const auto *table : {&old_data_, &data_}) {
+        const auto [first, last] = PartRange(part, parts, table->size());
+        for (std::size_t i = first; i < last; ++i)
+            for (const auto &[key, value] : (*table)[i]) visitor(key, value);
     }
-    return result;
 }
 
-bool HashTable::Del(const key_t &key) {
-    if (!Exists(key)) return false;
-    hash_t index = GetHash(key);
-    auto &list = data_[index];
-    auto elm = std::find_if(list.begin(), list.end(), [&](const auto &pair) {
-        return pair.first == key;
+// Buckets are in hash order, so a scan gathers the records in range and
+// sorts them: O(n) per call, where the tree engines descend to `from`.
+unsigned int HashTable::Scan(const key_t &from, const key_t &to,
+                             std::size_t limit, const visitor_t &visitor) {
+    std::vector<std::pair<const key_t *, const value_t *>> found;
+    const long now = Data::Now();
+    ForEach([&](const key_t &key, const value_t &value) {
+        if (InRange(key, from, to) && !value.IsExpired(now))
+            found.emplace_back(&key, &value);
     });
-    list.erase(elm);
-    --count_structs_;
-    return true;
+    return VisitSorted(found, limit, visitor);
+}
+
+// While a rehash is under way the cursor walks the old, smaller array:
+// each of its buckets is visited together with all it splits into, so
+// a key is found whether or not it has been moved yet. Runs of empty
+// buckets are bounded, so a sparse table still returns promptly.
+std::uint64_t HashTable::ScanBuckets(std::uint64_t cursor, std::size_t count,
+                                     const visitor_t &visitor) const {
+    const long now = Data::Now();
+    std::size_t visited = 0;
+    const auto visit = [&](const bucket_t &bucket) {
+        for (const auto &[key, value] : bucket) {
+            if (value.IsExpired(now)) continue;
+            visitor(key, value);
+            ++visited;
+        }
+    };
+    const std::size_t size = IsRehashing() ? old_data_.size() : size_;
+    const unsigned int bits = BucketBits(size, kInitialSize);
+    count = std::max<std::size_t>(count, 1);
+    for (std::size_t steps = 0; visited < count && steps < count * 10;
+         ++steps) {
+        const auto bucket = static_cast<std::size_t>(cursor % size);
+        if (IsRehashing()) {
+            visit(old_data_[bucket]);
+            for (std::size_t split = bucket; split < size_; split += size)
+                visit(data_[split]);
+        } else {
+            visit(data_[bucket]);
+        }
+        cursor = NextBucket(bucket, kInitialSize, bits);
+        if (cursor == 0) break;
+    }
+    return cursor;
+}
+
+std::string HashTable::ScanKeys(const std::string &cursor, std::size_t count,
+                                std::vector<key_t> &keys) {
+    return EncodeCursor(ScanBuckets(
+        DecodeCursor(cursor), count,
+        [&keys](const key_t &key, const value_t &) { keys.push_back(key); }));
+}
+
+std::vector<std::optional<value_t>> HashTable::MultiGet(
+    const std::vector<key_t> &keys) {
+    std::vector<hash_t> hashes(keys.size());
+    for (std::size_t i = 0; i < keys.size(); ++i) hashes[i] = GetHash(keys[i]);
+    std::vector<std::optional<value_t>> values(keys.size());
+    Pipelined(
+        keys.size(), [&](std::size_t i) { PrefetchBucket(hashes[i]); },
+        [&](std::size_t i) { PrefetchEntry(hashes[i]); },
+        [&](std::size_t i) {
+            if (const value_t *value = Lookup(keys[i], hashes[i]))
+                values[i] = *value;
+        });
+    return values;
+}
+
+// The table grows as usual while the batch runs, since most of it may be
+// updates; when a write starts a rehash, the buckets already prefetched
+// for the next steps moved and are fetched again.
+unsigned int HashTable::MultiSet(std::vector<record_t> &&records) {
+    std::vector<hash_t> hashes(records.size());
+    for (std::size_t i = 0; i < records.size(); ++i)
+        hashes[i] = GetHash(records[i].first);
+    unsigned int count = 0;
+    Pipelined(
+        records.size(), [&](std::size_t i) { PrefetchBucket(hashes[i]); },
+        [&](std::size_t i) { PrefetchEntry(hashes[i]); },
+        [&](std::size_t i) {
+            const std::size_t size = size_;
+            if (Emplace(hashes[i], std::move(records[i].first),
+                        std::move(records[i].second)))
+                ++count;
+            if (size_ == size) return;
+            const std::size_t ahead =
+                std::min(records.size(), i + 1 + 2 * kBatchDistance);
+            for (std::size_t next = i + 1; next < ahead; ++next)
+                PrefetchBucket(hashes[next]);
+        });
+    return count;
+}
+
+unsigned int HashTable::MultiDel(const std::vector<key_t> &keys) {
+    std::vector<hash_t> hashes(keys.size());
+    for (std::size_t i = 0; i < keys.size(); ++i) hashes[i] = GetHash(keys[i]);
+    unsigned int count = 0;
+    Pipelined(
+        keys.size(), [&](std::size_t i) { PrefetchBucket(hashes[i]); },
+        [&](std::size_t i) { PrefetchEntry(hashes[i]); },
+        [&](std::size_t i) {
+            if (Del(keys[i], hashes[i])) ++count;
+        });
+    return count;
 }
 
 std::vector<key_t> HashTable::Keys() const {
-    std::vector<key_t> keys;
-    keys.reserve(data_.size());
-    for (const auto &list : data_)
-        std::transform(list.begin(), list.end(), std::back_inserter(keys),
-                       [](const auto &elm) { return elm.first; });
-    return keys;
+    return CollectKeys([](const value_t &) { return true; }, true);
 }
 
+std::size_t HashTable::Size() const { return count_structs_; }
+
 bool HashTable::Rename(const key_t &old_key, const key_t &new_key) {
-    if (!Exists(old_key)) return false;
-    hash_t old_index = GetHash(old_key);
-    hash_t new_index = GetHash(new_key);
-    auto &old_list = data_[old_index];
-    auto old_it = std::find_if(
-        old_list.begin(), old_list.end(),
-        [&old_key](const auto &pair) { return pair.first == old_key; });
-    old_it->first = new_key;
-    if (old_index != new_index) {
-        auto &new_list = data_[new_index];
-        new_list.push_back(std::move(*old_it));
-        old_list.erase(old_it);
+    if (IsRehashing()) RehashStep(kRehashStep);
+    Slot old_slot = FindSlot(old_key);
+    if (!old_slot.Found() || old_slot.entry->second.IsExpired()) return false;
+    Slot new_slot = FindSlot(new_key);
+    if (new_slot.Found()) {
+        if (!new_slot.entry->second.IsExpired()) return false;
+        Erase(new_slot);
     }
+    expiry_.Remove(old_slot.entry->first);
+    index_.Remove(old_slot.entry->first, old_slot.entry->second);
+    old_slot.entry->first = new_key;
+    new_slot.bucket->splice(new_slot.bucket->end(), *old_slot.bucket,
+                            old_slot.entry);
+    expiry_.Add(old_slot.entry->first, old_slot.entry->second);
+    index_.Add(old_slot.entry->first, old_slot.entry->second);
     return true;
 }
 
 void HashTable::DeleteOldData() {
-    for (const auto &list : data_)
-        for (const auto &[key, value] : list)
-            if (!value.TTL()) Del(key);
+    const long now = Data::Now();
+    while (auto entry = expiry_.PopDue(now)) {
+        Slot slot = FindSlot(entry->second);
+        if (!slot.Found() || slot.entry->second.GetTimeLife() != entry->first)
+            continue;
+        Erase(slot);
+    }
 }
 
 bool HashTable::Update(const key_t &key, const optional_value_t &value) {
-    if (!Exists(key)) return false;
-    hash_t index = GetHash(key);
-    auto &list = data_[index];
-    for (auto &[current_key, current_value] : list) {
-        if (current_key == key) {
-            if (value.surname) current_value.SetSurname(*value.surname);
-            if (value.name) current_value.SetName(*value.name);
-            if (value.city) current_value.SetCity(*value.city);
-            if (value.birth_year) current_value.SetBirthYear(*value.birth_year);
-            if (value.count_coins)
-                current_value.SetCountCoins(*value.count_coins);
-            if (value.expiry_time)
-                current_value.SetTimeLife(*value.expiry_time);
-        }
-    }
+    if (IsRehashing()) RehashStep(kRehashStep);
+    Slot slot = FindSlot(key);
+    if (!slot.Found() || slot.entry->second.IsExpired()) return false;
+    ApplyUpdate(key, value, slot.entry->second, index_, expiry_);
     return true;
 }
 
-unsigned int HashTable::Upload(const std::string &filename) {
-    std::ifstream file(filename);
-    if (!file.is_open()) throw std::invalid_argument("File Error!");
-    std::string line;
-    unsigned int count = 0;
-    while (std::getline(file, line)) {
-        std::istringstream iss(line);
-        std::string key, surname, name, city;
-        int birth_year;
-        long count_coins, time_life;
-        if (!(iss >> key)) continue;
-        std::getline(iss >> std::ws, surname, ' ');
-        std::getline(iss >> std::ws, name, ' ');
-        iss >> birth_year >> std::ws;
-        std::getline(iss >> std::ws, city, ' ');
-        iss >> count_coins >> time_life;
-        value_t value(surname, name, birth_year, city, count_coins, time_life);
-        if (Set(key, value)) count++;
-    }
-    return count;
+bool HashTable::CreateIndex(IndexField field) {
+    if (!index_.Enable(field)) return false;
+    for (const auto *table : {&old_data_, &data_})
+        for (const auto &list : *table)
+            for (const auto &[key, value] : list) index_.Add(key, value);
+    return true;
 }
 
-std::string HashTable::TTL(const key_t &key) {
-    if (!Exists(key)) return "null";
-    hash_t index = GetHash(key);
-    const auto &list = data_[index];
-    auto elm = std::find_if(list.begin(), list.end(), [&](const auto &pair) {
-        return pair.first == key;
-    });
-    return elm->second.TTL() ? std::to_string(*elm->second.TTL()) : "null";
-}
-
-unsigned int HashTable::Export(const std::string &filename) {
-    std::ofstream file(filename);
-    if (!file.is_open()) throw std::invalid_argument("File Error!");
-    for (const auto &list : data_) {
-        for (const auto &[key, value] : list) {
-            file << key << " ";
-            file << "\"" << value.GetSurname() << "\" ";
-            file << "\"" << value.GetName() << "\" ";
-            file << value.GetBirthYear() << " ";
-            file << "\"" << value.GetCity() << "\" ";
-            file << value.GetCountCoins() << " ";
-            if (value.GetTimeLife()) file << *value.GetTimeLife() << std::endl;
-        }
-    }
-    return count_structs_;
+// Only sizes the new array: its buckets are filled by the incremental
+// steps of the writes that follow. A move already under way is not cut
+// short; the next one starts at the reserved size when it ends.
+void HashTable::Reserve(std::size_t count) {
+    std::size_t size = std::max(size_, reserved_);
+    while ((count_structs_ + count) * 4 > size * 3) size *= 2;
+    if (size == size_) return;
+    if (IsRehashing())
+        reserved_ = size;
+    else
+        Grow(size);
 }
 
-void HashTable::ShowAll() const {
-    std::cout << std::setw(5) << "№"
-              << " | " << std::setw(13) << "Фамилия"
-              << " | " << std::setw(13) << "Имя"
-              << " | " << std::setw(5) << "Год"
-              << " | " << std::setw(13) << "Город"
-              << " | " << std::setw(14) << "Количество коинов"
-              << " |" << std::endl;
-    Print();
+unsigned int HashTable::BulkLoad(std::vector<record_t> &&records,
+                                 ThreadPool &) {
+    Reserve(records.size());
+    unsigned int count = 0;
+    for (auto &[key, value] : records)
+        if (Set(std::move(key), std::move(value))) ++count;
+    return count;
 }
 
-void HashTable::Print() const {
-    for (const auto &list : data_)
-        for (const auto &[key, value] : list) value.Print(key);
+HashTable::~HashTable() {
+    data_.clear();
+    old_data_.clear();
 }
 
-HashTable::~HashTable() { data_.clear(); }
-
 }  // namespace storage
\ No newline at end of file
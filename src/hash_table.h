@@ -1,6 +1,9 @@
 #pragma once
 
+#include <string_view>
+
 #include "base_storage.h"
+#include "expiry_index.h"
 
 namespace storage {
 
@@ -13,27 +16,99 @@ class HashTable : public BaseStorage {
     ~HashTable();
 
     bool Set(const key_t &key, const value_t &value) override final;
+    bool Set(key_t &&key, value_t &&value) override final;
     std::optional<value_t> Get(const key_t &key) override final;
+    bool Get(const key_t &key, const reader_t &reader) override final;
     bool Rename(const key_t &old_key, const key_t &new_key) override final;
     bool Del(const key_t &key) override final;
     std::vector<key_t> Keys() const override final;
+    std::size_t Size() const override final;
     bool Update(const key_t &key, const optional_value_t &value) override final;
     bool Exists(const key_t &key) override final;
     std::vector<std::string> Find(const optional_value_t &value) override final;
-    std::string TTL(const key_t &key) override final;
-    unsigned int Upload(const std::string &filename) override final;
-    unsigned int Export(const std::string &filename) override final;
-    void ShowAll() const override final;
+    void ForEach(const visitor_t &visitor) const override final;
+    void ForEachPart(std::size_t part, std::size_t parts,
+                     const visitor_t &visitor) const override final;
+    unsigned int Scan(const key_t &from, const key_t &to, std::size_t limit,
+                      const visitor_t &visitor) override final;
+    std::string ScanKeys(const std::string &cursor, std::size_t count,
+                         std::vector<key_t> &keys) override final;
+    std::vector<std::optional<value_t>> MultiGet(
+        const std::vector<key_t> &keys) override final;
+    unsigned int MultiSet(std::vector<record_t> &&records) override final;
+    unsigned int MultiDel(const std::vector<key_t> &keys) override final;
     void DeleteOldData() override final;
+    bool CreateIndex(IndexField field) override final;
+    void Reserve(std::size_t count) override final;
+    unsigned int BulkLoad(std::vector<record_t> &&records,
+                          ThreadPool &pool) override final;
+
+    bool Contains(std::string_view key) const;
+    const value_t *Lookup(std::string_view key) const {
+        return Lookup(key, GetHash(key));
+    }
+    std::optional<value_t> Take(const key_t &key);
+
+    // Forms of the calls above for a hash the caller already has, which
+    // must come from GetHash, and the two prefetch stages for Pipelined.
+    hash_t GetHash(std::string_view key) const;
+    const value_t *Lookup(std::string_view key, hash_t hash) const;
+    bool Set(key_t &&key, value_t &&value, hash_t hash);
+    bool Del(const key_t &key, hash_t hash);
+    void PrefetchBucket(hash_t hash) const {
+        __builtin_prefetch(&data_[hash % size_]);
+    }
+    void PrefetchEntry(hash_t hash) const {
+        const bucket_t &bucket = data_[hash % size_];
+        if (!bucket.empty()) __builtin_prefetch(&bucket.front());
+    }
+    // Visits the live records of the buckets from `cursor` on, in
+    // NextBucket order, until at least count were visited; returns the
+    // bucket to resume at, 0 at the end.
+    std::uint64_t ScanBuckets(std::uint64_t cursor, std::size_t count,
+                              const visitor_t &visitor) const;
+
+   protected:
+    const FieldIndex *Indexes() const override final { return &index_; }
 
    private:
-    void Print() const;
-    hash_t GetHash(const key_t &key) const;
-    void Rehash();
+    using bucket_t = std::list<std::pair<key_t, value_t>>;
+
+    struct Slot {
+        bucket_t *bucket;
+        bucket_t::iterator entry;
+        bool Found() const { return entry != bucket->end(); }
+    };
+
+    // Growing the table keeps the previous bucket array in old_data_ and
+    // moves a few of its buckets per write, so no single Set pays for the
+    // whole table. Reads look in both arrays until the move is finished.
+    static constexpr std::size_t kRehashStep = 4;
+    // Sizes are always kInitialSize times a power of two, which is what
+    // ScanBuckets relies on.
+    static constexpr unsigned int kInitialSize = 10;
+
+    Slot FindSlot(std::string_view key) { return FindSlot(key, GetHash(key)); }
+    Slot FindSlot(std::string_view key, hash_t hash);
+    template <typename Key, typename Value>
+    bool Emplace(hash_t hash, Key &&key, Value &&value);
+    // Removes the record with its index and expiry entries.
+    void Erase(Slot slot);
+    bool IsRehashing() const { return !old_data_.empty(); }
+    void StartRehash();
+    void Grow(std::size_t size);
+    void RehashStep(std::size_t buckets);
 
-    unsigned int size_;
+    std::size_t size_;
     unsigned int count_structs_;
-    std::vector<std::list<std::pair<key_t, value_t>>> data_;
+    std::vector<bucket_t> data_;
+    std::vector<bucket_t> old_data_;
+    std::size_t rehash_index_;
+    // Size the next move grows to once the current one ends, set by a
+    // Reserve that came while a move was under way; 0 when there is none.
+    std::size_t reserved_;
+    ExpiryIndex expiry_;
+    FieldIndex index_;
 };
 
 }  // namespace storage
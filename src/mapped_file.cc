@@ -0,0 +1,38 @@
+#include "mapped_file.h"
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <stdexcept>
+
+namespace storage {
+
+MappedFile::MappedFile(const std::string &filename)
+    : data_(nullptr), size_(0) {
+    const int fd = open(filename.c_str(), O_RDONLY);
+    if (fd < 0) throw std::invalid_argument("File Error!");
+    struct stat info;
+    if (fstat(fd, &info) != 0) {
+        close(fd);
+        throw std::invalid_argument("File Error!");
+    }
+    size_ = static_cast<std::size_t>(info.st_size);
+    if (size_ > 0) {
+        void *data = mmap(nullptr, size_, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (data == MAP_FAILED) {
+            close(fd);
+            throw std::invalid_argument("File Error!");
+        }
+        madvise(data, size_, MADV_SEQUENTIAL);
+        data_ = static_cast<char *>(data);
+    }
+    close(fd);
+}
+
+MappedFile::~MappedFile() {
+    if (data_ != nullptr) munmap(data_, size_);
+}
+
+}  // namespace storage
@@ -0,0 +1,26 @@
+#pragma once
+
+#include <string>
+#include <string_view>
+
+namespace storage {
+
+// Read-only memory mapping of a whole file. Throws std::invalid_argument
+// when the file cannot be opened or mapped.
+class MappedFile {
+   public:
+    explicit MappedFile(const std::string &filename);
+    MappedFile(const MappedFile &other) = delete;
+    MappedFile &operator=(const MappedFile &other) = delete;
+    ~MappedFile();
+
+    const char *Data() const { return data_; }
+    std::size_t Size() const { return size_; }
+    std::string_view View() const { return std::string_view(data_, size_); }
+
+   private:
+    char *data_;
+    std::size_t size_;
+};
+
+}  // namespace storage
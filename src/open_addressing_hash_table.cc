@@ -0,0 +1,337 @@
+#include "open_addressing_hash_table.h"
+
+#include <algorithm>
+
+namespace storage {
+
+OpenAddressingHashTable::OpenAddressingHashTable()
+    : capacity_(16),
+      size_(0),
+      deleted_(0),
+      control_(new control_t[capacity_]),
+      slots_(allocator_.allocate(capacity_)) {
+    std::fill_n(control_.get(), capacity_, kEmpty);
+}
+
+hash_t OpenAddressingHashTable::GetHash(std::string_view key) const {
+    return std::hash<std::string_view>{}(key);
+}
+
+std::size_t OpenAddressingHashTable::FindIndex(std::string_view key,
+                                               hash_t hash) const {
+    const auto fingerprint = static_cast<control_t>(hash & 0x7f);
+    const std::size_t mask = capacity_ - 1;
+    for (std::size_t index = (hash >> 7) & mask;; index = (index + 1) & mask) {
+        if (control_[index] == kEmpty) return kNotFound;
+        if (control_[index] == fingerprint && slots_[index].first == key)
+            return index;
+    }
+}
+
+std::size_t OpenAddressingHashTable::FindInsertIndex(hash_t hash) const {
+    const std::size_t mask = capacity_ - 1;
+    std::size_t index = (hash >> 7) & mask;
+    while (IsFull(control_[index])) index = (index + 1) & mask;
+    return index;
+}
+
+std::size_t OpenAddressingHashTable::Insert(hash_t hash, slot_t &&slot) {
+    if ((size_ + deleted_ + 1) * 8 > capacity_ * 7)
+        Rehash(size_ * 16 >= capacity_ * 7 ? capacity_ * 2 : capacity_);
+    const std::size_t index = FindInsertIndex(hash);
+    if (control_[index] == kDeleted) --deleted_;
+    control_[index] = static_cast<control_t>(hash & 0x7f);
+    new (slots_ + index) slot_t(std::move(slot));
+    ++size_;
+    return index;
+}
+
+void OpenAddressingHashTable::Erase(std::size_t index) {
+    slots_[index].~slot_t();
+    // A slot followed by an empty one terminates no probe sequence, so it can
+    // go back to empty instead of leaving a tombstone behind.
+    if (control_[(index + 1) & (capacity_ - 1)] == kEmpty) {
+        control_[index] = kEmpty;
+    } else {
+        control_[index] = kDeleted;
+        ++deleted_;
+    }
+    --size_;
+}
+
+void OpenAddressingHashTable::Rehash(std::size_t capacity) {
+    std::unique_ptr<control_t[]> old_control = std::move(control_);
+    slot_t *old_slots = slots_;
+    const std::size_t old_capacity = capacity_;
+    capacity_ = capacity;
+    control_.reset(new control_t[capacity_]);
+    std::fill_n(control_.get(), capacity_, kEmpty);
+    slots_ = allocator_.allocate(capacity_);
+    deleted_ = 0;
+    for (std::size_t i = 0; i < old_capacity; ++i) {
+        if (!IsFull(old_control[i])) continue;
+        const hash_t hash = GetHash(old_slots[i].first);
+        const std::size_t index = FindInsertIndex(hash);
+        control_[index] = old_control[i];
+        new (slots_ + index) slot_t(std::move(old_slots[i]));
+        old_slots[i].~slot_t();
+    }
+    allocator_.deallocate(old_slots, old_capacity);
+}
+
+bool OpenAddressingHashTable::Contains(std::string_view key) const {
+    return Lookup(key) != nullptr;
+}
+
+const value_t *OpenAddressingHashTable::Lookup(std::string_view key) const {
+    const std::size_t index = FindIndex(key);
+    if (index == kNotFound || slots_[index].second.IsExpired()) return nullptr;
+    return &slots_[index].second;
+}
+
+bool OpenAddressingHashTable::Exists(const key_t &key) { return Contains(key); }
+
+template <typename Key, typename Value>
+bool OpenAddressingHashTable::Emplace(hash_t hash, Key &&key, Value &&value) {
+    std::size_t index = FindIndex(key, hash);
+    if (index != kNotFound) {
+        if (!slots_[index].second.IsExpired()) return false;
+        index_.Remove(slots_[index].first, slots_[index].second);
+        slots_[index].second = std::forward<Value>(value);
+    } else {
+        index = Insert(hash, slot_t(std::forward<Key>(key),
+                                    std::forward<Value>(value)));
+    }
+    expiry_.Add(slots_[index].first, slots_[index].second);
+    index_.Add(slots_[index].first, slots_[index].second);
+    return true;
+}
+
+bool OpenAddressingHashTable::Set(const key_t &key, const value_t &value) {
+    return Emplace(GetHash(key), key, value);
+}
+
+bool OpenAddressingHashTable::Set(key_t &&key, value_t &&value) {
+    const hash_t hash = GetHash(key);
+    return Emplace(hash, std::move(key), std::move(value));
+}
+
+std::optional<value_t> OpenAddressingHashTable::Get(const key_t &key) {
+    const value_t *value = Lookup(key);
+    if (value == nullptr) return std::nullopt;
+    return *value;
+}
+
+bool OpenAddressingHashTable::Get(const key_t &key, const reader_t &reader) {
+    const value_t *value = Lookup(key);
+    if (value == nullptr) return false;
+    reader(*value);
+    return true;
+}
+
+bool OpenAddressingHashTable::Del(const key_t &key) {
+    return Del(key, GetHash(key));
+}
+
+// As in HashTable, an expired record is swept but does not count.
+bool OpenAddressingHashTable::Del(const key_t &key, hash_t hash) {
+    const std::size_t index = FindIndex(key, hash);
+    if (index == kNotFound) return false;
+    const bool live = !slots_[index].second.IsExpired();
+    expiry_.Remove(key);
+    index_.Remove(slots_[index].first, slots_[index].second);
+    Erase(index);
+    return live;
+}
+
+bool OpenAddressingHashTable::Rename(const key_t &old_key,
+                                     const key_t &new_key) {
+    if (!Contains(old_key) || Contains(new_key)) return false;
+    // Sweeps an expired record under new_key before the move.
+    Del(new_key);
+    const std::size_t index = FindIndex(old_key);
+    expiry_.Remove(old_key);
+    index_.Remove(slots_[index].first, slots_[index].second);
+    slot_t slot(std::move(slots_[index]));
+    Erase(index);
+    slot.first = new_key;
+    const std::size_t new_index = Insert(GetHash(slot.first), std::move(slot));
+    expiry_.Add(slots_[new_index].first, slots_[new_index].second);
+    index_.Add(slots_[new_index].first, slots_[new_index].second);
+    return true;
+}
+
+bool OpenAddressingHashTable::Update(const key_t &key,
+                                     const optional_value_t &value) {
+    const std::size_t index = FindIndex(key);
+    if (index == kNotFound || slots_[index].second.IsExpired()) return false;
+    ApplyUpdate(key, value, slots_[index].second, index_, expiry_);
+    return true;
+}
+
+std::vector<key_t> OpenAddressingHashTable::Keys() const {
+    return CollectKeys([](const value_t &) { return true; }, true);
+}
+
+std::size_t OpenAddressingHashTable::Size() const { return size_; }
+
+std::vector<std::string> OpenAddressingHashTable::Find(
+    const optional_value_t &value) {
+    return FindLive(index_, value, true);
+}
+
+void OpenAddressingHashTable::DeleteOldData() {
+    const long now = Data::Now();
+    while (auto entry = expiry_.PopDue(now)) {
+        const std::size_t index = FindIndex(entry->second);
+        if (index == kNotFound ||
+            slots_[index].second.GetTimeLife() != entry->first)
+            continue;
+        index_.Remove(slots_[index].first, slots_[index].second);
+        Erase(index);
+    }
+}
+
+bool OpenAddressingHashTable::CreateIndex(IndexField field) {
+    if (!index_.Enable(field)) return false;
+    for (std::size_t i = 0; i < capacity_; ++i)
+        if (IsFull(control_[i])) index_.Add(slots_[i].first, slots_[i].second);
+    return true;
+}
+
+void OpenAddressingHashTable::Reserve(std::size_t count) {
+    std::size_t capacity = capacity_;
+    while ((size_ + count + 1) * 8 > capacity * 7) capacity *= 2;
+    if (capacity != capacity_) Rehash(capacity);
+}
+
+unsigned int OpenAddressingHashTable::BulkLoad(std::vector<record_t> &&records,
+                                               ThreadPool &) {
+    Reserve(records.size());
+    unsigned int count = 0;
+    for (auto &[key, value] : records)
+        if (Set(std::move(key), std::move(value))) ++count;
+    return count;
+}
+
+void OpenAddressingHashTable::ForEach(const visitor_t &visitor) const {
+    for (std::size_t i = 0; i < capacity_; ++i)
+        if (IsFull(control_[i])) visitor(slots_[i].first, slots_[i].second);
+}
+
+void OpenAddressingHashTable::ForEachPart(std::size_t part, std::size_t parts,
+                                          const visitor_t &visitor) const {
+    const auto [first, last] = PartRange(part, parts, capacity_);
+    for (std::size_t i = first; i < last; ++i)
+        if (IsFull(control_[i])) visitor(slots_[i].first, slots_[i].second);
+}
+
+// Slots are in hash order; see HashTable::Scan.
+unsigned int OpenAddressingHashTable::Scan(const key_t &from, const key_t &to,
+                                           std::size_t limit,
+                                           const visitor_t &visitor) {
+    std::vector<std::pair<const key_t *, const value_t *>> found;
+    const long now = Data::Now();
+    ForEach([&](const key_t &key, const value_t &value) {
+        if (InRange(key, from, to) && !value.IsExpired(now))
+            found.emplace_back(&key, &value);
+    });
+    return VisitSorted(found, limit, visitor);
+}
+
+// The cursor runs over home slots rather than over where the records sit:
+// a record is always found between its home slot and the next empty one,
+// and homes split on a doubling the way HashTable's buckets do, so a cursor
+// outlives any Rehash.
+std::uint64_t OpenAddressingHashTable::ScanSlots(
+    std::uint64_t cursor, std::size_t count, std::vector<key_t> &keys) const {
+    const long now = Data::Now();
+    const std::size_t mask = capacity_ - 1;
+    const unsigned int bits = BucketBits(capacity_, 1);
+    count = std::max<std::size_t>(count, 1);
+    std::size_t visited = 0;
+    for (std::size_t steps = 0; visited < count && steps < count * 10;
+         ++steps) {
+        const auto home = static_cast<std::size_t>(cursor & mask);
+        for (std::size_t i = home; control_[i] != kEmpty; i = (i + 1) & mask) {
+            if (!IsFull(control_[i]) ||
+                ((GetHash(slots_[i].first) >> 7) & mask) != home ||
+                slots_[i].second.IsExpired(now))
+                continue;
+            keys.push_back(slots_[i].first);
+            ++visited;
+        }
+        cursor = NextBucket(home, 1, bits);
+        if (cursor == 0) break;
+    }
+    return cursor;
+}
+
+std::string OpenAddressingHashTable::ScanKeys(const std::string &cursor,
+                                              std::size_t count,
+                                              std::vector<key_t> &keys) {
+    return EncodeCursor(ScanSlots(DecodeCursor(cursor), count, keys));
+}
+
+std::vector<std::optional<value_t>> OpenAddressingHashTable::MultiGet(
+    const std::vector<key_t> &keys) {
+    std::vector<hash_t> hashes(keys.size());
+    for (std::size_t i = 0; i < keys.size(); ++i) hashes[i] = GetHash(keys[i]);
+    const long now = Data::Now();
+    std::vector<std::optional<value_t>> values(keys.size());
+    Pipelined(
+        keys.size(), [&](std::size_t i) { PrefetchControl(hashes[i]); },
+        [&](std::size_t i) { PrefetchSlot(hashes[i]); },
+        [&](std::size_t i) {
+            const std::size_t index = FindIndex(keys[i], hashes[i]);
+            if (index != kNotFound && !slots_[index].second.IsExpired(now))
+                values[i] = slots_[index].second;
+        });
+    return values;
+}
+
+// As in HashTable::MultiSet, the table only grows by what the batch
+// inserts, and the prefetches ahead are redone after a Rehash.
+unsigned int OpenAddressingHashTable::MultiSet(
+    std::vector<record_t> &&records) {
+    std::vector<hash_t> hashes(records.size());
+    for (std::size_t i = 0; i < records.size(); ++i)
+        hashes[i] = GetHash(records[i].first);
+    unsigned int count = 0;
+    Pipelined(
+        records.size(), [&](std::size_t i) { PrefetchControl(hashes[i]); },
+        [&](std::size_t i) { PrefetchSlot(hashes[i]); },
+        [&](std::size_t i) {
+            const slot_t *slots = slots_;
+            if (Emplace(hashes[i], std::move(records[i].first),
+                        std::move(records[i].second)))
+                ++count;
+            if (slots_ == slots) return;
+            const std::size_t ahead =
+                std::min(records.size(), i + 1 + 2 * kBatchDistance);
+            for (std::size_t next = i + 1; next < ahead; ++next)
+                PrefetchControl(hashes[next]);
+        });
+    return count;
+}
+
+unsigned int OpenAddressingHashTable::MultiDel(const std::vector<key_t> &keys) {
+    std::vector<hash_t> hashes(keys.size());
+    for (std::size_t i = 0; i < keys.size(); ++i) hashes[i] = GetHash(keys[i]);
+    unsigned int count = 0;
+    Pipelined(
+        keys.size(), [&](std::size_t i) { PrefetchControl(hashes[i]); },
+        [&](std::size_t i) { PrefetchSlot(hashes[i]); },
+        [&](std::size_t i) {
+            if (Del(keys[i], hashes[i])) ++count;
+        });
+    return count;
+}
+
+OpenAddressingHashTable::~OpenAddressingHashTable() {
+    for (std::size_t i = 0; i < capacity_; ++i)
+        if (IsFull(control_[i])) slots_[i].~slot_t();
+    allocator_.deallocate(slots_, capacity_);
+}
+
+}  // namespace storage
@@ -0,0 +1,102 @@
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <string_view>
+
+#include "base_storage.h"
+#include "expiry_index.h"
+
+namespace storage {
+
+// Swiss-table style open addressing: a packed array of one-byte control
+// words (7-bit fingerprint or empty/deleted marker) is probed linearly, and
+// the key/value slots are only touched when the fingerprint matches.
+class OpenAddressingHashTable : public BaseStorage {
+   public:
+    OpenAddressingHashTable();
+    OpenAddressingHashTable(const OpenAddressingHashTable &other) = delete;
+    OpenAddressingHashTable(const OpenAddressingHashTable &&other) = delete;
+    OpenAddressingHashTable &operator=(const OpenAddressingHashTable &other) =
+        delete;
+    ~OpenAddressingHashTable();
+
+    bool Set(const key_t &key, const value_t &value) override final;
+    bool Set(key_t &&key, value_t &&value) override final;
+    std::optional<value_t> Get(const key_t &key) override final;
+    bool Get(const key_t &key, const reader_t &reader) override final;
+    bool Rename(const key_t &old_key, const key_t &new_key) override final;
+    bool Del(const key_t &key) override final;
+    std::vector<key_t> Keys() const override final;
+    std::size_t Size() const override final;
+    bool Update(const key_t &key, const optional_value_t &value) override final;
+    bool Exists(const key_t &key) override final;
+    std::vector<std::string> Find(const optional_value_t &value) override final;
+    void ForEach(const visitor_t &visitor) const override final;
+    void ForEachPart(std::size_t part, std::size_t parts,
+                     const visitor_t &visitor) const override final;
+    unsigned int Scan(const key_t &from, const key_t &to, std::size_t limit,
+                      const visitor_t &visitor) override final;
+    std::string ScanKeys(const std::string &cursor, std::size_t count,
+                         std::vector<key_t> &keys) override final;
+    std::vector<std::optional<value_t>> MultiGet(
+        const std::vector<key_t> &keys) override final;
+    unsigned int MultiSet(std::vector<record_t> &&records) override final;
+    unsigned int MultiDel(const std::vector<key_t> &keys) override final;
+    void DeleteOldData() override final;
+    bool CreateIndex(IndexField field) override final;
+    void Reserve(std::size_t count) override final;
+    unsigned int BulkLoad(std::vector<record_t> &&records,
+                          ThreadPool &pool) override final;
+
+    bool Contains(std::string_view key) const;
+    const value_t *Lookup(std::string_view key) const;
+
+   protected:
+    const FieldIndex *Indexes() const override final { return &index_; }
+
+   private:
+    using slot_t = std::pair<key_t, value_t>;
+    using control_t = std::int8_t;
+
+    static constexpr control_t kEmpty = -128;
+    static constexpr control_t kDeleted = -2;
+    static constexpr std::size_t kNotFound = static_cast<std::size_t>(-1);
+
+    static bool IsFull(control_t control) { return control >= 0; }
+
+    hash_t GetHash(std::string_view key) const;
+    std::size_t FindIndex(std::string_view key) const {
+        return FindIndex(key, GetHash(key));
+    }
+    std::size_t FindIndex(std::string_view key, hash_t hash) const;
+    std::size_t FindInsertIndex(hash_t hash) const;
+    std::size_t Insert(hash_t hash, slot_t &&slot);
+    template <typename Key, typename Value>
+    bool Emplace(hash_t hash, Key &&key, Value &&value);
+    bool Del(const key_t &key, hash_t hash);
+    // Prefetch stages for Pipelined: the home control byte, then the slot
+    // when the control byte says it may hold the key.
+    void PrefetchControl(hash_t hash) const {
+        __builtin_prefetch(&control_[(hash >> 7) & (capacity_ - 1)]);
+    }
+    void PrefetchSlot(hash_t hash) const {
+        const std::size_t index = (hash >> 7) & (capacity_ - 1);
+        if (control_[index] != kEmpty) __builtin_prefetch(&slots_[index]);
+    }
+    void Erase(std::size_t index);
+    void Rehash(std::size_t capacity);
+    std::uint64_t ScanSlots(std::uint64_t cursor, std::size_t count,
+                            std::vector<key_t> &keys) const;
+
+    std::size_t capacity_;
+    std::size_t size_;
+    std::size_t deleted_;
+    std::allocator<slot_t> allocator_;
+    std::unique_ptr<control_t[]> control_;
+    slot_t *slots_;
+    ExpiryIndex expiry_;
+    FieldIndex index_;
+};
+
+}  // namespace storage
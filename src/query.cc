@@ -0,0 +1,252 @@
+#include "query.h"
+
+#include <algorithm>
+#include <stdexcept>
+
+#include "base_storage.h"
+
+namespace storage {
+
+namespace {
+
+bool IsText(IndexField field) {
+    return field == IndexField::kSurname || field == IndexField::kName ||
+           field == IndexField::kCity;
+}
+
+bool IsNumber(IndexField field) {
+    return field == IndexField::kBirthYear || field == IndexField::kCountCoins;
+}
+
+const std::string &TextOf(const Data &value, IndexField field) {
+    if (field == IndexField::kSurname) return value.GetSurname();
+    if (field == IndexField::kCity) return value.GetCity();
+    return value.GetName();
+}
+
+long NumberOf(const Data &value, IndexField field) {
+    return field == IndexField::kBirthYear ? value.GetBirthYear()
+                                           : value.GetCountCoins();
+}
+
+}  // namespace
+
+Predicate::Predicate(Node node)
+    : node_(std::make_shared<const Node>(std::move(node))) {}
+
+Predicate Predicate::Equal(IndexField field, std::string text) {
+    if (!IsText(field)) throw std::invalid_argument("Field Error!");
+    return Predicate(Node{Op::kEqual, field, std::move(text), 0, 0, {}});
+}
+
+Predicate Predicate::Equal(IndexField field, long number) {
+    return Between(field, number, number);
+}
+
+Predicate Predicate::Between(IndexField field, long low, long high) {
+    if (!IsNumber(field)) throw std::invalid_argument("Field Error!");
+    return Predicate(Node{Op::kBetween, field, std::string(), low, high, {}});
+}
+
+Predicate Predicate::Prefix(IndexField field, std::string prefix) {
+    if (!IsText(field)) throw std::invalid_argument("Field Error!");
+    return Predicate(Node{Op::kPrefix, field, std::move(prefix), 0, 0, {}});
+}
+
+Predicate Predicate::Combine(Op op, const Predicate &lhs,
+                             const Predicate &rhs) {
+    Node node{op, IndexField::kSurname, std::string(), 0, 0, {lhs, rhs}};
+    return Predicate(std::move(node));
+}
+
+Predicate Predicate::operator&&(const Predicate &other) const {
+    return Combine(Op::kAnd, *this, other);
+}
+
+Predicate Predicate::operator||(const Predicate &other) const {
+    return Combine(Op::kOr, *this, other);
+}
+
+Predicate Predicate::operator!() const {
+    return Predicate(
+        Node{Op::kNot, IndexField::kSurname, std::string(), 0, 0, {*this}});
+}
+
+QueryPlan::QueryPlan(const Predicate &predicate)
+    : root_(Compile(*predicate.node_)) {}
+
+QueryPlan::Step QueryPlan::Constant(bool value) {
+    Step step;
+    step.op = value ? Op::kTrue : Op::kFalse;
+    return step;
+}
+
+// Folds what is known before the first record: empty ranges and prefixes,
+// double negation and constant operands. A surname or city that is not
+// interned yet may be by the time the plan runs, so it is compared as
+// text rather than folded to false.
+QueryPlan::Step QueryPlan::Compile(const Predicate::Node &node) {
+    Step step;
+    step.field = node.field;
+    switch (node.op) {
+        case Predicate::Op::kEqual:
+            if (node.field != IndexField::kName)
+                step.interned = StringPool::Find(node.text);
+            if (step.interned == nullptr) {
+                step.op = Op::kText;
+                step.text = node.text;
+                step.cost = 2;
+                return step;
+            }
+            step.op = Op::kInterned;
+            step.cost = 1;
+            return step;
+        case Predicate::Op::kBetween:
+            if (node.low > node.high) return Constant(false);
+            step.op = Op::kNumber;
+            step.low = node.low;
+            step.high = node.high;
+            step.cost = 1;
+            return step;
+        case Predicate::Op::kPrefix:
+            if (node.text.empty()) return Constant(true);
+            step.op = Op::kPrefix;
+            step.text = node.text;
+            step.cost = 3;
+            return step;
+        case Predicate::Op::kNot: {
+            Step child = Compile(*node.children.front().node_);
+            if (child.op == Op::kFalse || child.op == Op::kTrue)
+                return Constant(child.op == Op::kFalse);
+            if (child.op == Op::kNot) return std::move(child.children.front());
+            step.op = Op::kNot;
+            step.cost = child.cost;
+            step.children.push_back(std::move(child));
+            return step;
+        }
+        case Predicate::Op::kAnd:
+        case Predicate::Op::kOr:
+            break;
+    }
+    step.op = node.op == Predicate::Op::kAnd ? Op::kAnd : Op::kOr;
+    // x && false is false and x && true is x; dually for ||.
+    const Op absorbing = step.op == Op::kAnd ? Op::kFalse : Op::kTrue;
+    const Op identity = step.op == Op::kAnd ? Op::kTrue : Op::kFalse;
+    for (const Predicate &child : node.children) {
+        Step compiled = Compile(*child.node_);
+        if (compiled.op == absorbing) return compiled;
+        if (compiled.op == identity) continue;
+        step.cost += compiled.cost;
+        if (compiled.op == step.op) {
+            for (Step &nested : compiled.children)
+                step.children.push_back(std::move(nested));
+        } else {
+            step.children.push_back(std::move(compiled));
+        }
+    }
+    if (step.children.empty()) return Constant(identity == Op::kTrue);
+    if (step.children.size() == 1) return std::move(step.children.front());
+    std::stable_sort(
+        step.children.begin(), step.children.end(),
+        [](const Step &lhs, const Step &rhs) { return lhs.cost < rhs.cost; });
+    return step;
+}
+
+bool QueryPlan::Evaluate(const Step &step, const Data &value) {
+    switch (step.op) {
+        case Op::kFalse:
+            return false;
+        case Op::kTrue:
+            return true;
+        case Op::kNumber: {
+            const long number = NumberOf(value, step.field);
+            return step.low <= number && number <= step.high;
+        }
+        case Op::kInterned:
+            return &TextOf(value, step.field) == step.interned;
+        case Op::kText:
+            return TextOf(value, step.field) == step.text;
+        case Op::kPrefix:
+            return TextOf(value, step.field).compare(0, step.text.size(),
+                                                     step.text) == 0;
+        case Op::kAnd:
+            for (const Step &child : step.children)
+                if (!Evaluate(child, value)) return false;
+            return true;
+        case Op::kOr:
+            for (const Step &child : step.children)
+                if (Evaluate(child, value)) return true;
+            return false;
+        case Op::kNot:
+            return !Evaluate(step.children.front(), value);
+    }
+    return false;
+}
+
+bool QueryPlan::Candidates(const FieldIndex &index,
+                           std::vector<key_t> &keys) const {
+    std::vector<key_t> found;
+    if (!Candidates(root_, index, found)) return false;
+    std::sort(found.begin(), found.end());
+    found.erase(std::unique(found.begin(), found.end()), found.end());
+    keys.insert(keys.end(), std::make_move_iterator(found.begin()),
+                std::make_move_iterator(found.end()));
+    return true;
+}
+
+// An && needs one indexed operand, and an equality is tried before a
+// range, which tends to select more. An || needs every operand indexed.
+bool QueryPlan::Candidates(const Step &step, const FieldIndex &index,
+                           std::vector<key_t> &keys) {
+    switch (step.op) {
+        case Op::kFalse:
+            return true;
+        case Op::kInterned:
+            return index.Match(step.field, *step.interned, keys);
+        case Op::kText:
+            return index.Match(step.field, step.text, keys);
+        case Op::kNumber:
+            return index.MatchRange(step.field, step.low, step.high, keys);
+        case Op::kAnd: {
+            const auto is_equality = [](const Step &child) {
+                return child.op == Op::kInterned || child.op == Op::kText ||
+                       (child.op == Op::kNumber && child.low == child.high);
+            };
+            for (bool equality : {true, false})
+                for (const Step &child : step.children)
+                    if (is_equality(child) == equality &&
+                        Candidates(child, index, keys))
+                        return true;
+            return false;
+        }
+        case Op::kOr: {
+            std::vector<key_t> found;
+            for (const Step &child : step.children)
+                if (!Candidates(child, index, found)) return false;
+            keys.insert(keys.end(), std::make_move_iterator(found.begin()),
+                        std::make_move_iterator(found.end()));
+            return true;
+        }
+        default:
+            return false;
+    }
+}
+
+// Candidates are looked up again to drop the ones that expired or that
+// match only the indexed part of the plan.
+std::vector<key_t> BaseStorage::Select(const QueryPlan &plan) {
+    std::vector<key_t> keys;
+    const FieldIndex *index = Indexes();
+    std::vector<key_t> candidates;
+    if (index != nullptr && plan.Candidates(*index, candidates)) {
+        for (const auto &key : candidates)
+            Get(key, [&](const value_t &value) {
+                if (plan.Matches(value)) keys.push_back(key);
+            });
+        return keys;
+    }
+    return CollectKeys(
+        [&plan](const value_t &value) { return plan.Matches(value); }, false);
+}
+
+}  // namespace storage
@@ -0,0 +1,93 @@
+#pragma once
+
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "field_index.h"
+
+namespace storage {
+
+// Condition on the fields of a record, built from equality, inclusive
+// ranges and prefixes, and combined with &&, || and !. Text conditions
+// take kSurname, kName or kCity, numeric ones kBirthYear or kCountCoins;
+// any other field throws std::invalid_argument. Copies share the tree.
+class Predicate {
+   public:
+    static Predicate Equal(IndexField field, std::string text);
+    static Predicate Equal(IndexField field, long number);
+    static Predicate Between(IndexField field, long low, long high);
+    static Predicate Prefix(IndexField field, std::string prefix);
+
+    Predicate operator&&(const Predicate &other) const;
+    Predicate operator||(const Predicate &other) const;
+    Predicate operator!() const;
+
+   private:
+    friend class QueryPlan;
+
+    enum class Op { kEqual, kBetween, kPrefix, kAnd, kOr, kNot };
+    struct Node {
+        Op op;
+        IndexField field = IndexField::kSurname;
+        std::string text;
+        long low = 0;
+        long high = 0;
+        std::vector<Predicate> children;
+    };
+
+    explicit Predicate(Node node);
+    static Predicate Combine(Op op, const Predicate &lhs,
+                             const Predicate &rhs);
+
+    std::shared_ptr<const Node> node_;
+};
+
+// A predicate compiled for evaluation against many records. Equality on an
+// interned field compares pointers when the value was already interned at
+// compile time, and text otherwise. The operands of && and || are ordered
+// cheapest first, so integer tests short-circuit before any string is
+// compared.
+class QueryPlan {
+   public:
+    explicit QueryPlan(const Predicate &predicate);
+
+    bool Matches(const Data &value) const { return Evaluate(root_, value); }
+    // Fills keys with a superset of the matches from the hash and ordered
+    // indexes, when the plan can be answered from them; returns false when
+    // it needs a full scan instead. Candidates still go through Matches.
+    bool Candidates(const FieldIndex &index, std::vector<key_t> &keys) const;
+
+   private:
+    enum class Op {
+        kFalse,
+        kTrue,
+        kNumber,
+        kInterned,
+        kText,
+        kPrefix,
+        kAnd,
+        kOr,
+        kNot
+    };
+    struct Step {
+        Op op;
+        IndexField field = IndexField::kSurname;
+        const std::string *interned = nullptr;
+        std::string text;
+        long low = 0;
+        long high = 0;
+        unsigned int cost = 0;
+        std::vector<Step> children;
+    };
+
+    static Step Compile(const Predicate::Node &node);
+    static Step Constant(bool value);
+    static bool Evaluate(const Step &step, const Data &value);
+    static bool Candidates(const Step &step, const FieldIndex &index,
+                           std::vector<key_t> &keys);
+
+    Step root_;
+};
+
+}  // namespace storage
@@ -0,0 +1,151 @@
+#include "record_io.h"
+
+#include <algorithm>
+#include <charconv>
+#include <cstring>
+
+namespace storage {
+
+namespace {
+
+bool IsSpace(char c) { return c == ' ' || c == '\t' || c == '\r'; }
+
+void SkipSpaces(std::string_view &line) {
+    while (!line.empty() && IsSpace(line.front())) line.remove_prefix(1);
+}
+
+bool ParseText(std::string_view &line, std::string_view &field) {
+    SkipSpaces(line);
+    if (line.empty()) return false;
+    std::size_t end;
+    if (line.front() == '"') {
+        end = line.find('"', 1);
+        if (end == std::string_view::npos) return false;
+        field = line.substr(1, end - 1);
+        ++end;
+    } else {
+        end = 0;
+        while (end < line.size() && !IsSpace(line[end])) ++end;
+        field = line.substr(0, end);
+    }
+    line.remove_prefix(end);
+    return true;
+}
+
+template <typename Number>
+bool ParseNumber(std::string_view &line, Number &number) {
+    SkipSpaces(line);
+    const auto [end, error] =
+        std::from_chars(line.data(), line.data() + line.size(), number);
+    if (error != std::errc()) return false;
+    line.remove_prefix(static_cast<std::size_t>(end - line.data()));
+    return true;
+}
+
+}  // namespace
+
+RecordReader::RecordReader(const std::string &filename)
+    : file_(filename), rest_(file_.View()) {}
+
+std::size_t RecordReader::CountLines() const {
+    std::size_t lines = 0;
+    const char *current = file_.Data();
+    const char *end = current + file_.Size();
+    while (current < end) {
+        const void *newline = std::memchr(
+            current, '\n', static_cast<std::size_t>(end - current));
+        ++lines;
+        if (newline == nullptr) break;
+        current = static_cast<const char *>(newline) + 1;
+    }
+    return lines;
+}
+
+std::vector<std::string_view> RecordReader::Split(std::size_t parts) const {
+    std::vector<std::string_view> chunks;
+    const char *data = file_.Data();
+    const std::size_t size = file_.Size();
+    const std::size_t step = size / std::max<std::size_t>(parts, 1) + 1;
+    std::size_t begin = 0;
+    while (begin < size) {
+        std::size_t end = std::min(begin + step, size);
+        const void *newline =
+            std::memchr(data + end - 1, '\n', size - end + 1);
+        end = newline == nullptr
+                  ? size
+                  : static_cast<std::size_t>(
+                        static_cast<const char *>(newline) - data + 1);
+        chunks.emplace_back(data + begin, end - begin);
+        begin = end;
+    }
+    return chunks;
+}
+
+bool RecordReader::Next(std::string_view &chunk, key_t &key, Data &value) {
+    while (!chunk.empty()) {
+        const std::size_t length = std::min(chunk.find('\n'), chunk.size());
+        const std::string_view line = chunk.substr(0, length);
+        chunk.remove_prefix(std::min(length + 1, chunk.size()));
+        if (ParseLine(line, key, value)) return true;
+    }
+    return false;
+}
+
+bool RecordReader::ParseLine(std::string_view line, key_t &key, Data &value) {
+    std::string_view key_field, surname, name, city;
+    int birth_year;
+    long count_coins;
+    if (!ParseText(line, key_field) || !ParseText(line, surname) ||
+        !ParseText(line, name) || !ParseNumber(line, birth_year) ||
+        !ParseText(line, city) || !ParseNumber(line, count_coins))
+        return false;
+    std::optional<unsigned long> time_life;
+    unsigned long ttl;
+    if (ParseNumber(line, ttl)) time_life = ttl;
+    key.assign(key_field);
+    value = Data(std::string(surname), std::string(name), birth_year,
+                 std::string(city), count_coins, time_life);
+    return true;
+}
+
+void WriteRecord(std::ostream &out, const key_t &key, const Data &value) {
+    out << key << " \"" << value.GetSurname() << "\" \"" << value.GetName()
+        << "\" " << value.GetBirthYear() << " \"" << value.GetCity() << "\" "
+        << value.GetCountCoins();
+    if (const auto ttl = value.TTL()) out << ' ' << *ttl;
+    out << '\n';
+}
+
+BufferedOutput::Buffer::Buffer(std::ostream &out)
+    : out_(out), block_(kBlockSize) {
+    setp(block_.data(), block_.data() + block_.size());
+}
+
+BufferedOutput::Buffer::int_type BufferedOutput::Buffer::overflow(
+    int_type ch) {
+    if (!Drain()) return traits_type::eof();
+    if (!traits_type::eq_int_type(ch, traits_type::eof())) {
+        *pptr() = traits_type::to_char_type(ch);
+        pbump(1);
+    }
+    return traits_type::not_eof(ch);
+}
+
+bool BufferedOutput::Buffer::Drain() {
+    out_.write(pbase(), pptr() - pbase());
+    setp(block_.data(), block_.data() + block_.size());
+    return static_cast<bool>(out_);
+}
+
+int BufferedOutput::Buffer::sync() {
+    return Drain() && out_.flush() ? 0 : -1;
+}
+
+BufferedOutput::BufferedOutput(std::ostream &out)
+    : std::ostream(nullptr), buffer_(out) {
+    rdbuf(&buffer_);
+}
+
+BufferedOutput::~BufferedOutput() { flush(); }
+
+}  // namespace storage
@@ -0,0 +1,73 @@
+#pragma once
+
+#include <ostream>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "data.h"
+#include "mapped_file.h"
+
+namespace storage {
+
+// Reads the text format written by WriteRecord: one record per line,
+//   key "surname" "name" birth_year "city" count_coins [ttl]
+// The file is memory-mapped and parsed in place, so loading does not go
+// through iostreams or allocate per line beyond the record's own strings.
+class RecordReader {
+   public:
+    explicit RecordReader(const std::string &filename);
+    RecordReader(const RecordReader &other) = delete;
+    RecordReader &operator=(const RecordReader &other) = delete;
+    ~RecordReader() = default;
+
+    std::size_t CountLines() const;
+    bool Next(key_t &key, Data &value) { return Next(rest_, key, value); }
+
+    // Cuts the file into at most `parts` pieces that start and end on line
+    // boundaries; each one can then be parsed on its own thread with the
+    // static Next.
+    std::vector<std::string_view> Split(std::size_t parts) const;
+    static bool Next(std::string_view &chunk, key_t &key, Data &value);
+
+   private:
+    static bool ParseLine(std::string_view line, key_t &key, Data &value);
+
+    MappedFile file_;
+    std::string_view rest_;
+};
+
+void WriteRecord(std::ostream &out, const key_t &key, const Data &value);
+
+// Stream that gathers what is written to it and hands it on to `out` in
+// 64 KiB blocks, so a listing of millions of rows costs a few large writes
+// instead of a write and a flush per line. Flushes `out` when destroyed.
+class BufferedOutput : public std::ostream {
+   public:
+    explicit BufferedOutput(std::ostream &out);
+    BufferedOutput(const BufferedOutput &other) = delete;
+    BufferedOutput &operator=(const BufferedOutput &other) = delete;
+    ~BufferedOutput();
+
+   private:
+    class Buffer : public std::streambuf {
+       public:
+        explicit Buffer(std::ostream &out);
+
+       protected:
+        int_type overflow(int_type ch) override;
+        int sync() override;
+
+       private:
+        bool Drain();
+
+        static constexpr std::size_t kBlockSize = 1 << 16;
+
+        std::ostream &out_;
+        std::vector<char> block_;
+    };
+
+    Buffer buffer_;
+};
+
+}  // namespace storage
@@ -0,0 +1,81 @@
+#include "scan.h"
+
+#include <algorithm>
+#include <stdexcept>
+
+namespace storage {
+
+key_t PrefixEnd(const key_t &prefix) {
+    key_t end = prefix;
+    while (!end.empty()) {
+        const auto last = static_cast<unsigned char>(end.back());
+        if (last != 0xff) {
+            end.back() = static_cast<char>(last + 1);
+            return end;
+        }
+        end.pop_back();
+    }
+    return end;
+}
+
+unsigned int VisitSorted(
+    std::vector<std::pair<const key_t *, const Data *>> &records,
+    std::size_t limit,
+    const std::function<void(const key_t &, const Data &)> &visitor) {
+    const auto by_key = [](const auto &lhs, const auto &rhs) {
+        return *lhs.first < *rhs.first;
+    };
+    if (limit == 0 || limit >= records.size()) {
+        limit = records.size();
+        std::sort(records.begin(), records.end(), by_key);
+    } else {
+        std::partial_sort(records.begin(),
+                          records.begin() + static_cast<std::ptrdiff_t>(limit),
+                          records.end(), by_key);
+    }
+    for (std::size_t i = 0; i < limit; ++i)
+        visitor(*records[i].first, *records[i].second);
+    return static_cast<unsigned int>(limit);
+}
+
+std::uint64_t NextBucket(std::uint64_t bucket, std::uint64_t base,
+                         unsigned int bits) {
+    const auto reverse = [bits](std::uint64_t value) {
+        std::uint64_t reversed = 0;
+        for (unsigned int i = 0; i < bits; ++i, value >>= 1)
+            reversed = (reversed << 1) | (value & 1);
+        return reversed;
+    };
+    std::uint64_t low = bucket % base;
+    std::uint64_t high = reverse(bucket / base) + 1;
+    if (high >> bits != 0) {
+        high = 0;
+        if (++low == base) return 0;
+    }
+    return low + base * reverse(high);
+}
+
+unsigned int BucketBits(std::uint64_t size, std::uint64_t base) {
+    unsigned int bits = 0;
+    while ((base << bits) < size) ++bits;
+    return bits;
+}
+
+std::uint64_t DecodeCursor(const std::string &cursor) {
+    if (cursor.empty()) return 0;
+    std::size_t parsed = 0;
+    std::uint64_t value = 0;
+    try {
+        value = std::stoull(cursor, &parsed);
+    } catch (const std::exception &) {
+        parsed = 0;
+    }
+    if (parsed != cursor.size()) throw std::invalid_argument("Cursor Error!");
+    return value;
+}
+
+std::string EncodeCursor(std::uint64_t cursor) {
+    return cursor == 0 ? std::string() : std::to_string(cursor);
+}
+
+}  // namespace storage
@@ -0,0 +1,54 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <functional>
+#include <utility>
+#include <vector>
+
+#include "data.h"
+
+namespace storage {
+
+// Scan bounds are half-open, [from, to), and an empty `to` leaves the range
+// unbounded above.
+inline bool InRange(const key_t &key, const key_t &from, const key_t &to) {
+    return !(key < from) && (to.empty() || key < to);
+}
+
+// Smallest key greater than every key that starts with prefix, or an empty
+// key when there is none (the prefix is empty or all 0xff bytes).
+key_t PrefixEnd(const key_t &prefix);
+
+// Sorted fallback for the engines that do not keep their keys in order:
+// sorts the gathered records by key and visits the first `limit` of them
+// (all of them for 0). Returns the number visited.
+unsigned int VisitSorted(
+    std::vector<std::pair<const key_t *, const Data *>> &records,
+    std::size_t limit,
+    const std::function<void(const key_t &, const Data &)> &visitor);
+
+// Bucket order for SCAN-style cursors over a hash table of base << bits
+// buckets where a key lives in bucket hash % size, so that doubling the
+// table splits bucket b into b and b + size. The bits above base advance
+// in reverse, so every bucket a cursor has passed maps, after any number
+// of doublings, onto buckets the cursor is still past. Returns 0 after
+// the last bucket.
+std::uint64_t NextBucket(std::uint64_t bucket, std::uint64_t base,
+                         unsigned int bits);
+unsigned int BucketBits(std::uint64_t size, std::uint64_t base);
+
+// Slice `part` of `parts` nearly equal slices of the positions [0, size),
+// as [first, second).
+inline std::pair<std::size_t, std::size_t> PartRange(std::size_t part,
+                                                     std::size_t parts,
+                                                     std::size_t size) {
+    return {part * size / parts, (part + 1) * size / parts};
+}
+
+// Hash engine cursors travel as decimal text; an empty one is bucket 0.
+std::uint64_t DecodeCursor(const std::string &cursor);
+std::string EncodeCursor(std::uint64_t cursor);
+
+}  // namespace storage
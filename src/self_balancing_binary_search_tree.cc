@@ -1,138 +1,180 @@
 #include "self_balancing_binary_search_tree.h"
 
+#include <algorithm>
+
 namespace storage {
 
+template <typename Key, typename Value>
+bool SelfBalancingBinarySearchTree::Emplace(Key &&key, Value &&value) {
+    auto result = data_.search(key);
+    if (result.second) {
+        if (!(*result.first).second.IsExpired()) return false;
+        index_.Remove((*result.first).first, (*result.first).second);
+        (*result.first).second = std::forward<Value>(value);
+    } else {
+        result = data_.insert(std::forward<Key>(key), std::forward<Value>(value));
+    }
+    expiry_.Add((*result.first).first, (*result.first).second);
+    index_.Add((*result.first).first, (*result.first).second);
+    return true;
+}
+
 bool SelfBalancingBinarySearchTree::Set(const key_t &key,
                                         const value_t &value) {
-    return data_.insert(std::make_pair(key, value)).second;
+    return Emplace(key, value);
+}
+
+bool SelfBalancingBinarySearchTree::Set(key_t &&key, value_t &&value) {
+    return Emplace(std::move(key), std::move(value));
+}
+
+const value_t *SelfBalancingBinarySearchTree::Lookup(const key_t &key) {
+    auto [iterator, is_find] = data_.search(key);
+    if (!is_find || (*iterator).second.IsExpired()) return nullptr;
+    return &(*iterator).second;
 }
 
 std::optional<value_t> SelfBalancingBinarySearchTree::Get(const key_t &key) {
-    if (!Exists(key)) return std::nullopt;
-    return std::make_optional(data_[key]);
+    const value_t *value = Lookup(key);
+    if (value == nullptr) return std::nullopt;
+    return *value;
+}
+
+bool SelfBalancingBinarySearchTree::Get(const key_t &key,
+                                        const reader_t &reader) {
+    const value_t *value = Lookup(key);
+    if (value == nullptr) return false;
+    reader(*value);
+    return true;
 }
 
 bool SelfBalancingBinarySearchTree::Exists(const key_t &key) {
-    return data_.contains(key);
+    return Lookup(key) != nullptr;
 }
 
 bool SelfBalancingBinarySearchTree::Rename(const key_t &old_key,
                                            const key_t &new_key) {
-    if (!data_.contains(old_key) || data_.contains(new_key)) return false;
-    auto node = data_[old_key];
-    Del(old_key);
-    data_.insert(std::make_pair(new_key, node));
+    if (Lookup(old_key) == nullptr || Exists(new_key)) return false;
+    // Sweeps an expired record under new_key before the move.
+    Del(new_key);
+    auto *node = data_.extract(data_.search(old_key).first);
+    expiry_.Remove(node->data.first);
+    index_.Remove(node->data.first, node->data.second);
+    node->data.first = new_key;
+    data_.reinsert(node);
+    expiry_.Add(node->data.first, node->data.second);
+    index_.Add(node->data.first, node->data.second);
     return true;
 }
 
+// As in HashTable, an expired record is swept but does not count.
 bool SelfBalancingBinarySearchTree::Del(const key_t &key) {
     auto [iterator, is_find] = data_.search(key);
     if (!is_find) return false;
+    const bool live = !(*iterator).second.IsExpired();
+    expiry_.Remove(key);
+    index_.Remove((*iterator).first, (*iterator).second);
     data_.erase(iterator);
-    return true;
+    return live;
 }
 
 std::vector<key_t> SelfBalancingBinarySearchTree::Keys() const {
-    std::vector<key_t> keys;
-    for (auto node : data_) keys.push_back(node.first);
-    return keys;
+    return CollectKeys([](const value_t &) { return true; }, false);
+}
+
+std::size_t SelfBalancingBinarySearchTree::Size() const {
+    return data_.size();
 }
 
 bool SelfBalancingBinarySearchTree::Update(const key_t &key,
                                            const optional_value_t &value) {
     auto [iterator, is_find] = data_.search(key);
-    if (!is_find) return false;
-    if (value.surname) (*iterator).second.SetSurname(*value.surname);
-    if (value.name) (*iterator).second.SetName(*value.name);
-    if (value.birth_year) (*iterator).second.SetBirthYear(*value.birth_year);
-    if (value.city) (*iterator).second.SetCity(*value.city);
-    if (value.count_coins) (*iterator).second.SetCountCoins(*value.count_coins);
-    if (value.expiry_time) (*iterator).second.SetTimeLife(*value.expiry_time);
+    if (!is_find || (*iterator).second.IsExpired()) return false;
+    ApplyUpdate(key, value, (*iterator).second, index_, expiry_);
     return true;
 }
 
-unsigned int SelfBalancingBinarySearchTree::Upload(
-    const std::string &filename) {
-    std::ifstream file(filename);
-    if (!file.is_open()) throw std::invalid_argument("File Error!");
-    std::string line;
-    unsigned int count = 0;
-    while (std::getline(file, line)) {
-        std::istringstream iss(line);
-        std::string key, surname, name, city;
-        int birth_year;
-        long count_coins, time_life;
-        if (!(iss >> key)) continue;
-        std::getline(iss >> std::ws, surname, ' ');
-        std::getline(iss >> std::ws, name, ' ');
-        iss >> birth_year >> std::ws;
-        std::getline(iss >> std::ws, city, ' ');
-        iss >> count_coins >> time_life;
-        value_t value(surname, name, birth_year, city, count_coins, time_life);
-        if (Set(key, value)) count++;
-    }
-    return count;
-}
+// Nodes are allocated one at a time, so there is nothing to size up front.
+void SelfBalancingBinarySearchTree::Reserve(std::size_t) {}
 
-std::string SelfBalancingBinarySearchTree::TTL(const key_t &key) {
-    auto [iterator, is_find] = data_.search(key);
-    if (!is_find) return "null";
-    return (*iterator).second.TTL()
-               ? std::to_string(*((*iterator).second.TTL()))
-               : "null";
+unsigned int SelfBalancingBinarySearchTree::BulkLoad(
+    std::vector<record_t> &&records, ThreadPool &) {
+    return Load(std::move(records));
 }
 
-unsigned int SelfBalancingBinarySearchTree::Export(
-    const std::string &filename) {
-    std::ofstream file(filename);
-    if (!file.is_open()) throw std::invalid_argument("File Error!");
+unsigned int SelfBalancingBinarySearchTree::Load(
+    std::vector<record_t> &&records) {
+    if (!data_.empty()) {
+        unsigned int count = 0;
+        for (auto &[key, value] : records)
+            if (Emplace(std::move(key), std::move(value))) ++count;
+        return count;
+    }
+    // An empty tree is built in one pass from the sorted records instead of
+    // being rebalanced after every insert.
+    data_.assignSorted(SortedByKey(std::move(records)));
     for (const auto &[key, value] : data_) {
-        file << key << " ";
-        file << "\"" << value.GetSurname() << "\" ";
-        file << "\"" << value.GetName() << "\" ";
-        file << value.GetBirthYear() << " ";
-        file << "\"" << value.GetCity() << "\" ";
-        file << value.GetCountCoins() << " ";
-        if (value.GetTimeLife()) file << *value.GetTimeLife() << std::endl;
+        expiry_.Add(key, value);
+        index_.Add(key, value);
     }
-    return 0;
+    return static_cast<unsigned int>(data_.size());
 }
 
-void SelfBalancingBinarySearchTree::Print() const {
-    for (auto it = data_.begin(); it != data_.end(); ++it) {
-        (*it).second.Print((*it).first);
-    }
+bool SelfBalancingBinarySearchTree::CreateIndex(IndexField field) {
+    if (!index_.Enable(field)) return false;
+    for (const auto &[key, value] : data_) index_.Add(key, value);
+    return true;
 }
 
-void SelfBalancingBinarySearchTree::ShowAll() const {
-    std::cout << std::setw(5) << "№"
-              << " | " << std::setw(13) << "Фамилия"
-              << " | " << std::setw(13) << "Имя"
-              << " | " << std::setw(5) << "Год"
-              << " | " << std::setw(13) << "Город"
-              << " | " << std::setw(14) << "Количество коинов"
-              << " |" << std::endl;
-    Print();
+void SelfBalancingBinarySearchTree::ForEach(const visitor_t &visitor) const {
+    for (const auto &[key, value] : data_) visitor(key, value);
 }
 
-void SelfBalancingBinarySearchTree::DeleteOldData() {
-    for (auto it = data_.begin(); it != data_.end(); ++it)
-        if (!(*it).second.TTL()) Del((*it).first);
+void SelfBalancingBinarySearchTree::ForEachPart(
+    std::size_t part, std::size_t parts, const visitor_t &visitor) const {
+    const auto bounds = data_.split(parts);
+    if (part + 1 >= bounds.size()) return;
+    for (auto it = bounds[part]; it != bounds[part + 1]; ++it)
+        visitor((*it).first, (*it).second);
 }
 
+unsigned int SelfBalancingBinarySearchTree::Scan(const key_t &from,
+                                                 const key_t &to,
+                                                 std::size_t limit,
+                                                 const visitor_t &visitor) {
+    unsigned int count = 0;
+    const long now = Data::Now();
+    for (auto it = data_.lower_bound(from);
+         it != data_.end() && (limit == 0 || count < limit); ++it) {
+        const auto &[key, value] = *it;
+        if (!to.empty() && !(key < to)) break;
+        if (value.IsExpired(now)) continue;
+        visitor(key, value);
+        ++count;
+    }
+    return count;
+}
+
+// As in BPlusTree, the cursor is the key to resume at.
+std::string SelfBalancingBinarySearchTree::ScanKeys(const std::string &cursor,
+                                                    std::size_t count,
+                                                    std::vector<key_t> &keys) {
+    const long now = Data::Now();
+    count = std::max<std::size_t>(count, 1);
+    for (auto it = data_.lower_bound(cursor); it != data_.end(); ++it) {
+        const auto &[key, value] = *it;
+        if (value.IsExpired(now)) continue;
+        if (count-- == 0) return key;
+        keys.push_back(key);
+    }
+    return key_t();
+}
+
+void SelfBalancingBinarySearchTree::DeleteOldData() { SweepExpired(expiry_); }
+
 std::vector<std::string> SelfBalancingBinarySearchTree::Find(
     const optional_value_t &value) {
-    std::vector<std::string> result;
-    for (const auto &[key, data] : data_) {
-        if ((value.surname && data.GetSurname() == *value.surname) ||
-            (value.name && data.GetName() == *value.name) ||
-            (value.birth_year && data.GetBirthYear() == *value.birth_year) ||
-            (value.city && data.GetCity() == *value.city) ||
-            (value.count_coins && data.GetCountCoins() == *value.count_coins)) {
-            result.push_back(key);
-        }
-    }
-    return result;
+    return FindLive(index_, value, false);
 }
 
 }  // namespace storage
\ No newline at end of file
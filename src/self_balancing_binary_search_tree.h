@@ -1,6 +1,7 @@
 #pragma once
 
 #include "base_storage.h"
+#include "expiry_index.h"
 #include "tree/stl_map.h"
 
 namespace storage {
@@ -18,23 +19,41 @@ class SelfBalancingBinarySearchTree : public BaseStorage {
         const SelfBalancingBinarySearchTree &&) = delete;
 
     bool Set(const key_t &key, const value_t &value) override final;
+    bool Set(key_t &&key, value_t &&value) override final;
     std::optional<value_t> Get(const key_t &key) override final;
+    bool Get(const key_t &key, const reader_t &reader) override final;
     bool Rename(const key_t &old_key, const key_t &new_key) override final;
     bool Del(const key_t &key) override final;
     std::vector<key_t> Keys() const override final;
+    std::size_t Size() const override final;
     bool Update(const key_t &key, const optional_value_t &value) override final;
     bool Exists(const key_t &key) override final;
     std::vector<std::string> Find(const optional_value_t &value) override final;
-    std::string TTL(const key_t &key) override final;
-    unsigned int Upload(const std::string &filename) override final;
-    unsigned int Export(const std::string &filename) override final;
-    void ShowAll() const override final;
+    void ForEach(const visitor_t &visitor) const override final;
+    void ForEachPart(std::size_t part, std::size_t parts,
+                     const visitor_t &visitor) const override final;
+    unsigned int Scan(const key_t &from, const key_t &to, std::size_t limit,
+                      const visitor_t &visitor) override final;
+    std::string ScanKeys(const std::string &cursor, std::size_t count,
+                         std::vector<key_t> &keys) override final;
     void DeleteOldData() override final;
+    bool CreateIndex(IndexField field) override final;
+    void Reserve(std::size_t count) override final;
+    unsigned int BulkLoad(std::vector<record_t> &&records,
+                          ThreadPool &pool) override final;
+
+   protected:
+    const FieldIndex *Indexes() const override final { return &index_; }
 
    private:
-    void Print() const;
+    unsigned int Load(std::vector<record_t> &&records);
+    const value_t *Lookup(const key_t &key);
+    template <typename Key, typename Value>
+    bool Emplace(Key &&key, Value &&value);
 
     stl::map<key_t, value_t> data_;
+    ExpiryIndex expiry_;
+    FieldIndex index_;
 };
 
 }  // namespace storage
\ No newline at end of file
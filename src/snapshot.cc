@@ -0,0 +1,280 @@
+#include "snapshot.h"
+
+#include <fcntl.h>
+#include <sys/uio.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <array>
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <stdexcept>
+
+namespace storage {
+
+namespace {
+
+constexpr char kMagic[8] = {'K', 'V', 'S', 'N', 'A', 'P', '\0', '\0'};
+constexpr std::uint32_t kVersion = 1;
+constexpr std::size_t kHeaderSize =
+    sizeof(kMagic) + 2 * sizeof(std::uint32_t);
+constexpr std::size_t kBlockHeaderSize = 3 * sizeof(std::uint32_t);
+
+void WriteAll(int fd, iovec *parts, int count) {
+    while (count > 0) {
+        ssize_t written = writev(fd, parts, count);
+        if (written < 0) {
+            if (errno == EINTR) continue;
+            throw std::invalid_argument("File Error!");
+        }
+        auto left = static_cast<std::size_t>(written);
+        while (count > 0 && left >= parts->iov_len) {
+            left -= parts->iov_len;
+            ++parts;
+            --count;
+        }
+        if (count > 0) {
+            parts->iov_base = static_cast<char *>(parts->iov_base) + left;
+            parts->iov_len -= left;
+        }
+    }
+}
+
+template <typename Number>
+Number Read(const char *data) {
+    Number number;
+    std::memcpy(&number, data, sizeof(number));
+    return number;
+}
+
+// Cursor over a verified block payload; the bounds checks guard against a
+// snapshot whose checksum matches but whose records are still malformed.
+class PayloadCursor {
+   public:
+    explicit PayloadCursor(std::string_view &payload) : payload_(payload) {}
+
+    template <typename Number>
+    Number Take() {
+        const char *data = Skip(sizeof(Number));
+        return Read<Number>(data);
+    }
+    std::string_view TakeString() {
+        const auto length = Take<std::uint32_t>();
+        return std::string_view(Skip(length), length);
+    }
+
+   private:
+    const char *Skip(std::size_t size) {
+        if (payload_.size() < size)
+            throw std::invalid_argument("Snapshot Error!");
+        const char *data = payload_.data();
+        payload_.remove_prefix(size);
+        return data;
+    }
+
+    std::string_view &payload_;
+};
+
+}  // namespace
+
+// Slicing-by-8: eight tables let the loop fold in a whole 64-bit word per
+// step instead of one byte. Like the rest of the format this assumes a
+// little-endian host.
+std::uint32_t Crc32(const char *data, std::size_t size, std::uint32_t crc) {
+    static const auto tables = [] {
+        std::array<std::array<std::uint32_t, 256>, 8> tables{};
+        for (std::uint32_t i = 0; i < 256; ++i) {
+            std::uint32_t value = i;
+            for (int bit = 0; bit < 8; ++bit)
+                value = (value >> 1) ^ ((value & 1) ? 0xEDB88320u : 0);
+            tables[0][i] = value;
+        }
+        for (std::uint32_t i = 0; i < 256; ++i)
+            for (std::size_t slice = 1; slice < 8; ++slice)
+                tables[slice][i] = (tables[slice - 1][i] >> 8) ^
+                                   tables[0][tables[slice - 1][i] & 0xff];
+        return tables;
+    }();
+    const auto *bytes = reinterpret_cast<const unsigned char *>(data);
+    crc = ~crc;
+    for (; size >= 8; size -= 8, bytes += 8) {
+        const std::uint32_t low = Read<std::uint32_t>(
+                                      reinterpret_cast<const char *>(bytes)) ^
+                                  crc;
+        const std::uint32_t high =
+            Read<std::uint32_t>(reinterpret_cast<const char *>(bytes + 4));
+        crc = tables[7][low & 0xff] ^ tables[6][(low >> 8) & 0xff] ^
+              tables[5][(low >> 16) & 0xff] ^ tables[4][low >> 24] ^
+              tables[3][high & 0xff] ^ tables[2][(high >> 8) & 0xff] ^
+              tables[1][(high >> 16) & 0xff] ^ tables[0][high >> 24];
+    }
+    for (; size > 0; --size, ++bytes)
+        crc = tables[0][(crc ^ *bytes) & 0xff] ^ (crc >> 8);
+    return ~crc;
+}
+
+SnapshotWriter::SnapshotWriter(const std::string &filename, std::uint32_t tag)
+    : filename_(filename),
+      temp_filename_(filename + ".tmp"),
+      fd_(open(temp_filename_.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644)),
+      now_(Data::Now()),
+      block_(kBlockSize + 1024),
+      used_(0),
+      block_records_(0),
+      count_(0) {
+    if (fd_ < 0) throw std::invalid_argument("File Error!");
+    char header[kHeaderSize] = {};
+    std::memcpy(header, kMagic, sizeof(kMagic));
+    std::memcpy(header + sizeof(kMagic), &kVersion, sizeof(kVersion));
+    std::memcpy(header + sizeof(kMagic) + sizeof(kVersion), &tag, sizeof(tag));
+    iovec part{header, sizeof(header)};
+    WriteAll(fd_, &part, 1);
+}
+
+SnapshotWriter::~SnapshotWriter() {
+    if (fd_ < 0) return;
+    close(fd_);
+    std::remove(temp_filename_.c_str());
+}
+
+void SnapshotWriter::PutBytes(const void *data, std::size_t size) {
+    if (block_.size() - used_ < size)
+        block_.resize(std::max(block_.size() * 2, used_ + size));
+    std::memcpy(block_.data() + used_, data, size);
+    used_ += size;
+}
+
+template <typename Number>
+void SnapshotWriter::PutNumber(Number number) {
+    PutBytes(&number, sizeof(number));
+}
+
+void SnapshotWriter::PutString(std::string_view text) {
+    PutNumber(static_cast<std::uint32_t>(text.size()));
+    PutBytes(text.data(), text.size());
+}
+
+void SnapshotWriter::Add(const key_t &key, const Data &value) {
+    if (value.IsExpired(now_)) return;
+    PutString(key);
+    PutString(value.GetSurname());
+    PutString(value.GetName());
+    PutNumber(static_cast<std::int32_t>(value.GetBirthYear()));
+    PutString(value.GetCity());
+    PutNumber(static_cast<std::int64_t>(value.GetCountCoins()));
+    const auto expiry = value.GetTimeLife();
+    PutNumber(static_cast<std::uint8_t>(expiry.has_value()));
+    PutNumber(static_cast<std::int64_t>(expiry.value_or(0)));
+    ++block_records_;
+    ++count_;
+    if (used_ >= kBlockSize) FlushBlock();
+}
+
+void SnapshotWriter::FlushBlock() {
+    std::uint32_t header[] = {block_records_, static_cast<std::uint32_t>(used_),
+                              Crc32(block_.data(), used_)};
+    iovec parts[] = {{header, sizeof(header)}, {block_.data(), used_}};
+    WriteAll(fd_, parts, used_ == 0 ? 1 : 2);
+    used_ = 0;
+    block_records_ = 0;
+}
+
+unsigned int SnapshotWriter::Finish() {
+    if (block_records_ > 0) FlushBlock();
+    FlushBlock();  // the empty end block
+    const bool synced = fsync(fd_) == 0;
+    close(fd_);
+    fd_ = -1;
+    if (!synced ||
+        std::rename(temp_filename_.c_str(), filename_.c_str()) != 0) {
+        std::remove(temp_filename_.c_str());
+        throw std::invalid_argument("File Error!");
+    }
+    return count_;
+}
+
+std::future<unsigned int> WriteSnapshotAsync(
+    std::unique_ptr<SnapshotWriter> writer,
+    std::vector<std::vector<std::pair<key_t, Data>>> &&parts) {
+    return std::async(std::launch::async, [writer = std::move(writer),
+                                           parts = std::move(parts)]() mutable {
+        for (auto &records : parts) {
+            for (const auto &[key, value] : records) writer->Add(key, value);
+            std::vector<std::pair<key_t, Data>>().swap(records);
+        }
+        return writer->Finish();
+    });
+}
+
+SnapshotReader::SnapshotReader(const std::string &filename)
+    : file_(filename),
+      tag_(0),
+      count_(0),
+      position_(kHeaderSize),
+      block_records_(0) {
+    const char *data = file_.Data();
+    const std::size_t size = file_.Size();
+    if (size < kHeaderSize || std::memcmp(data, kMagic, sizeof(kMagic)) != 0 ||
+        Read<std::uint32_t>(data + sizeof(kMagic)) != kVersion)
+        throw std::invalid_argument("Snapshot Error!");
+    tag_ = Read<std::uint32_t>(data + sizeof(kMagic) + sizeof(std::uint32_t));
+    for (std::size_t offset = kHeaderSize;;) {
+        if (size - offset < kBlockHeaderSize)
+            throw std::invalid_argument("Snapshot Error!");
+        const auto records = Read<std::uint32_t>(data + offset);
+        const auto length = Read<std::uint32_t>(data + offset + 4);
+        const auto crc = Read<std::uint32_t>(data + offset + 8);
+        offset += kBlockHeaderSize;
+        if (size - offset < length || Crc32(data + offset, length) != crc)
+            throw std::invalid_argument("Snapshot Error!");
+        offset += length;
+        if (records == 0 && length == 0) break;
+        count_ += records;
+    }
+}
+
+std::uint32_t SnapshotReader::ReadTag(const std::string &filename) {
+    std::ifstream file(filename, std::ios::binary);
+    if (!file.is_open()) throw std::invalid_argument("File Error!");
+    char header[kHeaderSize];
+    if (!file.read(header, sizeof(header)) ||
+        std::memcmp(header, kMagic, sizeof(kMagic)) != 0 ||
+        Read<std::uint32_t>(header + sizeof(kMagic)) != kVersion)
+        throw std::invalid_argument("Snapshot Error!");
+    return Read<std::uint32_t>(header + sizeof(kMagic) +
+                               sizeof(std::uint32_t));
+}
+
+bool SnapshotReader::NextBlock() {
+    const char *block = file_.Data() + position_;
+    const auto records = Read<std::uint32_t>(block);
+    const auto length = Read<std::uint32_t>(block + 4);
+    if (records == 0 && length == 0) return false;
+    block_records_ = records;
+    block_ = std::string_view(block + kBlockHeaderSize, length);
+    position_ += kBlockHeaderSize + length;
+    return true;
+}
+
+bool SnapshotReader::Next(key_t &key, Data &value) {
+    while (block_records_ == 0)
+        if (!NextBlock()) return false;
+    PayloadCursor cursor(block_);
+    key.assign(cursor.TakeString());
+    std::string surname(cursor.TakeString());
+    std::string name(cursor.TakeString());
+    const auto birth_year = cursor.Take<std::int32_t>();
+    std::string city(cursor.TakeString());
+    const auto count_coins = cursor.Take<std::int64_t>();
+    const auto has_expiry = cursor.Take<std::uint8_t>();
+    const auto expiry = cursor.Take<std::int64_t>();
+    value = Data(std::move(surname), std::move(name), birth_year,
+                 std::move(city), static_cast<long>(count_coins));
+    if (has_expiry) value.SetExpiryTime(static_cast<long>(expiry));
+    --block_records_;
+    return true;
+}
+
+}  // namespace storage
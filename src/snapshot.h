@@ -0,0 +1,93 @@
+#pragma once
+
+#include <cstdint>
+#include <future>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "data.h"
+#include "mapped_file.h"
+
+namespace storage {
+
+// Binary snapshot layout, all integers in native byte order:
+//   header  "KVSNAP\0\0", uint32 version, uint32 tag
+//   blocks  uint32 records, uint32 payload size, uint32 CRC-32 of payload,
+//           payload
+//   end     a block with zero records and an empty payload
+// Each record in a payload is: key, surname, name (uint32 length + bytes),
+// int32 birth year, city, int64 count of coins, uint8 has expiry and
+// int64 absolute expiry in seconds since the epoch. The tag is free for the
+// caller; the write-ahead log stores its generation there.
+class SnapshotWriter {
+   public:
+    explicit SnapshotWriter(const std::string &filename,
+                            std::uint32_t tag = 0);
+    SnapshotWriter(const SnapshotWriter &other) = delete;
+    SnapshotWriter &operator=(const SnapshotWriter &other) = delete;
+    ~SnapshotWriter();
+
+    void Add(const key_t &key, const Data &value);
+    // Writes the end marker and moves the file into place; until then the
+    // snapshot lives next to the target under a temporary name, so a crash
+    // never leaves a half-written snapshot behind.
+    unsigned int Finish();
+
+   private:
+    static constexpr std::size_t kBlockSize = std::size_t{1} << 20;
+
+    void FlushBlock();
+    void PutBytes(const void *data, std::size_t size);
+    void PutString(std::string_view text);
+    template <typename Number>
+    void PutNumber(Number number);
+
+    std::string filename_;
+    std::string temp_filename_;
+    int fd_;
+    long now_;
+    std::vector<char> block_;
+    std::size_t used_;
+    std::uint32_t block_records_;
+    unsigned int count_;
+};
+
+// Maps a snapshot and checks the header and every block's checksum up
+// front, so a corrupt file is rejected before anything is loaded.
+class SnapshotReader {
+   public:
+    explicit SnapshotReader(const std::string &filename);
+    SnapshotReader(const SnapshotReader &other) = delete;
+    SnapshotReader &operator=(const SnapshotReader &other) = delete;
+    ~SnapshotReader() = default;
+
+    std::size_t Count() const { return count_; }
+    std::uint32_t Tag() const { return tag_; }
+    // Reads only the header, without mapping or verifying the file.
+    static std::uint32_t ReadTag(const std::string &filename);
+    bool Next(key_t &key, Data &value);
+
+   private:
+    bool NextBlock();
+
+    MappedFile file_;
+    std::uint32_t tag_;
+    std::size_t count_;
+    std::size_t position_;
+    std::string_view block_;
+    std::uint32_t block_records_;
+};
+
+// Adds the records, slice by slice, and finishes the snapshot on a
+// background thread, freeing each slice once it is written. The future
+// yields the number of records written or rethrows the write error.
+std::future<unsigned int> WriteSnapshotAsync(
+    std::unique_ptr<SnapshotWriter> writer,
+    std::vector<std::vector<std::pair<key_t, Data>>> &&parts);
+
+std::uint32_t Crc32(const char *data, std::size_t size,
+                    std::uint32_t crc = 0);
+
+}  // namespace storage
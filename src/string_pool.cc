@@ -0,0 +1,45 @@
+#include "string_pool.h"
+
+#include <functional>
+#include <limits>
+#include <mutex>
+
+namespace storage {
+
+// As in ConcurrentHashTable, the shard comes from the high bits of the
+// hash and the shard's map picks buckets from the low ones.
+StringPool::Shard &StringPool::ShardOf(std::string_view text) {
+    static StringPool pool;
+    const std::size_t hash = std::hash<std::string_view>{}(text);
+    return pool.shards_[hash >> (std::numeric_limits<std::size_t>::digits -
+                                 kShardBits)];
+}
+
+const std::string *StringPool::Empty() {
+    static const std::string *empty = Intern("");
+    return empty;
+}
+
+const std::string *StringPool::Find(std::string_view text) {
+    Shard &shard = ShardOf(text);
+    std::shared_lock lock(shard.mutex);
+    auto found = shard.index.find(text);
+    return found != shard.index.end() ? found->second : nullptr;
+}
+
+const std::string *StringPool::Intern(std::string_view text) {
+    Shard &shard = ShardOf(text);
+    {
+        std::shared_lock lock(shard.mutex);
+        auto found = shard.index.find(text);
+        if (found != shard.index.end()) return found->second;
+    }
+    std::unique_lock lock(shard.mutex);
+    auto found = shard.index.find(text);
+    if (found != shard.index.end()) return found->second;
+    const std::string *interned = &shard.strings.emplace_back(text);
+    shard.index.emplace(*interned, interned);
+    return interned;
+}
+
+}  // namespace storage
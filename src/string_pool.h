@@ -0,0 +1,42 @@
+#pragma once
+
+#include <array>
+#include <deque>
+#include <shared_mutex>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+
+namespace storage {
+
+// Process-wide set of interned strings for the low-cardinality fields of a
+// record: every distinct value is stored once and records keep a pointer
+// to it, so equal values compare by address. Interned strings are never
+// freed, which is what keeps the pointers valid; the pool is meant for
+// fields with a bounded set of values, not for free text. The strings are
+// spread over shards by hash, each with its own lock, so that threads
+// interning different values seldom meet on one.
+class StringPool {
+   public:
+    static const std::string *Intern(std::string_view text);
+    static const std::string *Empty();
+    // The interned copy of text, or nullptr when it was never interned.
+    static const std::string *Find(std::string_view text);
+
+   private:
+    static constexpr unsigned int kShardBits = 4;
+    static constexpr std::size_t kShardCount = std::size_t{1} << kShardBits;
+
+    struct Shard {
+        std::shared_mutex mutex;
+        std::deque<std::string> strings;
+        std::unordered_map<std::string_view, const std::string *> index;
+    };
+
+    StringPool() = default;
+    static Shard &ShardOf(std::string_view text);
+
+    std::array<Shard, kShardCount> shards_;
+};
+
+}  // namespace storage
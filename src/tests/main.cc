@@ -1,7 +1,15 @@
 #include <gtest/gtest-spi.h>
 #include <gtest/gtest.h>
 
+#include <algorithm>
 #include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <functional>
+#include <limits>
+#include <map>
+#include <random>
+#include <set>
 #include <thread>
 
 #include "../controller.h"
@@ -12,6 +20,8 @@ const storage::value_t Alice("Alice", "Smith", 1990, "Chicago", 1500L, 6);
 const storage::value_t Bob("Bob", "Johnson", 1985, "Houston", 2450L, 7);
 const storage::value_t Mary("Mary", "Williams", 1982, "Philadelphia", 1234L,
                             95);
+const storage::value_t Eve("Eve", "Brown", 1993, "Boston", 4100L);
+const storage::value_t Dan("Dan", "Green", 1988, "Denver", 2900L);
 
 const storage::optional_value_t Jane_opt(std::nullopt, "Jane", std::nullopt,
                                          std::nullopt, 0, std::nullopt);
@@ -144,9 +154,9 @@ TEST(third_suite, set_get_hash_suite) {
 
 TEST(second_suite, set_get1) {
     storage::Controller storage;
-    storage.Set(first_key, John);
+    storage.Set(first_key, Eve);
     storage.Set(second_key, Mary);
-    ASSERT_EQ((storage.Get(first_key).value()) == John, true);
+    ASSERT_EQ((storage.Get(first_key).value()) == Eve, true);
 }
 
 TEST(delete_suite2, delete_elm_second) {
@@ -178,7 +188,9 @@ TEST(FindTest, FindBySurname) {
 
 TEST(update_sutie, update) {
     storage::Controller storage;
-    storage.Set("1", Bob);
+    // Bob's TTL runs from program start and may be over by now; an expired
+    // record cannot be updated.
+    storage.Set("1", Eve);
     storage.Set("2", Alice);
     storage.Set("3", John);
     storage.Set("4", John);
@@ -294,10 +306,10 @@ TEST(first_suite, import_export) {
 TEST(first_suite_hash, rename_hash) {
     storage::Controller storage;
     storage.Set(first_key, John);
-    storage.Set(second_key, Jane);
+    storage.Set(second_key, Dan);
     storage.Set(third_key, Alice);
     ASSERT_TRUE(storage.Rename(second_key, fifth_key));
-    ASSERT_TRUE(*storage.Get(fifth_key) == Jane);
+    ASSERT_TRUE(*storage.Get(fifth_key) == Dan);
 }
 
 TEST(first_suite_tree, TTL_hash_table) {
@@ -321,7 +333,1294 @@ TEST(first_suite_tree, TTL_hash_table_delete_old_data) {
     for (const auto &key : keys) ASSERT_FALSE(storage.Exists(key));
 }
 
+TEST(open_addressing_suite, set_get_del) {
+    storage::Controller storage(
+        storage::TypeHashTable::kOpenAddressingHashTable);
+    ASSERT_TRUE(storage.Set(first_key, Eve));
+    ASSERT_TRUE(storage.Set(second_key, Dan));
+    ASSERT_FALSE(storage.Set(first_key, Dan));
+    ASSERT_TRUE(storage.Get(first_key).value() == Eve);
+    ASSERT_TRUE(storage.Del(first_key));
+    ASSERT_FALSE(storage.Exists(first_key));
+    ASSERT_FALSE(storage.Del(first_key));
+    ASSERT_TRUE(storage.Get(second_key).value() == Dan);
+}
+
+TEST(open_addressing_suite, rehash_and_tombstones) {
+    storage::Controller storage(
+        storage::TypeHashTable::kOpenAddressingHashTable);
+    for (int i = 0; i < 1000; ++i)
+        ASSERT_TRUE(storage.Set("key" + std::to_string(i), Eve));
+    for (int i = 0; i < 1000; i += 2)
+        ASSERT_TRUE(storage.Del("key" + std::to_string(i)));
+    for (int i = 1000; i < 1500; ++i)
+        ASSERT_TRUE(storage.Set("key" + std::to_string(i), Dan));
+    for (int i = 0; i < 1500; ++i)
+        ASSERT_EQ(storage.Exists("key" + std::to_string(i)),
+                  i % 2 == 1 || i >= 1000);
+    ASSERT_EQ(storage.Keys().size(), 1000U);
+}
+
+TEST(open_addressing_suite, rename_update_find) {
+    storage::Controller storage(
+        storage::TypeHashTable::kOpenAddressingHashTable);
+    storage.Set(first_key, Eve);
+    storage.Set(second_key, Dan);
+    ASSERT_FALSE(storage.Rename(first_key, second_key));
+    ASSERT_TRUE(storage.Rename(first_key, third_key));
+    ASSERT_FALSE(storage.Exists(first_key));
+    ASSERT_TRUE(storage.Get(third_key).value() == Eve);
+    ASSERT_TRUE(storage.Update(third_key, Mary_opt));
+    ASSERT_TRUE(storage.Get(third_key).value() == Mary);
+    storage::optional_value_t value;
+    value.city = "Philadelphia";
+    ASSERT_EQ(storage.Find(value), std::vector<std::string>{third_key});
+}
+
+template <typename Node>
+int CheckRedBlack(const Node *node) {
+    if (node == nullptr) return 1;
+    if (node->color == stl::Color::RED) {
+        EXPECT_FALSE(node->left && node->left->color == stl::Color::RED);
+        EXPECT_FALSE(node->right && node->right->color == stl::Color::RED);
+    }
+    if (node->left) {
+        EXPECT_EQ(node->left->parent, node);
+    }
+    if (node->right) {
+        EXPECT_EQ(node->right->parent, node);
+    }
+    const int left = CheckRedBlack(node->left);
+    const int right = CheckRedBlack(node->right);
+    EXPECT_EQ(left, right);
+    return left + (node->color == stl::Color::BLACK ? 1 : 0);
+}
+
+TEST(balanced_tree_suite, sequential_insert_depth) {
+    const int count = 1000000;
+    stl::map<int, int> tree;
+    for (int i = 0; i < count; ++i) tree.insert(i, i);
+    ASSERT_EQ(tree.size(), static_cast<size_t>(count));
+    ASSERT_LE(tree.height(), 2 * std::log2(count + 1));
+    int expected = 0;
+    for (auto it = tree.begin(); it != tree.end(); ++it)
+        ASSERT_EQ((*it).first, expected++);
+    ASSERT_EQ(expected, count);
+}
+
+TEST(balanced_tree_suite, random_insert_erase_invariants) {
+    std::mt19937 generator(42);
+    std::uniform_int_distribution<int> distribution(0, 5000);
+    stl::map<int, int> tree;
+    std::set<int> reference;
+    for (int i = 0; i < 20000; ++i) {
+        const int key = distribution(generator);
+        if (i % 3 == 2) {
+            auto [it, found] = tree.search(key);
+            ASSERT_EQ(found, reference.erase(key) == 1);
+            if (found) tree.erase(it);
+        } else {
+            ASSERT_EQ(tree.insert(key, i).second,
+                      reference.insert(key).second);
+        }
+    }
+    ASSERT_EQ(tree.size(), reference.size());
+    CheckRedBlack(tree.getRoot());
+    ASSERT_EQ(tree.getRoot()->color, stl::Color::BLACK);
+    auto expected = reference.begin();
+    for (auto it = tree.begin(); it != tree.end(); ++it, ++expected)
+        ASSERT_EQ((*it).first, *expected);
+}
+
+TEST(balanced_tree_suite, sorted_upload_tree) {
+    storage::Controller storage(storage::TypeHashTable::kSelfBalancingTree);
+    for (int i = 0; i < 10000; ++i) {
+        std::ostringstream key;
+        key << "key" << std::setw(6) << std::setfill('0') << i;
+        ASSERT_TRUE(storage.Set(key.str(), Eve));
+    }
+    ASSERT_TRUE(storage.Exists("key005000"));
+    ASSERT_TRUE(storage.Del("key005000"));
+    ASSERT_FALSE(storage.Exists("key005000"));
+    ASSERT_EQ(storage.Keys().size(), 9999U);
+}
+
+TEST(HashTableTest, string_view_lookup) {
+    storage::HashTable table;
+    table.Set(first_key, Eve);
+    table.Set(second_key, Dan);
+    std::string_view probe = "lawyer and more";
+    ASSERT_TRUE(table.Contains(probe.substr(0, 6)));
+    ASSERT_FALSE(table.Contains(probe));
+    const storage::value_t *value = table.Lookup(probe.substr(0, 6));
+    ASSERT_NE(value, nullptr);
+    ASSERT_TRUE(*value == Dan);
+    ASSERT_EQ(table.Lookup("missing"), nullptr);
+}
+
+TEST(HashTableTest, rename_existing_key) {
+    storage::Controller storage;
+    storage.Set(first_key, Eve);
+    storage.Set(second_key, Dan);
+    ASSERT_FALSE(storage.Rename(first_key, second_key));
+    ASSERT_FALSE(storage.Rename(third_key, fourth_key));
+    ASSERT_TRUE(storage.Rename(first_key, third_key));
+    ASSERT_TRUE(storage.Get(third_key).value() == Eve);
+    ASSERT_TRUE(storage.Get(second_key).value() == Dan);
+    ASSERT_EQ(storage.Keys().size(), 2U);
+}
+
+TEST(zero_copy_suite, get_with_reader) {
+    for (auto type : {storage::TypeHashTable::kHashTable,
+                      storage::TypeHashTable::kSelfBalancingTree,
+                      storage::TypeHashTable::kOpenAddressingHashTable,
+                      storage::TypeHashTable::kBPlusTree}) {
+        storage::Controller storage(type);
+        storage.Set(first_key, Eve);
+        const std::string *surname = nullptr;
+        long coins = 0;
+        ASSERT_TRUE(storage.Get(first_key, [&](const storage::value_t &value) {
+            surname = &value.GetSurname();
+            coins = value.GetCountCoins();
+        }));
+        ASSERT_EQ(*surname, "Eve");
+        ASSERT_EQ(coins, 4100L);
+        ASSERT_FALSE(storage.Get(second_key, [&](const storage::value_t &) {
+            FAIL() << "reader called for a missing key";
+        }));
+    }
+}
+
+TEST(zero_copy_suite, update_tree) {
+    storage::Controller storage(storage::TypeHashTable::kSelfBalancingTree);
+    storage.Set(first_key, Eve);
+    ASSERT_TRUE(storage.Update(first_key, Mary_opt));
+    ASSERT_TRUE(storage.Get(first_key).value() == Mary);
+}
+
+TEST(HashTableTest, incremental_rehash_mixed_operations) {
+    storage::HashTable table;
+    std::set<std::string> expected;
+    for (int i = 0; i < 5000; ++i) {
+        const std::string key = "key" + std::to_string(i);
+        ASSERT_TRUE(table.Set(key, Dan));
+        expected.insert(key);
+        if (i % 7 == 0 && i > 0) {
+            const std::string victim = "key" + std::to_string(i / 2);
+            ASSERT_EQ(table.Del(victim), expected.erase(victim) == 1);
+        }
+        if (i % 11 == 0 && expected.count(key)) {
+            const std::string renamed = "renamed" + std::to_string(i);
+            ASSERT_TRUE(table.Rename(key, renamed));
+            expected.erase(key);
+            expected.insert(renamed);
+        }
+        for (const auto &present : {*expected.begin(), *expected.rbegin()})
+            ASSERT_TRUE(table.Contains(present));
+    }
+    ASSERT_EQ(table.Keys(),
+              std::vector<std::string>(expected.begin(), expected.end()));
+    for (const auto &key : expected) ASSERT_TRUE(table.Exists(key));
+    ASSERT_FALSE(table.Exists("key0"));
+}
+
+TEST(move_suite, set_rvalue_and_rename) {
+    static_assert(std::is_nothrow_move_constructible_v<storage::Data>);
+    static_assert(std::is_nothrow_move_assignable_v<storage::Data>);
+    for (auto type : {storage::TypeHashTable::kHashTable,
+                      storage::TypeHashTable::kSelfBalancingTree,
+                      storage::TypeHashTable::kOpenAddressingHashTable,
+                      storage::TypeHashTable::kBPlusTree}) {
+        storage::Controller storage(type);
+        storage::key_t key = first_key;
+        storage::value_t value = Mary;
+        ASSERT_TRUE(storage.Set(std::move(key), std::move(value)));
+        ASSERT_FALSE(storage.Set(storage::key_t(first_key), Eve));
+        for (int i = 0; i < 50; ++i)
+            ASSERT_TRUE(storage.Set("key" + std::to_string(i), Dan));
+        ASSERT_TRUE(storage.Rename(first_key, "renamed"));
+        ASSERT_FALSE(storage.Exists(first_key));
+        ASSERT_TRUE(storage.Get("renamed").value() == Mary);
+        ASSERT_TRUE(storage.Rename("key10", "key99"));
+        ASSERT_EQ(storage.Keys().size(), 51U);
+    }
+}
+
+TEST(concurrent_suite, parallel_writers_and_readers) {
+    storage::Controller storage(storage::TypeHashTable::kConcurrentHashTable);
+    const int threads = 4;
+    const int per_thread = 3000;
+    std::vector<std::thread> workers;
+    for (int t = 0; t < threads; ++t) {
+        workers.emplace_back([&storage, t] {
+            for (int i = 0; i < per_thread; ++i) {
+                const std::string key =
+                    std::to_string(t) + ":" + std::to_string(i);
+                storage.Set(key, Eve);
+                storage.Exists(std::to_string((t + 1) % threads) + ":" +
+                               std::to_string(i));
+                if (i % 3 == 0) storage.Rename(key, key + "r");
+                if (i % 5 == 0) storage.Update(key, Bob_opt);
+            }
+        });
+    }
+    for (auto &worker : workers) worker.join();
+    ASSERT_EQ(storage.Keys().size(), static_cast<size_t>(threads * per_thread));
+    ASSERT_TRUE(storage.Exists("0:3r"));
+    ASSERT_FALSE(storage.Exists("0:3"));
+    ASSERT_TRUE(storage.Get("2:3r").value() == Eve);
+    ASSERT_EQ(storage.Get("1:5").value().GetSurname(), "Bob");
+}
+
+TEST(expiry_suite, expired_records_are_hidden) {
+    for (auto type : {storage::TypeHashTable::kHashTable,
+                      storage::TypeHashTable::kSelfBalancingTree,
+                      storage::TypeHashTable::kOpenAddressingHashTable,
+                      storage::TypeHashTable::kConcurrentHashTable,
+                      storage::TypeHashTable::kBPlusTree}) {
+        storage::Controller storage(type);
+        const storage::value_t expired("Old", "Record", 1970, "Nowhere", 1L, 0);
+        ASSERT_TRUE(storage.Set(first_key, expired));
+        ASSERT_FALSE(storage.Exists(first_key));
+        ASSERT_FALSE(storage.Get(first_key).has_value());
+        ASSERT_EQ(storage.TTL(first_key), "null");
+        ASSERT_TRUE(storage.Set(first_key, Eve));
+        ASSERT_TRUE(storage.Get(first_key).value() == Eve);
+        // Records past their TTL but not yet swept act as absent.
+        ASSERT_TRUE(storage.Set(second_key, expired));
+        ASSERT_TRUE(storage.Set(third_key, expired));
+        storage::optional_value_t update;
+        update.surname = "New";
+        ASSERT_FALSE(storage.Update(second_key, update));
+        ASSERT_FALSE(storage.Rename(second_key, "renamed"));
+        ASSERT_FALSE(storage.Exists("renamed"));
+        ASSERT_TRUE(storage.Rename(first_key, third_key));
+        ASSERT_TRUE(storage.Get(third_key).value() == Eve);
+        ASSERT_FALSE(storage.Del(second_key));
+        ASSERT_EQ(storage.Keys(), std::vector<storage::key_t>({third_key}));
+        storage::optional_value_t query;
+        query.city = "Nowhere";
+        ASSERT_TRUE(storage.Find(query).empty());
+        storage.CreateIndex(storage::IndexField::kCity);
+        ASSERT_TRUE(storage.Set(second_key, expired));
+        ASSERT_TRUE(storage.Find(query).empty());
+    }
+}
+
+TEST(expiry_suite, superseded_expiries_are_skipped) {
+    storage::ExpiryIndex expiry;
+    storage::value_t value = Eve;
+    for (unsigned long ttl = 1; ttl <= 10000; ++ttl) {
+        value.SetTimeLife(ttl);
+        expiry.Add("key", value);
+    }
+    ASSERT_EQ(expiry.Size(), 1u);
+    const long now = storage::Data::Now();
+    ASSERT_FALSE(expiry.PopDue(now + 9999).has_value());
+    const auto due = expiry.PopDue(now + 10001);
+    ASSERT_TRUE(due.has_value());
+    ASSERT_EQ(due->second, "key");
+    ASSERT_TRUE(expiry.Empty());
+    value.SetTimeLife(5);
+    expiry.Add("other", value);
+    expiry.Remove("other");
+    ASSERT_FALSE(expiry.PopDue(now + 100).has_value());
+}
+
+TEST(expiry_suite, huge_ttl_saturates) {
+    storage::value_t value = Eve;
+    value.SetTimeLife(std::numeric_limits<unsigned long>::max());
+    ASSERT_FALSE(value.IsExpired());
+    ASSERT_TRUE(value.TTL().has_value());
+    ASSERT_GT(*value.TTL(), 0L);
+}
+
+TEST(string_pool_suite, threads_share_interned_strings) {
+    std::vector<std::vector<const std::string *>> interned(4);
+    std::vector<std::thread> threads;
+    for (auto &pointers : interned)
+        threads.emplace_back([&pointers] {
+            for (int i = 0; i < 1000; ++i)
+                pointers.push_back(storage::StringPool::Intern(
+                    "pooled" + std::to_string(i)));
+        });
+    for (auto &thread : threads) thread.join();
+    for (int i = 0; i < 1000; ++i) {
+        const std::string text = "pooled" + std::to_string(i);
+        ASSERT_EQ(*interned[0][static_cast<std::size_t>(i)], text);
+        ASSERT_EQ(storage::StringPool::Find(text),
+                  interned[0][static_cast<std::size_t>(i)]);
+        for (const auto &pointers : interned)
+            ASSERT_EQ(pointers[static_cast<std::size_t>(i)],
+                      interned[0][static_cast<std::size_t>(i)]);
+    }
+}
+
+TEST(expiry_suite, delete_old_data_keeps_live_records) {
+    for (auto type : {storage::TypeHashTable::kHashTable,
+                      storage::TypeHashTable::kSelfBalancingTree,
+                      storage::TypeHashTable::kOpenAddressingHashTable,
+                      storage::TypeHashTable::kConcurrentHashTable,
+                      storage::TypeHashTable::kBPlusTree}) {
+        storage::Controller storage(type);
+        const storage::value_t expired("Old", "Record", 1970, "Nowhere", 1L, 0);
+        const storage::value_t lasting("New", "Record", 2000, "Somewhere", 2L,
+                                       1000);
+        for (int i = 0; i < 100; ++i) {
+            const std::string key = std::to_string(i);
+            storage.Set(key, i % 3 == 0 ? expired : i % 3 == 1 ? lasting : Eve);
+        }
+        storage.Rename("0", "renamed");
+        storage.Update("1", storage::optional_value_t(
+                                std::nullopt, std::nullopt, std::nullopt,
+                                std::nullopt, std::nullopt, 0));
+        storage.DeleteOldData();
+        const auto keys = storage.Keys();
+        ASSERT_EQ(keys.size(), 100u - 34u - 1u);
+        ASSERT_FALSE(std::binary_search(keys.begin(), keys.end(), "renamed"));
+        ASSERT_FALSE(std::binary_search(keys.begin(), keys.end(), "1"));
+        ASSERT_TRUE(std::binary_search(keys.begin(), keys.end(), "4"));
+        ASSERT_TRUE(std::binary_search(keys.begin(), keys.end(), "5"));
+    }
+}
+
+TEST(index_suite, indexed_find_matches_scan) {
+    for (auto type : {storage::TypeHashTable::kHashTable,
+                      storage::TypeHashTable::kSelfBalancingTree,
+                      storage::TypeHashTable::kOpenAddressingHashTable,
+                      storage::TypeHashTable::kConcurrentHashTable,
+                      storage::TypeHashTable::kBPlusTree}) {
+        storage::Controller indexed(type);
+        storage::Controller plain(type);
+        ASSERT_TRUE(indexed.CreateIndex(storage::IndexField::kCity));
+        ASSERT_FALSE(indexed.CreateIndex(storage::IndexField::kCity));
+        const std::string cities[] = {"Boston", "Denver", "Austin"};
+        for (int i = 0; i < 300; ++i) {
+            const storage::value_t value("S" + std::to_string(i % 7), "N",
+                                         1980 + i % 5, cities[i % 3], i % 11);
+            indexed.Set(std::to_string(i), value);
+            plain.Set(std::to_string(i), value);
+        }
+        ASSERT_TRUE(indexed.CreateIndex(storage::IndexField::kBirthYear));
+        ASSERT_TRUE(indexed.CreateIndex(storage::IndexField::kSurname));
+        for (auto *storage : {&indexed, &plain}) {
+            for (int i = 0; i < 300; i += 4) storage->Del(std::to_string(i));
+            for (int i = 1; i < 300; i += 6)
+                storage->Rename(std::to_string(i), "r" + std::to_string(i));
+            for (int i = 2; i < 300; i += 10)
+                storage->Update(std::to_string(i),
+                                storage::optional_value_t(
+                                    std::nullopt, std::nullopt, 1999,
+                                    "Denver", std::nullopt, std::nullopt));
+        }
+        std::vector<storage::optional_value_t> queries = {
+            {std::nullopt, std::nullopt, std::nullopt, "Denver", std::nullopt,
+             std::nullopt},
+            {std::nullopt, std::nullopt, 1999, std::nullopt, std::nullopt,
+             std::nullopt},
+            {"S3", std::nullopt, 1982, "Austin", std::nullopt, std::nullopt},
+            {std::nullopt, std::nullopt, std::nullopt, "Boston", 5L,
+             std::nullopt}};
+        for (const auto &query : queries)
+            ASSERT_EQ(indexed.Find(query), plain.Find(query));
+    }
+}
+
+TEST(upload_suite, round_trip_and_parsing) {
+    {
+        std::ofstream file("upload.dat");
+        file << "k1 \"Doe\" \"John\" 1995 \"New York\" 6789 500\n"
+             << "k2 Smith Alice 1990 Chicago 1500\r\n"
+             << "broken \"Unterminated 1990 Chicago 1500\n"
+             << "\n"
+             << "k3 \"\" \"Eve\" 1993 \"Boston\" -20";
+    }
+    for (auto type : {storage::TypeHashTable::kHashTable,
+                      storage::TypeHashTable::kSelfBalancingTree,
+                      storage::TypeHashTable::kOpenAddressingHashTable,
+                      storage::TypeHashTable::kConcurrentHashTable,
+                      storage::TypeHashTable::kBPlusTree}) {
+        storage::Controller storage(type);
+        ASSERT_EQ(storage.Upload("upload.dat"), 3u);
+        ASSERT_TRUE(storage.Get("k1").value() ==
+                    storage::value_t("Doe", "John", 1995, "New York", 6789L));
+        ASSERT_TRUE(storage.Get("k2").value() ==
+                    storage::value_t("Smith", "Alice", 1990, "Chicago", 1500L));
+        ASSERT_TRUE(storage.Get("k3").value() ==
+                    storage::value_t("", "Eve", 1993, "Boston", -20L));
+        const long ttl = std::stol(storage.TTL("k1"));
+        ASSERT_TRUE(ttl > 490 && ttl <= 500);
+        ASSERT_EQ(storage.TTL("k2"), "null");
+        ASSERT_FALSE(storage.Exists("broken"));
+
+        ASSERT_EQ(storage.Export("round_trip.dat"), 3u);
+        storage::Controller copy(type);
+        ASSERT_EQ(copy.Upload("round_trip.dat"), 3u);
+        ASSERT_EQ(copy.Keys(), storage.Keys());
+        ASSERT_TRUE(copy.Get("k1").value() == storage.Get("k1").value());
+        ASSERT_TRUE(std::stol(copy.TTL("k1")) <= ttl);
+    }
+    std::remove("upload.dat");
+    std::remove("round_trip.dat");
+}
+
+TEST(upload_suite, reserve_keeps_records) {
+    storage::HashTable table;
+    for (int i = 0; i < 100; ++i) table.Set(std::to_string(i), Eve);
+    table.Reserve(100000);
+    // The records move over in later writes; a scan finds them meanwhile.
+    std::vector<storage::key_t> scanned;
+    std::string cursor;
+    do {
+        cursor = table.ScanKeys(cursor, 10, scanned);
+    } while (!cursor.empty());
+    ASSERT_EQ(std::set<storage::key_t>(scanned.begin(), scanned.end()).size(),
+              100u);
+    for (int i = 100; i < 200; ++i) table.Set(std::to_string(i), Dan);
+    for (int i = 0; i < 200; ++i)
+        ASSERT_TRUE(table.Get(std::to_string(i)).value() ==
+                    (i < 100 ? Eve : Dan));
+    ASSERT_EQ(table.Keys().size(), 200u);
+}
+
+TEST(balanced_tree_suite, assign_sorted_invariants) {
+    for (int count : {0, 1, 2, 3, 7, 8, 100, 1023, 1024, 5000}) {
+        std::vector<std::pair<int, int>> items;
+        for (int i = 0; i < count; ++i) items.emplace_back(i * 2, i);
+        stl::map<int, int> tree;
+        tree.insert(1, 1);
+        tree.assignSorted(std::move(items));
+        ASSERT_EQ(tree.size(), static_cast<size_t>(count));
+        CheckRedBlack(tree.getRoot());
+        if (count > 0) {
+            ASSERT_EQ(tree.getRoot()->color, stl::Color::BLACK);
+        }
+        int expected = 0;
+        for (auto it = tree.begin(); it != tree.end(); ++it, expected += 2)
+            ASSERT_EQ((*it).first, expected);
+        tree.insert(count * 2 + 1, 0);
+        tree.erase(tree.find(0));
+        CheckRedBlack(tree.getRoot());
+    }
+}
+
+TEST(upload_suite, parallel_upload_matches_sequential) {
+    {
+        std::ofstream file("parallel.dat");
+        for (int i = 0; i < 20000; ++i)
+            file << "key" << i % 15000 << " \"Surname" << i << "\" \"Name\" "
+                 << 1950 + i % 50 << " \"City " << i % 9 << "\" " << i
+                 << (i % 4 == 0 ? " 1000" : "") << "\n";
+    }
+    for (auto type : {storage::TypeHashTable::kHashTable,
+                      storage::TypeHashTable::kSelfBalancingTree,
+                      storage::TypeHashTable::kOpenAddressingHashTable,
+                      storage::TypeHashTable::kConcurrentHashTable,
+                      storage::TypeHashTable::kBPlusTree}) {
+        storage::Controller sequential(type);
+        storage::Controller parallel(type);
+        ASSERT_EQ(sequential.Upload("parallel.dat"), 15000u);
+        const storage::UploadStats stats =
+            parallel.UploadParallel("parallel.dat", 4);
+        ASSERT_EQ(stats.records, 15000u);
+        ASSERT_GE(stats.RecordsPerSecond(), 0);
+        const auto keys = sequential.Keys();
+        ASSERT_EQ(parallel.Keys(), keys);
+        for (const auto &key : keys)
+            ASSERT_TRUE(parallel.Get(key).value() ==
+                        sequential.Get(key).value());
+        ASSERT_NE(parallel.TTL("key0"), "null");
+        ASSERT_EQ(parallel.UploadParallel("parallel.dat", 3).records, 0u);
+    }
+    ASSERT_EQ(storage::Controller().UploadParallel("missing.dat").records, 0u);
+    std::ofstream("parallel.dat").close();
+    ASSERT_EQ(storage::Controller().UploadParallel("parallel.dat").records, 0u);
+    std::remove("parallel.dat");
+}
+
+TEST(snapshot_suite, save_and_load_round_trip) {
+    for (auto type : {storage::TypeHashTable::kHashTable,
+                      storage::TypeHashTable::kSelfBalancingTree,
+                      storage::TypeHashTable::kOpenAddressingHashTable,
+                      storage::TypeHashTable::kConcurrentHashTable,
+                      storage::TypeHashTable::kBPlusTree}) {
+        storage::Controller storage(type);
+        for (int i = 0; i < 30000; ++i) {
+            std::optional<unsigned long> ttl;
+            if (i % 3 == 0) ttl = 1000;
+            if (i % 7 == 0) ttl = 0;
+            storage.Set("key" + std::to_string(i),
+                        storage::value_t("Surname " + std::to_string(i), "",
+                                         1900 + i % 100, "City", -i, ttl));
+        }
+        const unsigned int expected = 30000 - (30000 + 6) / 7;
+        ASSERT_EQ(storage.SaveSnapshot("snapshot.bin"), expected);
+        storage::Controller copy(type);
+        ASSERT_EQ(copy.LoadSnapshot("snapshot.bin"), expected);
+        std::vector<std::string> live;
+        for (const auto &key : storage.Keys())
+            if (storage.Exists(key)) live.push_back(key);
+        ASSERT_EQ(copy.Keys(), live);
+        for (int i = 1; i < 30000; i += 97) {
+            const std::string key = "key" + std::to_string(i);
+            ASSERT_EQ(copy.Exists(key), i % 7 != 0);
+            if (i % 7 == 0) continue;
+            ASSERT_TRUE(copy.Get(key).value() == storage.Get(key).value());
+            ASSERT_EQ(copy.Get(key)->GetTimeLife(),
+                      storage.Get(key)->GetTimeLife());
+        }
+    }
+    std::remove("snapshot.bin");
+}
+
+TEST(snapshot_suite, crc32_check_value) {
+    const std::string text = "123456789";
+    ASSERT_EQ(storage::Crc32(text.data(), text.size()), 0xCBF43926u);
+    const std::string longer(1000, 'x');
+    ASSERT_EQ(storage::Crc32(longer.data() + 3, 997,
+                             storage::Crc32(longer.data(), 3)),
+              storage::Crc32(longer.data(), longer.size()));
+}
+
+TEST(snapshot_suite, corrupt_snapshot_is_rejected) {
+    storage::Controller storage;
+    storage.Set(first_key, Eve);
+    storage.Set(second_key, Dan);
+    ASSERT_EQ(storage.SaveSnapshot("snapshot.bin"), 2u);
+    {
+        std::fstream file("snapshot.bin",
+                          std::ios::in | std::ios::out | std::ios::binary);
+        file.seekp(30);
+        file.put('#');
+    }
+    storage::Controller copy;
+    ASSERT_EQ(copy.LoadSnapshot("snapshot.bin"), 0u);
+    ASSERT_TRUE(copy.Keys().empty());
+    std::ofstream("snapshot.bin") << "not a snapshot";
+    ASSERT_EQ(copy.LoadSnapshot("snapshot.bin"), 0u);
+    ASSERT_EQ(copy.LoadSnapshot("missing.bin"), 0u);
+    std::remove("snapshot.bin");
+}
+
+TEST(wal_suite, replay_restores_writes) {
+    for (auto type : {storage::TypeHashTable::kHashTable,
+                      storage::TypeHashTable::kSelfBalancingTree,
+                      storage::TypeHashTable::kOpenAddressingHashTable,
+                      storage::TypeHashTable::kConcurrentHashTable,
+                      storage::TypeHashTable::kBPlusTree}) {
+        std::remove("wal.log");
+        std::remove("wal.snap");
+        {
+            storage::Controller storage(type);
+            ASSERT_EQ(storage.EnableLog("wal.log", "wal.snap"), 0u);
+            storage.Set(first_key, Eve);
+            storage.Set(second_key, Dan);
+            storage.Set("third", storage::value_t("A", "B", 2000, "C", 1, 100));
+            storage::optional_value_t update;
+            update.city = "Paris";
+            update.expiry_time = 500;
+            ASSERT_TRUE(storage.Update(first_key, update));
+            ASSERT_TRUE(storage.Rename(second_key, "renamed"));
+            ASSERT_TRUE(storage.Del("third"));
+            ASSERT_FALSE(storage.Del("third"));
+        }
+        storage::Controller storage(type);
+        ASSERT_EQ(storage.EnableLog("wal.log", "wal.snap"), 6u);
+        ASSERT_EQ(storage.Keys(), std::vector<std::string>({first_key,
+                                                            "renamed"}));
+        ASSERT_EQ(storage.Get(first_key)->GetCity(), "Paris");
+        ASSERT_NE(storage.TTL(first_key), "(null)");
+        ASSERT_TRUE(storage.Get("renamed").value() == Dan);
+
+        ASSERT_EQ(storage.Checkpoint(), 2u);
+        storage.Set("after", Eve);
+        ASSERT_TRUE(storage.Del(first_key));
+        storage::Controller reopened(type);
+        ASSERT_EQ(reopened.EnableLog("wal.log", "wal.snap"), 2u);
+        ASSERT_EQ(reopened.Keys(),
+                  std::vector<std::string>({"after", "renamed"}));
+    }
+    std::remove("wal.log");
+    std::remove("wal.snap");
+}
+
+TEST(wal_suite, torn_tail_is_dropped) {
+    std::remove("wal.log");
+    std::remove("wal.snap");
+    {
+        storage::Controller storage;
+        storage::WalOptions options;
+        options.sync = storage::SyncPolicy::kInterval;
+        options.interval = std::chrono::milliseconds(10);
+        storage.EnableLog("wal.log", "wal.snap", options);
+        for (int i = 0; i < 1000; ++i)
+            storage.Set("key" + std::to_string(i), Eve);
+        storage.SyncLog();
+    }
+    std::ofstream("wal.log", std::ios::app | std::ios::binary)
+        << std::string("\x20\0\0\0garbage", 11);
+    {
+        storage::Controller storage;
+        storage::WalOptions options;
+        options.sync = storage::SyncPolicy::kNone;
+        ASSERT_EQ(storage.EnableLog("wal.log", "wal.snap", options), 1000u);
+        storage.Set("last", Dan);
+        storage.SyncLog();
+    }
+    storage::Controller storage;
+    ASSERT_EQ(storage.EnableLog("wal.log", "wal.snap"), 1001u);
+    ASSERT_TRUE(storage.Get("last").value() == Dan);
+    ASSERT_TRUE(storage.Exists("key999"));
+    std::remove("wal.log");
+    std::remove("wal.snap");
+}
+
+TEST(wal_suite, async_checkpoint_truncates_log) {
+    for (auto type : {storage::TypeHashTable::kHashTable,
+                      storage::TypeHashTable::kConcurrentHashTable,
+                      storage::TypeHashTable::kBPlusTree}) {
+        std::remove("wal.log");
+        std::remove("wal.snap");
+        {
+            storage::Controller storage(type);
+            storage.EnableLog("wal.log", "wal.snap");
+            for (int i = 0; i < 100; ++i)
+                storage.Set("key" + std::to_string(i), Eve);
+            auto saved = storage.CheckpointAsync();
+            storage.Set("after", Dan);
+            ASSERT_EQ(saved.get(), 100u);
+            ASSERT_FALSE(std::ifstream("wal.log.old").is_open());
+        }
+        storage::Controller reopened(type);
+        ASSERT_EQ(reopened.EnableLog("wal.log", "wal.snap"), 1u);
+        ASSERT_EQ(reopened.Keys().size(), 101u);
+    }
+    ASSERT_THROW(storage::Controller().CheckpointAsync(),
+                 std::invalid_argument);
+    // A snapshot that cannot be written leaves the old log behind, and a
+    // restart replays it before the current one.
+    std::remove("wal.log");
+    {
+        storage::Controller storage;
+        storage.EnableLog("wal.log", "missing/wal.snap");
+        storage.Set(first_key, Eve);
+        ASSERT_THROW(storage.CheckpointAsync(), std::invalid_argument);
+        storage.Set(second_key, Dan);
+    }
+    storage::Controller reopened;
+    ASSERT_EQ(reopened.EnableLog("wal.log", "missing/wal.snap"), 2u);
+    ASSERT_TRUE(reopened.Exists(first_key) && reopened.Exists(second_key));
+    std::remove("wal.log");
+    std::remove("wal.log.old");
+    std::remove("wal.snap");
+}
+
+TEST(snapshot_suite, async_snapshot_is_point_in_time) {
+    for (auto type : {storage::TypeHashTable::kHashTable,
+                      storage::TypeHashTable::kSelfBalancingTree,
+                      storage::TypeHashTable::kOpenAddressingHashTable,
+                      storage::TypeHashTable::kConcurrentHashTable,
+                      storage::TypeHashTable::kBPlusTree}) {
+        storage::Controller storage(type);
+        for (int i = 0; i < 20000; ++i)
+            storage.Set("key" + std::to_string(i), Eve);
+        auto saved = storage.SaveSnapshotAsync("snapshot.bin");
+        storage::optional_value_t update;
+        update.city = "Paris";
+        for (int i = 0; i < 20000; i += 4) {
+            const std::string key = "key" + std::to_string(i);
+            storage.Del(key);
+            storage.Set(key + "new", Dan);
+            storage.Update("key" + std::to_string(i + 1), update);
+            storage.Rename("key" + std::to_string(i + 2), key + "moved");
+        }
+        ASSERT_EQ(saved.get(), 20000u);
+        storage::Controller copy(type);
+        ASSERT_EQ(copy.LoadSnapshot("snapshot.bin"), 20000u);
+        for (int i = 0; i < 20000; ++i) {
+            const std::string key = "key" + std::to_string(i);
+            ASSERT_TRUE(copy.Get(key).value() == Eve);
+        }
+        ASSERT_FALSE(copy.Exists("key0new"));
+        ASSERT_EQ(storage.Get("key1")->GetCity(), "Paris");
+        ASSERT_TRUE(storage.Exists("key0moved"));
+    }
+    std::remove("snapshot.bin");
+}
+
+TEST(balanced_tree_suite, pluggable_node_allocator) {
+    stl::map<std::string, int> tree;
+    for (int i = 0; i < 10000; ++i) tree.insert(std::to_string(i), i);
+    for (int i = 0; i < 10000; i += 2)
+        tree.erase(tree.search(std::to_string(i)).first);
+    for (int i = 0; i < 10000; i += 4) tree.insert(std::to_string(i), -i);
+    ASSERT_EQ(tree.size(), 7500u);
+    CheckRedBlack(tree.getRoot());
+    stl::map<std::string, int> moved(std::move(tree));
+    ASSERT_TRUE(tree.empty());
+    ASSERT_EQ(moved.at("4"), -4);
+    ASSERT_EQ(moved.at("5"), 5);
+    ASSERT_FALSE(moved.search("6").second);
+    stl::map<std::string, int> other{{"x", 1}};
+    other.swap(moved);
+    ASSERT_EQ(other.size(), 7500u);
+    ASSERT_EQ(moved.at("x"), 1);
+    other.clear();
+    other.insert("y", 2);
+    ASSERT_EQ(other.size(), 1u);
+
+    stl::map<int, int, std::allocator<stl::treeNode<int, int>>> plain;
+    for (int i = 0; i < 1000; ++i) plain.insert(i, i * i);
+    for (int i = 0; i < 1000; i += 3) plain.erase(plain.search(i).first);
+    ASSERT_EQ(plain.size(), 666u);
+    ASSERT_EQ(plain.at(10), 100);
+    CheckRedBlack(plain.getRoot());
+}
+
+TEST(bplus_tree_suite, random_operations_match_std_map) {
+    std::mt19937 generator(7);
+    stl::bplus_map<int, int, 4, 4> tree;
+    std::map<int, int> reference;
+    for (int i = 0; i < 100000; ++i) {
+        const int key = static_cast<int>(generator() % 3000);
+        if (generator() % 3 == 0)
+            ASSERT_EQ(tree.erase(key), reference.erase(key) == 1);
+        else
+            ASSERT_EQ(tree.insert(key, i).second,
+                      reference.emplace(key, i).second);
+    }
+    ASSERT_EQ(tree.size(), reference.size());
+    auto it = tree.begin();
+    for (const auto &[key, value] : reference) {
+        ASSERT_TRUE(it != tree.end());
+        ASSERT_EQ(it.key(), key);
+        ASSERT_EQ(it.value(), value);
+        ++it;
+    }
+    ASSERT_TRUE(it == tree.end());
+    ASSERT_EQ(tree.lower_bound(1500).key(), reference.lower_bound(1500)->first);
+    for (const auto &entry : reference) ASSERT_TRUE(tree.erase(entry.first));
+    ASSERT_TRUE(tree.begin() == tree.end());
+    ASSERT_EQ(tree.height(), 1u);
+}
+
+TEST(bplus_tree_suite, assign_sorted_then_modify) {
+    std::vector<std::pair<int, int>> items;
+    for (int i = 0; i < 100000; ++i) items.emplace_back(2 * i, i);
+    stl::bplus_map<int, int> tree;
+    tree.assignSorted(std::move(items));
+    ASSERT_EQ(tree.size(), 100000u);
+    ASSERT_LE(tree.height(), 4u);
+    ASSERT_EQ(tree.find(1000).value(), 500);
+    ASSERT_TRUE(tree.find(1001) == tree.end());
+    ASSERT_EQ(tree.lower_bound(1001).key(), 1002);
+    for (int i = 0; i < 100000; i += 2) ASSERT_TRUE(tree.erase(2 * i));
+    for (int i = 0; i < 100000; i += 3) tree.insert(2 * i + 1, -i);
+    int previous = -1;
+    std::size_t count = 0;
+    for (auto it = tree.begin(); it != tree.end(); ++it, ++count) {
+        ASSERT_GT(it.key(), previous);
+        previous = it.key();
+    }
+    ASSERT_EQ(count, tree.size());
+    ASSERT_EQ(count, 50000u + 33334u);
+}
+
+TEST(scan_suite, ordered_range_and_prefix) {
+    storage::value_t expired = Dan;
+    expired.SetExpiryTime(storage::Data::Now() - 1);
+    for (auto type : {storage::TypeHashTable::kHashTable,
+                      storage::TypeHashTable::kSelfBalancingTree,
+                      storage::TypeHashTable::kOpenAddressingHashTable,
+                      storage::TypeHashTable::kConcurrentHashTable,
+                      storage::TypeHashTable::kBPlusTree}) {
+        storage::Controller storage(type);
+        for (int i = 99; i >= 0; --i) {
+            char key[16];
+            std::snprintf(key, sizeof(key), "user:%03d", i);
+            storage.Set(key, Eve);
+        }
+        storage.Set("video:001", Eve);
+        storage.Set("user:050x", expired);
+        std::vector<std::string> keys;
+        const storage::visitor_t collect =
+            [&keys](const storage::key_t &key, const storage::value_t &value) {
+                ASSERT_TRUE(value == Eve);
+                keys.push_back(key);
+            };
+        ASSERT_EQ(storage.Scan("user:010", "user:020", 0, collect), 10u);
+        ASSERT_EQ(keys.front(), "user:010");
+        ASSERT_EQ(keys.back(), "user:019");
+        ASSERT_TRUE(std::is_sorted(keys.begin(), keys.end()));
+        keys.clear();
+        ASSERT_EQ(storage.Scan("user:049", "user:052", 0, collect), 3u);
+        ASSERT_EQ(keys, (std::vector<std::string>{"user:049", "user:050",
+                                                  "user:051"}));
+        keys.clear();
+        ASSERT_EQ(storage.Scan("user:0955", "", 3, collect), 3u);
+        ASSERT_EQ(keys, (std::vector<std::string>{"user:096", "user:097",
+                                                  "user:098"}));
+        keys.clear();
+        ASSERT_EQ(storage.ScanPrefix("user:", 0, collect), 100u);
+        keys.clear();
+        ASSERT_EQ(storage.ScanPrefix("video", 0, collect), 1u);
+        ASSERT_EQ(storage.ScanPrefix("zzz", 0, collect), 0u);
+        ASSERT_EQ(storage.Scan("user:020", "user:010", 0, collect), 0u);
+        keys.clear();
+        std::string from = "user:";
+        while (storage.Scan(from, "user;", 7, collect) > 0)
+            from = keys.back() + '\0';
+        ASSERT_EQ(keys.size(), 100u);
+        ASSERT_TRUE(std::is_sorted(keys.begin(), keys.end()));
+    }
+}
+
+TEST(scan_suite, cursor_survives_growth) {
+    for (auto type : {storage::TypeHashTable::kHashTable,
+                      storage::TypeHashTable::kSelfBalancingTree,
+                      storage::TypeHashTable::kOpenAddressingHashTable,
+                      storage::TypeHashTable::kConcurrentHashTable,
+                      storage::TypeHashTable::kBPlusTree}) {
+        storage::Controller storage(type);
+        for (int i = 0; i < 3000; ++i)
+            storage.Set("key" + std::to_string(i), Eve);
+        std::vector<storage::key_t> keys;
+        std::string cursor;
+        int added = 0;
+        int calls = 0;
+        do {
+            const std::size_t before = keys.size();
+            cursor = storage.ScanKeys(cursor, 50, keys);
+            ASSERT_TRUE(keys.size() > before || cursor.empty());
+            // Grows the storage through several rehashes mid-scan, during
+            // the first calls only, so that the scan can catch up.
+            if (++calls > 20) continue;
+            for (int i = 0; i < 400; ++i, ++added)
+                storage.Set("new" + std::to_string(added), Dan);
+        } while (!cursor.empty());
+        std::set<storage::key_t> seen(keys.begin(), keys.end());
+        for (int i = 0; i < 3000; ++i)
+            ASSERT_EQ(seen.count("key" + std::to_string(i)), 1u);
+        for (const auto &key : keys)
+            ASSERT_TRUE(storage.Exists(key));
+        // The tree engines resume at any key, so only the hash engines
+        // reject a cursor they did not hand out.
+        if (type == storage::TypeHashTable::kSelfBalancingTree ||
+            type == storage::TypeHashTable::kBPlusTree) {
+            ASSERT_NO_THROW(storage.ScanKeys("not a cursor", 10, keys));
+        } else {
+            ASSERT_THROW(storage.ScanKeys("not a cursor", 10, keys),
+                         std::invalid_argument);
+        }
+    }
+}
+
+TEST(batch_suite, multi_get_set_del) {
+    for (auto type : {storage::TypeHashTable::kHashTable,
+                      storage::TypeHashTable::kSelfBalancingTree,
+                      storage::TypeHashTable::kOpenAddressingHashTable,
+                      storage::TypeHashTable::kConcurrentHashTable,
+                      storage::TypeHashTable::kBPlusTree}) {
+        storage::Controller storage(type);
+        storage.Set(first_key, Eve);
+        std::vector<storage::record_t> records;
+        std::vector<storage::key_t> keys;
+        for (int i = 0; i < 2000; ++i) {
+            keys.push_back("key" + std::to_string(i));
+            records.emplace_back(keys.back(), Dan);
+        }
+        // Neither may replace a live record, as with Set.
+        records.emplace_back(first_key, Dan);
+        records.emplace_back("key5", Eve);
+        ASSERT_EQ(storage.MultiSet(std::move(records)), 2000u);
+        keys.push_back(first_key);
+        keys.push_back("missing");
+        const auto values = storage.MultiGet(keys);
+        ASSERT_EQ(values.size(), keys.size());
+        for (std::size_t i = 0; i < 2000; ++i)
+            ASSERT_TRUE(values[i].value() == Dan);
+        ASSERT_TRUE(values[2000].value() == Eve);
+        ASSERT_FALSE(values[2001].has_value());
+        ASSERT_EQ(storage.MultiDel({"key0", "key1", "missing", "key0"}), 2u);
+        ASSERT_FALSE(storage.Exists("key0"));
+        ASSERT_TRUE(storage.Exists("key2"));
+        ASSERT_EQ(storage.Keys().size(), 1999u);
+    }
+}
+
+TEST(batch_suite, logged_batch_replays) {
+    std::remove("wal.log");
+    std::remove("wal.snap");
+    {
+        storage::Controller storage;
+        storage.EnableLog("wal.log", "wal.snap");
+        std::vector<storage::record_t> records;
+        for (int i = 0; i < 100; ++i)
+            records.emplace_back("key" + std::to_string(i), Eve);
+        ASSERT_EQ(storage.MultiSet(std::move(records)), 100u);
+        ASSERT_EQ(storage.MultiDel({"key1", "key2", "nope"}), 2u);
+    }
+    storage::Controller storage;
+    ASSERT_EQ(storage.EnableLog("wal.log", "wal.snap"), 102u);
+    ASSERT_EQ(storage.Keys().size(), 98u);
+    ASSERT_FALSE(storage.Exists("key1"));
+    ASSERT_TRUE(storage.Get("key99").value() == Eve);
+    std::remove("wal.log");
+    std::remove("wal.snap");
+}
+
+TEST(data_suite, compact_record_layout) {
+    // Pointers to two interned fields, the name, coins, expiry and year.
+    static_assert(sizeof(storage::Data) <= sizeof(std::string) + 40,
+                  "records should stay compact");
+    storage::value_t first("Brown", "Ann", 1990, "Boston", 10L);
+    storage::value_t second(std::string("Bro") + "wn", "Bob", 1991,
+                            "Boston", 20L);
+    ASSERT_EQ(&first.GetSurname(), &second.GetSurname());
+    ASSERT_EQ(&first.GetCity(), &second.GetCity());
+    second.SetCity("Denver");
+    ASSERT_EQ(second.GetCity(), "Denver");
+    ASSERT_EQ(first.GetCity(), "Boston");
+    ASSERT_FALSE(first.GetTimeLife().has_value());
+    ASSERT_FALSE(first.IsExpired());
+    first.SetTimeLife(100);
+    ASSERT_GE(*first.TTL(), 99);
+    ASSERT_LE(*first.TTL(), 100);
+    first.SetExpiryTime(std::nullopt);
+    ASSERT_FALSE(first.TTL().has_value());
+    first.Clear();
+    ASSERT_TRUE(first == storage::value_t());
+    ASSERT_EQ(first.GetSurname(), "");
+}
+
+TEST(index_suite, column_store_find_matches_scan) {
+    for (auto type : {storage::TypeHashTable::kHashTable,
+                      storage::TypeHashTable::kSelfBalancingTree,
+                      storage::TypeHashTable::kOpenAddressingHashTable,
+                      storage::TypeHashTable::kConcurrentHashTable,
+                      storage::TypeHashTable::kBPlusTree}) {
+        storage::Controller columnar(type);
+        storage::Controller plain(type);
+        const std::string cities[] = {"Boston", "Denver", "Austin"};
+        for (int i = 0; i < 1000; ++i) {
+            const storage::value_t value(
+                "S" + std::to_string(i % 7), "N" + std::to_string(i % 13),
+                1980 + i % 5, cities[i % 3], (i % 11) * 10000000000L);
+            columnar.Set(std::to_string(i), value);
+            plain.Set(std::to_string(i), value);
+        }
+        ASSERT_TRUE(columnar.CreateIndex(storage::IndexField::kColumns));
+        ASSERT_FALSE(columnar.CreateIndex(storage::IndexField::kColumns));
+        for (auto *storage : {&columnar, &plain}) {
+            for (int i = 0; i < 1000; i += 4) storage->Del(std::to_string(i));
+            for (int i = 1; i < 1000; i += 6)
+                storage->Rename(std::to_string(i), "r" + std::to_string(i));
+            for (int i = 2; i < 1000; i += 10)
+                storage->Update(std::to_string(i),
+                                storage::optional_value_t(
+                                    std::nullopt, "Zed", 1999, "Denver",
+                                    std::nullopt, std::nullopt));
+        }
+        std::vector<storage::optional_value_t> queries = {
+            {std::nullopt, std::nullopt, std::nullopt, "Denver", std::nullopt,
+             std::nullopt},
+            {std::nullopt, "Zed", 1999, std::nullopt, std::nullopt,
+             std::nullopt},
+            {"S3", "N4", 1982, "Austin", std::nullopt, std::nullopt},
+            {std::nullopt, std::nullopt, std::nullopt, "Nowhere",
+             50000000000L, std::nullopt},
+            {"Nobody", std::nullopt, std::nullopt, std::nullopt, std::nullopt,
+             std::nullopt}};
+        for (const auto &query : queries)
+            ASSERT_EQ(columnar.Find(query), plain.Find(query));
+        ASSERT_TRUE(columnar.Find(queries.back()).empty());
+    }
+}
+
+TEST(index_suite, column_store_reclaims_codes) {
+    storage::ColumnStore columns;
+    for (int i = 0; i < 1000; ++i)
+        columns.Add("key" + std::to_string(i % 10),
+                    storage::value_t("S" + std::to_string(i), "N", 1990,
+                                     "Boston", 1L));
+    ASSERT_EQ(columns.Size(), 10u);
+    ASSERT_EQ(columns.Codes(), 10u + 1u + 1u);
+    storage::optional_value_t query;
+    query.surname = "S995";
+    ASSERT_EQ(columns.Find(query), std::vector<storage::key_t>{"key5"});
+    query.surname = "S5";
+    ASSERT_TRUE(columns.Find(query).empty());
+    for (int i = 0; i < 10; i += 2) columns.Remove("key" + std::to_string(i));
+    ASSERT_EQ(columns.Size(), 5u);
+    ASSERT_EQ(columns.Codes(), 5u + 1u + 1u);
+    query = storage::optional_value_t();
+    query.city = "Boston";
+    ASSERT_EQ(columns.Find(query),
+              (std::vector<storage::key_t>{"key1", "key3", "key5", "key7",
+                                           "key9"}));
+    for (int i = 1; i < 10; i += 2) columns.Remove("key" + std::to_string(i));
+    ASSERT_EQ(columns.Codes(), 0u);
+    ASSERT_TRUE(columns.Find(query).empty());
+}
+
+TEST(aggregate_suite, sum_does_not_overflow) {
+    storage::Aggregate high;
+    storage::Aggregate low;
+    for (int i = 0; i < 4; ++i) {
+        high.Add(LONG_MAX);
+        low.Add(LONG_MIN);
+    }
+    ASSERT_TRUE(high.sum == storage::Aggregate::sum_t{LONG_MAX} * 4);
+    ASSERT_DOUBLE_EQ(high.Average(), static_cast<double>(LONG_MAX));
+    high.Merge(low);
+    ASSERT_EQ(high.count, 8u);
+    ASSERT_TRUE(high.sum == -4);
+    ASSERT_DOUBLE_EQ(high.Average(), -0.5);
+}
+
+TEST(aggregate_suite, group_by_matches_manual_totals) {
+    storage::value_t expired("Gone", "Away", 1900, "Boston", 1000000L);
+    expired.SetExpiryTime(storage::Data::Now() - 1);
+    for (auto type : {storage::TypeHashTable::kHashTable,
+                      storage::TypeHashTable::kSelfBalancingTree,
+                      storage::TypeHashTable::kOpenAddressingHashTable,
+                      storage::TypeHashTable::kConcurrentHashTable,
+                      storage::TypeHashTable::kBPlusTree}) {
+        storage::Controller storage(type);
+        const std::string cities[] = {"Boston", "Denver", "Austin"};
+        std::map<std::string, storage::Aggregate> by_city;
+        std::map<std::string, storage::Aggregate> by_year;
+        for (int i = 0; i < 3000; ++i) {
+            const storage::value_t value("S" + std::to_string(i % 7), "N",
+                                         1980 + i % 5, cities[i % 3],
+                                         static_cast<long>(i) - 1000);
+            storage.Set(std::to_string(i), value);
+            by_city[value.GetCity()].Add(value.GetCountCoins());
+            by_year[std::to_string(value.GetBirthYear())].Add(
+                value.GetBirthYear());
+        }
+        storage.Set("expired", expired);
+        const auto cities_total = storage.GroupBy(
+            storage::IndexField::kCity, storage::IndexField::kCountCoins);
+        ASSERT_EQ(cities_total.size(), by_city.size());
+        for (const auto &[city, aggregate] : by_city) {
+            const auto &total = cities_total.at(city);
+            ASSERT_EQ(total.count, aggregate.count);
+            ASSERT_EQ(total.sum, aggregate.sum);
+            ASSERT_EQ(total.min, aggregate.min);
+            ASSERT_EQ(total.max, aggregate.max);
+        }
+        ASSERT_EQ(cities_total.at("Boston").min, -1000);
+        const auto years_total =
+            storage.GroupBy(storage::IndexField::kBirthYear,
+                            storage::IndexField::kBirthYear);
+        ASSERT_EQ(years_total.size(), 5u);
+        for (const auto &[year, aggregate] : by_year) {
+            ASSERT_EQ(years_total.at(year).count, aggregate.count);
+            ASSERT_DOUBLE_EQ(years_total.at(year).Average(), std::stod(year));
+        }
+        const auto surnames = storage.GroupBy(
+            storage::IndexField::kSurname, storage::IndexField::kCountCoins);
+        ASSERT_EQ(surnames.size(), 7u);
+        ASSERT_EQ(surnames.count("Gone"), 0u);
+        ASSERT_THROW(storage.GroupBy(storage::IndexField::kCity,
+                                     storage::IndexField::kName),
+                     std::invalid_argument);
+        ASSERT_THROW(storage.GroupBy(storage::IndexField::kColumns,
+                                     storage::IndexField::kCountCoins),
+                     std::invalid_argument);
+    }
+}
+
+TEST(aggregate_suite, parts_cover_every_record_once) {
+    using storage::TypeHashTable;
+    std::vector<std::pair<TypeHashTable, std::unique_ptr<storage::BaseStorage>>>
+        engines;
+    engines.emplace_back(TypeHashTable::kHashTable,
+                         std::make_unique<storage::HashTable>());
+    engines.emplace_back(
+        TypeHashTable::kSelfBalancingTree,
+        std::make_unique<storage::SelfBalancingBinarySearchTree>());
+    engines.emplace_back(TypeHashTable::kOpenAddressingHashTable,
+                         std::make_unique<storage::OpenAddressingHashTable>());
+    engines.emplace_back(TypeHashTable::kConcurrentHashTable,
+                         std::make_unique<storage::ConcurrentHashTable>());
+    engines.emplace_back(TypeHashTable::kBPlusTree,
+                         std::make_unique<storage::BPlusTree>());
+    for (const auto &[type, engine] : engines) {
+        auto &storage = *engine;
+        // Tree slices are consecutive key ranges.
+        const bool ordered = type == TypeHashTable::kSelfBalancingTree ||
+                             type == TypeHashTable::kBPlusTree;
+        for (std::size_t parts : {1u, 2u, 3u, 7u, 100u}) {
+            std::vector<storage::key_t> keys;
+            for (std::size_t part = 0; part < parts; ++part)
+                storage.ForEachPart(
+                    part, parts,
+                    [&keys](const storage::key_t &key,
+                            const storage::value_t &) { keys.push_back(key); });
+            const std::set<storage::key_t> seen(keys.begin(), keys.end());
+            ASSERT_EQ(seen.size(), keys.size());
+            std::size_t total = 0;
+            storage.ForEach([&total](const storage::key_t &,
+                                     const storage::value_t &) { ++total; });
+            ASSERT_EQ(keys.size(), total);
+            if (ordered) {
+                ASSERT_TRUE(std::is_sorted(keys.begin(), keys.end()));
+            }
+        }
+        for (int i = 0; i < 5000; ++i)
+            storage.Set("key" + std::to_string(i * 7919 % 5000), Eve);
+        for (int i = 0; i < 5000; i += 3)
+            storage.Del("key" + std::to_string(i));
+        for (std::size_t parts : {1u, 2u, 3u, 7u, 100u}) {
+            std::vector<storage::key_t> keys;
+            for (std::size_t part = 0; part < parts; ++part)
+                storage.ForEachPart(
+                    part, parts,
+                    [&keys](const storage::key_t &key,
+                            const storage::value_t &) { keys.push_back(key); });
+            ASSERT_EQ(std::set<storage::key_t>(keys.begin(), keys.end()).size(),
+                      keys.size());
+            ASSERT_EQ(keys.size(), 3333u);
+            if (ordered) {
+                ASSERT_TRUE(std::is_sorted(keys.begin(), keys.end()));
+            }
+        }
+    }
+}
+
+TEST(query_suite, predicates_match_brute_force) {
+    using storage::IndexField;
+    using storage::Predicate;
+    const std::string cities[] = {"Boston", "Denver", "Austin"};
+    const auto record = [&cities](int i) {
+        return storage::value_t("S" + std::to_string(i % 17),
+                                "N" + std::to_string(i % 13), 1978 + i % 9,
+                                cities[i % 3], static_cast<long>(i % 500));
+    };
+    const std::vector<std::pair<Predicate, std::function<bool(int)>>> cases =
+        {{Predicate::Between(IndexField::kBirthYear, 1981, 1983) &&
+              Predicate::Equal(IndexField::kCity, "Denver"),
+          [](int i) { return i % 9 >= 3 && i % 9 <= 5 && i % 3 == 1; }},
+         {Predicate::Prefix(IndexField::kSurname, "S1") ||
+              Predicate::Equal(IndexField::kCountCoins, 7L),
+          [](int i) { return i % 17 >= 10 || i % 17 == 1 || i % 500 == 7; }},
+         {!Predicate::Equal(IndexField::kCity, "Boston") &&
+              Predicate::Between(IndexField::kCountCoins, 100, 120) &&
+              !!Predicate::Equal(IndexField::kName, "N4"),
+          [](int i) {
+              return i % 3 != 0 && i % 500 >= 100 && i % 500 <= 120 &&
+                     i % 13 == 4;
+          }},
+         {Predicate::Equal(IndexField::kCity, "Atlantis") ||
+              (Predicate::Equal(IndexField::kBirthYear, 1980L) &&
+               Predicate::Between(IndexField::kCountCoins, 5, 1)),
+          [](int) { return false; }},
+         {Predicate::Equal(IndexField::kCity, "Austin") ||
+              Predicate::Equal(IndexField::kBirthYear, 1980L),
+          [](int i) { return i % 3 == 2 || i % 9 == 2; }}};
+    storage::value_t expired = record(1);
+    expired.SetExpiryTime(storage::Data::Now() - 1);
+    for (auto type : {storage::TypeHashTable::kHashTable,
+                      storage::TypeHashTable::kSelfBalancingTree,
+                      storage::TypeHashTable::kOpenAddressingHashTable,
+                      storage::TypeHashTable::kConcurrentHashTable,
+                      storage::TypeHashTable::kBPlusTree}) {
+        storage::Controller storage(type);
+        for (int i = 0; i < 3000; ++i)
+            storage.Set(std::to_string(i), record(i));
+        storage.Set("expired", expired);
+        // Once without indexes, then drawing candidates from them.
+        for (int pass = 0; pass < 2; ++pass) {
+            for (const auto &[predicate, expected] : cases) {
+                std::vector<storage::key_t> want;
+                for (int i = 0; i < 3000; ++i)
+                    if (expected(i)) want.push_back(std::to_string(i));
+                auto keys = storage.Query(predicate);
+                std::sort(keys.begin(), keys.end());
+                std::sort(want.begin(), want.end());
+                ASSERT_EQ(keys, want);
+            }
+            storage.CreateIndex(IndexField::kCity);
+            storage.CreateIndex(IndexField::kBirthYear);
+            storage.CreateIndex(IndexField::kCountCoins);
+        }
+    }
+    // A plan compiled before its city was ever stored still finds it.
+    for (bool indexed : {false, true}) {
+        storage::HashTable table;
+        if (indexed) {
+            table.CreateIndex(IndexField::kCity);
+            table.CreateIndex(IndexField::kSurname);
+        }
+        const std::string city = indexed ? "Gondor" : "Rohan";
+        const storage::QueryPlan plan(
+            Predicate::Equal(IndexField::kCity, city) ||
+            Predicate::Equal(IndexField::kSurname, "Surname of " + city));
+        table.Set("first", storage::value_t("A", "B", 1990, city, 1));
+        table.Set("second",
+                  storage::value_t("Surname of " + city, "B", 1990, "C", 1));
+        table.Set("third", Eve);
+        auto keys = table.Select(plan);
+        std::sort(keys.begin(), keys.end());
+        ASSERT_EQ(keys, std::vector<storage::key_t>({"first", "second"}));
+    }
+    ASSERT_THROW(Predicate::Equal(IndexField::kBirthYear, "1990"),
+                 std::invalid_argument);
+    ASSERT_THROW(Predicate::Prefix(IndexField::kColumns, "S"),
+                 std::invalid_argument);
+}
+
+TEST(parallel_suite, full_passes_match_serial_results) {
+    const std::string cities[] = {"Boston", "Denver", "Austin"};
+    storage::value_t expired = Eve;
+    expired.SetExpiryTime(storage::Data::Now() - 1);
+    for (auto type : {storage::TypeHashTable::kHashTable,
+                      storage::TypeHashTable::kSelfBalancingTree,
+                      storage::TypeHashTable::kOpenAddressingHashTable,
+                      storage::TypeHashTable::kConcurrentHashTable,
+                      storage::TypeHashTable::kBPlusTree}) {
+        // Large enough for the passes to be split over the shared pool,
+        // which main sizes to at least two workers.
+        storage::Controller storage(type);
+        std::vector<storage::key_t> all;
+        std::vector<storage::key_t> in_denver;
+        for (int i = 0; i < 40000; ++i) {
+            all.push_back("key" + std::to_string(i * 7919 % 40000));
+            const auto &city = cities[i * 7919 % 40000 % 3];
+            if (city == "Denver") in_denver.push_back(all.back());
+            storage.Set(all.back(), storage::value_t("S", "N", 1990, city,
+                                                     static_cast<long>(i)));
+        }
+        storage.Set("expired", expired);
+        std::sort(all.begin(), all.end());
+        std::sort(in_denver.begin(), in_denver.end());
+        ASSERT_EQ(storage.Keys(), all);
+        storage::optional_value_t query;
+        query.city = "Denver";
+        ASSERT_EQ(storage.Find(query), in_denver);
+        auto matched = storage.Query(
+            storage::Predicate::Equal(storage::IndexField::kCity, "Denver"));
+        std::sort(matched.begin(), matched.end());
+        ASSERT_EQ(matched, in_denver);
+        ASSERT_EQ(storage.Export("parallel.txt"), 40000u);
+        storage::Controller uploaded(type);
+        ASSERT_EQ(uploaded.Upload("parallel.txt"), 40000u);
+        ASSERT_EQ(uploaded.Keys(), all);
+        ASSERT_TRUE(uploaded.Get("key123").value() ==
+                    storage.Get("key123").value());
+        std::remove("parallel.txt");
+    }
+    ASSERT_GE(storage::ThreadPool::Shared().Size(), 2u);
+    ASSERT_THROW(storage::ThreadPool::SetSharedSize(8), std::invalid_argument);
+}
+
 int main(int argc, char **argv) {
+    // At least two workers, so that the full passes take their parallel
+    // path on a single-core machine too.
+    storage::ThreadPool::SetSharedSize(
+        std::max(2u, std::thread::hardware_concurrency()));
     ::testing::InitGoogleTest(&argc, argv);
     return RUN_ALL_TESTS();
 }
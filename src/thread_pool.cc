@@ -0,0 +1,68 @@
+#include "thread_pool.h"
+
+#include <stdexcept>
+
+namespace storage {
+
+namespace {
+
+thread_local bool in_worker = false;
+
+std::mutex shared_mutex;
+std::size_t shared_size = 0;
+bool shared_created = false;
+
+std::size_t CreateShared() {
+    std::lock_guard lock(shared_mutex);
+    shared_created = true;
+    return shared_size != 0 ? shared_size
+                            : std::thread::hardware_concurrency();
+}
+
+}  // namespace
+
+ThreadPool::ThreadPool(std::size_t threads) : stopping_(false) {
+    if (threads == 0) threads = 1;
+    workers_.reserve(threads);
+    for (std::size_t i = 0; i < threads; ++i)
+        workers_.emplace_back([this] { Work(); });
+}
+
+ThreadPool::~ThreadPool() {
+    {
+        std::lock_guard lock(mutex_);
+        stopping_ = true;
+    }
+    ready_.notify_all();
+    for (auto &worker : workers_) worker.join();
+}
+
+ThreadPool &ThreadPool::Shared() {
+    static ThreadPool pool(CreateShared());
+    return pool;
+}
+
+void ThreadPool::SetSharedSize(std::size_t threads) {
+    std::lock_guard lock(shared_mutex);
+    if (shared_created) throw std::invalid_argument("Pool Error!");
+    shared_size = threads;
+}
+
+bool ThreadPool::InWorker() { return in_worker; }
+
+void ThreadPool::Work() {
+    in_worker = true;
+    for (;;) {
+        std::function<void()> task;
+        {
+            std::unique_lock lock(mutex_);
+            ready_.wait(lock, [this] { return stopping_ || !tasks_.empty(); });
+            if (tasks_.empty()) return;
+            task = std::move(tasks_.front());
+            tasks_.pop();
+        }
+        task();
+    }
+}
+
+}  // namespace storage
@@ -0,0 +1,64 @@
+#pragma once
+
+#include <condition_variable>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <queue>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+namespace storage {
+
+// Fixed set of worker threads fed from one task queue. Submit hands back a
+// future for the task's result; the destructor finishes the queued tasks
+// before joining the workers. Shared is the process-wide pool the storage
+// engines split their full passes over.
+class ThreadPool {
+   public:
+    explicit ThreadPool(
+        std::size_t threads = std::thread::hardware_concurrency());
+    ThreadPool(const ThreadPool &other) = delete;
+    ThreadPool &operator=(const ThreadPool &other) = delete;
+    ~ThreadPool();
+
+    template <typename Task>
+    std::future<std::invoke_result_t<Task>> Submit(Task &&task);
+    std::size_t Size() const { return workers_.size(); }
+
+    static ThreadPool &Shared();
+    // Sets the number of workers Shared starts with; 0, the default, means
+    // one per hardware thread. Throws std::invalid_argument once Shared
+    // has been created.
+    static void SetSharedSize(std::size_t threads);
+    // True on a worker of any pool. A task that waited there for other
+    // tasks could deadlock a full pool, so it should do the work inline.
+    static bool InWorker();
+
+   private:
+    void Work();
+
+    std::vector<std::thread> workers_;
+    std::queue<std::function<void()>> tasks_;
+    std::mutex mutex_;
+    std::condition_variable ready_;
+    bool stopping_;
+};
+
+template <typename Task>
+std::future<std::invoke_result_t<Task>> ThreadPool::Submit(Task &&task) {
+    using result_t = std::invoke_result_t<Task>;
+    auto packaged = std::make_shared<std::packaged_task<result_t()>>(
+        std::forward<Task>(task));
+    std::future<result_t> result = packaged->get_future();
+    {
+        std::lock_guard lock(mutex_);
+        tasks_.emplace([packaged] { (*packaged)(); });
+    }
+    ready_.notify_one();
+    return result;
+}
+
+}  // namespace storage
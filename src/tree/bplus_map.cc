@@ -0,0 +1,467 @@
+#include "bplus_map.h"
+
+namespace stl {
+
+template <typename K, typename T, std::size_t LeafSize, std::size_t InnerSize>
+bplus_map<K, T, LeafSize, InnerSize>::bplus_map()
+    : root_(nullptr), first_(nullptr), size_(0), height_(1) {
+    first_ = new Leaf;
+    root_ = first_;
+}
+
+template <typename K, typename T, std::size_t LeafSize, std::size_t InnerSize>
+bplus_map<K, T, LeafSize, InnerSize>::bplus_map(bplus_map &&other)
+    : bplus_map() {
+    swap(other);
+}
+
+template <typename K, typename T, std::size_t LeafSize, std::size_t InnerSize>
+bplus_map<K, T, LeafSize, InnerSize> &
+bplus_map<K, T, LeafSize, InnerSize>::operator=(bplus_map &&other) {
+    if (this != &other) {
+        clear();
+        swap(other);
+    }
+    return *this;
+}
+
+template <typename K, typename T, std::size_t LeafSize, std::size_t InnerSize>
+bplus_map<K, T, LeafSize, InnerSize>::~bplus_map() {
+    destroy(root_);
+}
+
+template <typename K, typename T, std::size_t LeafSize, std::size_t InnerSize>
+void bplus_map<K, T, LeafSize, InnerSize>::destroy(Node *node) {
+    if (node->leaf) {
+        delete static_cast<Leaf *>(node);
+        return;
+    }
+    Inner *inner = static_cast<Inner *>(node);
+    for (std::size_t i = 0; i <= inner->count; ++i) destroy(inner->children[i]);
+    delete inner;
+}
+
+template <typename K, typename T, std::size_t LeafSize, std::size_t InnerSize>
+void bplus_map<K, T, LeafSize, InnerSize>::clear() {
+    Leaf *leaf = new Leaf;
+    destroy(root_);
+    root_ = first_ = leaf;
+    size_ = 0;
+    height_ = 1;
+}
+
+template <typename K, typename T, std::size_t LeafSize, std::size_t InnerSize>
+void bplus_map<K, T, LeafSize, InnerSize>::swap(bplus_map &other) noexcept {
+    std::swap(root_, other.root_);
+    std::swap(first_, other.first_);
+    std::swap(size_, other.size_);
+    std::swap(height_, other.height_);
+}
+
+template <typename K, typename T, std::size_t LeafSize, std::size_t InnerSize>
+typename bplus_map<K, T, LeafSize, InnerSize>::iterator &
+bplus_map<K, T, LeafSize, InnerSize>::iterator::operator++() {
+    // Only the root may be an empty leaf, so the next leaf always has an
+    // element to land on.
+    if (++index_ == leaf_->count) {
+        leaf_ = leaf_->next;
+        index_ = 0;
+    }
+    return *this;
+}
+
+template <typename K, typename T, std::size_t LeafSize, std::size_t InnerSize>
+typename bplus_map<K, T, LeafSize, InnerSize>::iterator
+bplus_map<K, T, LeafSize, InnerSize>::normalize(iterator it) const {
+    while (it.leaf_ != nullptr && it.index_ == it.leaf_->count) {
+        it.leaf_ = it.leaf_->next;
+        it.index_ = 0;
+    }
+    return it;
+}
+
+template <typename K, typename T, std::size_t LeafSize, std::size_t InnerSize>
+typename bplus_map<K, T, LeafSize, InnerSize>::Leaf *
+bplus_map<K, T, LeafSize, InnerSize>::descend(const K &key, Step *path,
+                                              std::size_t &depth) const {
+    Node *node = root_;
+    depth = 0;
+    while (!node->leaf) {
+        Inner *inner = static_cast<Inner *>(node);
+        const auto child = static_cast<std::size_t>(
+            std::upper_bound(inner->keys.begin(),
+                             inner->keys.begin() + inner->count, key) -
+            inner->keys.begin());
+        if (path != nullptr) path[depth++] = Step{inner, child};
+        node = inner->children[child];
+    }
+    return static_cast<Leaf *>(node);
+}
+
+template <typename K, typename T, std::size_t LeafSize, std::size_t InnerSize>
+typename bplus_map<K, T, LeafSize, InnerSize>::iterator
+bplus_map<K, T, LeafSize, InnerSize>::find(const K &key) const {
+    std::size_t depth;
+    Leaf *leaf = descend(key, nullptr, depth);
+    const auto last = leaf->keys.begin() + leaf->count;
+    const auto found = std::lower_bound(leaf->keys.begin(), last, key);
+    if (found == last || key < *found) return end();
+    return iterator(leaf,
+                    static_cast<std::size_t>(found - leaf->keys.begin()));
+}
+
+template <typename K, typename T, std::size_t LeafSize, std::size_t InnerSize>
+typename bplus_map<K, T, LeafSize, InnerSize>::iterator
+bplus_map<K, T, LeafSize, InnerSize>::lower_bound(const K &key) const {
+    std::size_t depth;
+    Leaf *leaf = descend(key, nullptr, depth);
+    const auto found = std::lower_bound(
+        leaf->keys.begin(), leaf->keys.begin() + leaf->count, key);
+    return normalize(
+        iterator(leaf, static_cast<std::size_t>(found - leaf->keys.begin())));
+}
+
+// The ranges start at the first leaf under nodes taken level by level, left
+// to right, until there are enough of them to share out evenly.
+template <typename K, typename T, std::size_t LeafSize, std::size_t InnerSize>
+std::vector<typename bplus_map<K, T, LeafSize, InnerSize>::iterator>
+bplus_map<K, T, LeafSize, InnerSize>::split(size_type parts) const {
+    std::vector<Node *> frontier;
+    if (root_ != nullptr) frontier.push_back(root_);
+    while (!frontier.empty() && frontier.size() < 8 * parts &&
+           !frontier.front()->leaf) {
+        std::vector<Node *> next;
+        for (Node *node : frontier) {
+            const Inner *inner = static_cast<const Inner *>(node);
+            next.insert(next.end(), inner->children.begin(),
+                        inner->children.begin() +
+                            static_cast<std::ptrdiff_t>(inner->count + 1));
+        }
+        frontier.swap(next);
+    }
+    std::vector<iterator> bounds{begin()};
+    for (size_type part = 1; part < parts; ++part) {
+        const size_type index = part * frontier.size() / parts;
+        if (index == 0) continue;
+        Node *node = frontier[index];
+        while (!node->leaf) node = static_cast<Inner *>(node)->children[0];
+        const iterator start =
+            normalize(iterator(static_cast<Leaf *>(node), 0));
+        if (start != bounds.back()) bounds.push_back(start);
+    }
+    bounds.push_back(end());
+    return bounds;
+}
+
+template <typename K, typename T, std::size_t LeafSize, std::size_t InnerSize>
+template <typename Key, typename Value>
+std::pair<typename bplus_map<K, T, LeafSize, InnerSize>::iterator, bool>
+bplus_map<K, T, LeafSize, InnerSize>::insert(Key &&key, Value &&value) {
+    Step path[kMaxHeight];
+    std::size_t depth;
+    Leaf *leaf = descend(key, path, depth);
+    auto position = static_cast<std::size_t>(
+        std::lower_bound(leaf->keys.begin(), leaf->keys.begin() + leaf->count,
+                         key) -
+        leaf->keys.begin());
+    if (position < leaf->count && !(key < leaf->keys[position]))
+        return {iterator(leaf, position), false};
+    if (leaf->count == LeafSize) {
+        Leaf *right = new Leaf;
+        const std::size_t middle = LeafSize / 2;
+        std::move(leaf->keys.begin() + middle, leaf->keys.end(),
+                  right->keys.begin());
+        std::move(leaf->values.begin() + middle, leaf->values.end(),
+                  right->values.begin());
+        right->count = LeafSize - middle;
+        leaf->count = middle;
+        right->next = leaf->next;
+        leaf->next = right;
+        insertSeparator(path, depth, right->keys[0], right);
+        if (position > middle) {
+            leaf = right;
+            position -= middle;
+        }
+    }
+    std::move_backward(leaf->keys.begin() + position,
+                       leaf->keys.begin() + leaf->count,
+                       leaf->keys.begin() + leaf->count + 1);
+    std::move_backward(leaf->values.begin() + position,
+                       leaf->values.begin() + leaf->count,
+                       leaf->values.begin() + leaf->count + 1);
+    leaf->keys[position] = std::forward<Key>(key);
+    leaf->values[position] = std::forward<Value>(value);
+    ++leaf->count;
+    ++size_;
+    return {iterator(leaf, position), true};
+}
+
+// Adds the separator and new right sibling of the child a split came from,
+// splitting full inner nodes on the way up and growing a new root when the
+// old one splits too.
+template <typename K, typename T, std::size_t LeafSize, std::size_t InnerSize>
+void bplus_map<K, T, LeafSize, InnerSize>::insertSeparator(Step *path,
+                                                           std::size_t depth,
+                                                           K key,
+                                                           Node *right) {
+    while (depth > 0) {
+        const Step step = path[--depth];
+        Inner *node = step.node;
+        const std::size_t at = step.child;
+        if (node->count < InnerSize) {
+            std::move_backward(node->keys.begin() + at,
+                               node->keys.begin() + node->count,
+                               node->keys.begin() + node->count + 1);
+            std::copy_backward(node->children.begin() + at + 1,
+                               node->children.begin() + node->count + 1,
+                               node->children.begin() + node->count + 2);
+            node->keys[at] = std::move(key);
+            node->children[at + 1] = right;
+            ++node->count;
+            return;
+        }
+        std::array<K, InnerSize + 1> keys;
+        std::array<Node *, InnerSize + 2> children;
+        std::move(node->keys.begin(), node->keys.begin() + at, keys.begin());
+        keys[at] = std::move(key);
+        std::move(node->keys.begin() + at, node->keys.end(),
+                  keys.begin() + at + 1);
+        std::copy(node->children.begin(), node->children.begin() + at + 1,
+                  children.begin());
+        children[at + 1] = right;
+        std::copy(node->children.begin() + at + 1, node->children.end(),
+                  children.begin() + at + 2);
+        const std::size_t middle = InnerSize / 2;
+        Inner *sibling = new Inner;
+        std::move(keys.begin(), keys.begin() + middle, node->keys.begin());
+        std::copy(children.begin(), children.begin() + middle + 1,
+                  node->children.begin());
+        node->count = middle;
+        std::move(keys.begin() + middle + 1, keys.end(),
+                  sibling->keys.begin());
+        std::copy(children.begin() + middle + 1, children.end(),
+                  sibling->children.begin());
+        sibling->count = InnerSize - middle;
+        key = std::move(keys[middle]);
+        right = sibling;
+    }
+    Inner *root = new Inner;
+    root->keys[0] = std::move(key);
+    root->children[0] = root_;
+    root->children[1] = right;
+    root->count = 1;
+    root_ = root;
+    ++height_;
+}
+
+template <typename K, typename T, std::size_t LeafSize, std::size_t InnerSize>
+bool bplus_map<K, T, LeafSize, InnerSize>::erase(const K &key) {
+    Step path[kMaxHeight];
+    std::size_t depth;
+    Leaf *leaf = descend(key, path, depth);
+    const auto position = static_cast<std::size_t>(
+        std::lower_bound(leaf->keys.begin(), leaf->keys.begin() + leaf->count,
+                         key) -
+        leaf->keys.begin());
+    if (position == leaf->count || key < leaf->keys[position]) return false;
+    std::move(leaf->keys.begin() + position + 1,
+              leaf->keys.begin() + leaf->count,
+              leaf->keys.begin() + position);
+    std::move(leaf->values.begin() + position + 1,
+              leaf->values.begin() + leaf->count,
+              leaf->values.begin() + position);
+    --leaf->count;
+    leaf->keys[leaf->count] = K();
+    leaf->values[leaf->count] = T();
+    --size_;
+    // A separator equal to the erased key still splits its children
+    // correctly, so the inner nodes only change when a node runs short.
+    rebalance(path, depth);
+    return true;
+}
+
+template <typename K, typename T, std::size_t LeafSize, std::size_t InnerSize>
+void bplus_map<K, T, LeafSize, InnerSize>::removeChild(Inner *parent,
+                                                       std::size_t key_index) {
+    std::move(parent->keys.begin() + key_index + 1,
+              parent->keys.begin() + parent->count,
+              parent->keys.begin() + key_index);
+    std::copy(parent->children.begin() + key_index + 2,
+              parent->children.begin() + parent->count + 1,
+              parent->children.begin() + key_index + 1);
+    --parent->count;
+    parent->keys[parent->count] = K();
+}
+
+// Walks back up the path from a leaf that lost an element: a node below
+// half full borrows from a sibling that can spare one, otherwise it merges
+// with that sibling, which takes a separator out of the parent and may
+// leave the parent short in turn.
+template <typename K, typename T, std::size_t LeafSize, std::size_t InnerSize>
+void bplus_map<K, T, LeafSize, InnerSize>::rebalance(Step *path,
+                                                     std::size_t depth) {
+    while (depth > 0) {
+        Inner *parent = path[depth - 1].node;
+        const std::size_t at = path[depth - 1].child;
+        Node *node = parent->children[at];
+        Node *left = at > 0 ? parent->children[at - 1] : nullptr;
+        Node *right = at < parent->count ? parent->children[at + 1] : nullptr;
+        if (node->leaf) {
+            if (node->count >= kMinLeaf) return;
+            Leaf *leaf = static_cast<Leaf *>(node);
+            Leaf *left_leaf = static_cast<Leaf *>(left);
+            Leaf *right_leaf = static_cast<Leaf *>(right);
+            if (left_leaf != nullptr && left_leaf->count > kMinLeaf) {
+                std::move_backward(leaf->keys.begin(),
+                                   leaf->keys.begin() + leaf->count,
+                                   leaf->keys.begin() + leaf->count + 1);
+                std::move_backward(leaf->values.begin(),
+                                   leaf->values.begin() + leaf->count,
+                                   leaf->values.begin() + leaf->count + 1);
+                --left_leaf->count;
+                leaf->keys[0] = std::move(left_leaf->keys[left_leaf->count]);
+                leaf->values[0] =
+                    std::move(left_leaf->values[left_leaf->count]);
+                ++leaf->count;
+                parent->keys[at - 1] = leaf->keys[0];
+                return;
+            }
+            if (right_leaf != nullptr && right_leaf->count > kMinLeaf) {
+                leaf->keys[leaf->count] = std::move(right_leaf->keys[0]);
+                leaf->values[leaf->count] = std::move(right_leaf->values[0]);
+                ++leaf->count;
+                std::move(right_leaf->keys.begin() + 1,
+                          right_leaf->keys.begin() + right_leaf->count,
+                          right_leaf->keys.begin());
+                std::move(right_leaf->values.begin() + 1,
+                          right_leaf->values.begin() + right_leaf->count,
+                          right_leaf->values.begin());
+                --right_leaf->count;
+                parent->keys[at] = right_leaf->keys[0];
+                return;
+            }
+            Leaf *into = left_leaf != nullptr ? left_leaf : leaf;
+            Leaf *from = left_leaf != nullptr ? leaf : right_leaf;
+            std::move(from->keys.begin(), from->keys.begin() + from->count,
+                      into->keys.begin() + into->count);
+            std::move(from->values.begin(),
+                      from->values.begin() + from->count,
+                      into->values.begin() + into->count);
+            into->count += from->count;
+            into->next = from->next;
+            delete from;
+        } else {
+            if (node->count >= kMinInner) return;
+            Inner *inner = static_cast<Inner *>(node);
+            Inner *left_inner = static_cast<Inner *>(left);
+            Inner *right_inner = static_cast<Inner *>(right);
+            if (left_inner != nullptr && left_inner->count > kMinInner) {
+                std::move_backward(inner->keys.begin(),
+                                   inner->keys.begin() + inner->count,
+                                   inner->keys.begin() + inner->count + 1);
+                std::copy_backward(inner->children.begin(),
+                                   inner->children.begin() + inner->count + 1,
+                                   inner->children.begin() + inner->count + 2);
+                inner->keys[0] = std::move(parent->keys[at - 1]);
+                inner->children[0] = left_inner->children[left_inner->count];
+                parent->keys[at - 1] =
+                    std::move(left_inner->keys[left_inner->count - 1]);
+                --left_inner->count;
+                ++inner->count;
+                return;
+            }
+            if (right_inner != nullptr && right_inner->count > kMinInner) {
+                inner->keys[inner->count] = std::move(parent->keys[at]);
+                inner->children[inner->count + 1] = right_inner->children[0];
+                parent->keys[at] = std::move(right_inner->keys[0]);
+                std::move(right_inner->keys.begin() + 1,
+                          right_inner->keys.begin() + right_inner->count,
+                          right_inner->keys.begin());
+                std::copy(right_inner->children.begin() + 1,
+                          right_inner->children.begin() + right_inner->count +
+                              1,
+                          right_inner->children.begin());
+                --right_inner->count;
+                ++inner->count;
+                return;
+            }
+            Inner *into = left_inner != nullptr ? left_inner : inner;
+            Inner *from = left_inner != nullptr ? inner : right_inner;
+            const std::size_t separator = left_inner != nullptr ? at - 1 : at;
+            into->keys[into->count] = std::move(parent->keys[separator]);
+            std::move(from->keys.begin(), from->keys.begin() + from->count,
+                      into->keys.begin() + into->count + 1);
+            std::copy(from->children.begin(),
+                      from->children.begin() + from->count + 1,
+                      into->children.begin() + into->count + 1);
+            into->count += from->count + 1;
+            delete from;
+        }
+        removeChild(parent, left != nullptr ? at - 1 : at);
+        --depth;
+    }
+    if (!root_->leaf && root_->count == 0) {
+        Inner *old_root = static_cast<Inner *>(root_);
+        root_ = old_root->children[0];
+        delete old_root;
+        --height_;
+    }
+}
+
+template <typename K, typename T, std::size_t LeafSize, std::size_t InnerSize>
+void bplus_map<K, T, LeafSize, InnerSize>::assignSorted(
+    std::vector<value_type> &&items) {
+    clear();
+    if (items.empty()) return;
+    // Spreading the elements evenly over the fewest nodes that hold them
+    // keeps every node at least half full.
+    const std::size_t leaves = (items.size() + LeafSize - 1) / LeafSize;
+    std::vector<Node *> level;
+    std::vector<const K *> lowest;
+    level.reserve(leaves);
+    lowest.reserve(leaves);
+    Leaf *previous = nullptr;
+    std::size_t begin = 0;
+    for (std::size_t i = 0; i < leaves; ++i) {
+        const std::size_t end = items.size() * (i + 1) / leaves;
+        Leaf *leaf = previous == nullptr ? first_ : new Leaf;
+        for (std::size_t j = begin; j < end; ++j) {
+            leaf->keys[j - begin] = std::move(items[j].first);
+            leaf->values[j - begin] = std::move(items[j].second);
+        }
+        leaf->count = end - begin;
+        if (previous != nullptr) previous->next = leaf;
+        previous = leaf;
+        level.push_back(leaf);
+        lowest.push_back(&leaf->keys[0]);
+        begin = end;
+    }
+    while (level.size() > 1) {
+        const std::size_t parents =
+            (level.size() + InnerSize) / (InnerSize + 1);
+        std::vector<Node *> upper;
+        std::vector<const K *> upper_lowest;
+        upper.reserve(parents);
+        upper_lowest.reserve(parents);
+        begin = 0;
+        for (std::size_t i = 0; i < parents; ++i) {
+            const std::size_t end = level.size() * (i + 1) / parents;
+            Inner *inner = new Inner;
+            for (std::size_t j = begin; j < end; ++j) {
+                inner->children[j - begin] = level[j];
+                if (j > begin) inner->keys[j - begin - 1] = *lowest[j];
+            }
+            inner->count = end - begin - 1;
+            upper.push_back(inner);
+            upper_lowest.push_back(lowest[begin]);
+            begin = end;
+        }
+        level.swap(upper);
+        lowest.swap(upper_lowest);
+        ++height_;
+    }
+    root_ = level.front();
+    size_ = items.size();
+}
+
+};  // namespace stl
@@ -0,0 +1,127 @@
+#ifndef SRC_BPLUS_MAP_H_
+#define SRC_BPLUS_MAP_H_
+
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <utility>
+#include <vector>
+
+namespace stl {
+
+// Ordered map kept in a B+-tree. Every node holds up to LeafSize keys (or
+// InnerSize keys and one child more) in contiguous arrays, so a lookup does
+// a binary search inside a few wide nodes instead of following one pointer
+// per comparison. Keys and values live only in the leaves, which are chained
+// left to right, so ordered iteration walks arrays and never climbs back up
+// the tree. Values sit next to, not between, the keys of a leaf, so a search
+// reads only keys.
+template <typename K, typename T, std::size_t LeafSize = 32,
+          std::size_t InnerSize = 64>
+class bplus_map {
+    static_assert(LeafSize >= 4 && InnerSize >= 4 && InnerSize % 2 == 0,
+                  "nodes must be able to split and merge");
+
+    struct Node {
+        explicit Node(bool is_leaf) : leaf(is_leaf), count(0) {}
+        bool leaf;
+        std::size_t count;
+    };
+    struct Leaf : Node {
+        Leaf() : Node(true), next(nullptr) {}
+        std::array<K, LeafSize> keys;
+        std::array<T, LeafSize> values;
+        Leaf *next;
+    };
+    struct Inner : Node {
+        Inner() : Node(false) {}
+        std::array<K, InnerSize> keys;
+        std::array<Node *, InnerSize + 1> children;
+    };
+
+   public:
+    using key_type = K;
+    using mapped_type = T;
+    using value_type = std::pair<K, T>;
+    using size_type = std::size_t;
+
+    class iterator {
+       public:
+        iterator() : leaf_(nullptr), index_(0) {}
+        const K &key() const { return leaf_->keys[index_]; }
+        T &value() const { return leaf_->values[index_]; }
+        iterator &operator++();
+        bool operator==(const iterator &other) const {
+            return leaf_ == other.leaf_ && index_ == other.index_;
+        }
+        bool operator!=(const iterator &other) const {
+            return !(*this == other);
+        }
+
+       private:
+        friend class bplus_map;
+        iterator(Leaf *leaf, std::size_t index) : leaf_(leaf), index_(index) {}
+
+        Leaf *leaf_;
+        std::size_t index_;
+    };
+
+    bplus_map();
+    bplus_map(const bplus_map &other) = delete;
+    bplus_map(bplus_map &&other);
+    bplus_map &operator=(const bplus_map &other) = delete;
+    bplus_map &operator=(bplus_map &&other);
+    ~bplus_map();
+
+    iterator begin() const { return normalize(iterator(first_, 0)); }
+    iterator end() const { return iterator(); }
+    iterator find(const K &key) const;
+    // First element whose key is not less than key.
+    iterator lower_bound(const K &key) const;
+    bool contains(const K &key) const { return find(key) != end(); }
+    // Cuts the map into at most `parts` consecutive ranges of similar size:
+    // range i is [bounds[i], bounds[i + 1]), in key order.
+    std::vector<iterator> split(size_type parts) const;
+
+    // Leaves an existing key alone and returns false with its position.
+    template <typename Key, typename Value>
+    std::pair<iterator, bool> insert(Key &&key, Value &&value);
+    bool erase(const K &key);
+    // Replaces the contents with items, which must be sorted by key and free
+    // of duplicates; the leaves are filled bottom-up without any splits.
+    void assignSorted(std::vector<value_type> &&items);
+    void clear();
+    void swap(bplus_map &other) noexcept;
+
+    size_type size() const { return size_; }
+    bool empty() const { return size_ == 0; }
+    size_type height() const { return height_; }
+
+   private:
+    static constexpr std::size_t kMinLeaf = LeafSize / 2;
+    static constexpr std::size_t kMinInner = InnerSize / 2;
+    // Enough for far more elements than fit in memory at the minimum fill.
+    static constexpr std::size_t kMaxHeight = 64;
+
+    struct Step {
+        Inner *node;
+        std::size_t child;
+    };
+
+    iterator normalize(iterator it) const;
+    Leaf *descend(const K &key, Step *path, std::size_t &depth) const;
+    void insertSeparator(Step *path, std::size_t depth, K key, Node *right);
+    void rebalance(Step *path, std::size_t depth);
+    static void removeChild(Inner *parent, std::size_t key_index);
+    static void destroy(Node *node);
+
+    Node *root_;
+    Leaf *first_;
+    size_type size_;
+    size_type height_;
+};
+
+};  // namespace stl
+
+#include "bplus_map.cc"
+#endif  // SRC_BPLUS_MAP_H_
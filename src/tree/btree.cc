@@ -2,97 +2,176 @@
 
 namespace stl {
 
-template <typename K, typename T>
-Btree<K, T> &Btree<K, T>::operator=(Btree<K, T> &&other) {
+template <typename K, typename T, typename Allocator>
+Btree<K, T, Allocator> &Btree<K, T, Allocator>::operator=(
+    Btree<K, T, Allocator> &&other) {
     if (this == &other) return *this;
-    if (root_) clear();
+    clear();
     size_ = other.size_;
     root_ = other.root_;
+    allocator_ = std::move(other.allocator_);
     other.root_ = nullptr;
     other.size_ = 0;
     return *this;
 }
 
-template <typename K, typename T>
-Btree<K, T>::Btree(const Btree<K, T> &other) {
-    for (auto &&item : other) insert(item);
+template <typename K, typename T, typename Allocator>
+Btree<K, T, Allocator>::Btree(const Btree<K, T, Allocator> &other)
+    : Btree() {
+    for (auto it = other.begin(); it != other.end(); ++it)
+        reinsert(createNode(*it));
 }
 
-template <typename K, typename T>
-Btree<K, T>::Btree(const std::initializer_list<K> &items) : Btree() {
+template <typename K, typename T, typename Allocator>
+Btree<K, T, Allocator>::Btree(const std::initializer_list<K> &items) : Btree() {
     for (auto &item : items) insert(item);
 }
 
-template <typename K, typename T>
-void Btree<K, T>::clear() {
+template <typename K, typename T, typename Allocator>
+void Btree<K, T, Allocator>::clear() {
     if (root_) clean(this->root_);
+    if constexpr (std::is_same_v<Allocator, SlabAllocator<Node>>)
+        allocator_.release();
     root_ = nullptr;
     size_ = 0;
 }
 
-template <typename K, typename T>
-void Btree<K, T>::clean(Node *root) {
+// With the slab allocator the nodes are only destroyed here and clear()
+// drops their memory afterwards in one go; trivially destructible nodes
+// are not visited at all.
+template <typename K, typename T, typename Allocator>
+void Btree<K, T, Allocator>::clean(Node *root) {
+    constexpr bool bulk = std::is_same_v<Allocator, SlabAllocator<Node>>;
+    if constexpr (bulk && std::is_trivially_destructible_v<Node>) return;
     if (root) {
         if (root->left) clean(root->left);
         if (root->right) clean(root->right);
-        delete root;
+        if constexpr (bulk)
+            node_traits::destroy(allocator_, root);
+        else
+            destroyNode(root);
     }
 }
 
-template <typename K, typename T>
-Btree<K, T>::~Btree() {
+template <typename K, typename T, typename Allocator>
+template <typename... Args>
+typename Btree<K, T, Allocator>::Node *Btree<K, T, Allocator>::createNode(
+    Args &&...args) {
+    Node *node = node_traits::allocate(allocator_, 1);
+    try {
+        node_traits::construct(allocator_, node, std::forward<Args>(args)...);
+    } catch (...) {
+        node_traits::deallocate(allocator_, node, 1);
+        throw;
+    }
+    return node;
+}
+
+template <typename K, typename T, typename Allocator>
+void Btree<K, T, Allocator>::destroyNode(Node *node) {
+    node_traits::destroy(allocator_, node);
+    node_traits::deallocate(allocator_, node, 1);
+}
+
+template <typename K, typename T, typename Allocator>
+Btree<K, T, Allocator>::~Btree() {
     this->clear();
 }
 
-template <typename K, typename T>
-size_t Btree<K, T>::max_size() {
+template <typename K, typename T, typename Allocator>
+size_t Btree<K, T, Allocator>::max_size() {
     return std::numeric_limits<size_t>::max() / sizeof(Node) / 2;
 }
 
-template <typename K, typename T>
-void Btree<K, T>::swap(Btree<K, T> &other) {
+template <typename K, typename T, typename Allocator>
+void Btree<K, T, Allocator>::swap(Btree<K, T, Allocator> &other) {
     if (this->root_ != other.root_) {
         std::swap(root_, other.root_);
         std::swap(size_, other.size_);
+        std::swap(allocator_, other.allocator_);
     }
 }
 
-template <typename K, typename T>
-typename Btree<K, T>::iterator Btree<K, T>::find(const_reference_key key) {
+template <typename K, typename T, typename Allocator>
+typename Btree<K, T, Allocator>::iterator Btree<K, T, Allocator>::find(
+    const_reference_key key) {
     std::pair<iterator, bool> result = search(key);
     return result.first;
 }
 
-template <typename K, typename T>
-bool Btree<K, T>::contains(const_reference_key key) {
+template <typename K, typename T, typename Allocator>
+typename Btree<K, T, Allocator>::iterator Btree<K, T, Allocator>::lower_bound(
+    const_reference_key key) const {
+    Node *candidate = nullptr;
+    for (Node *node = root_; node != nullptr;) {
+        if (node->data.first < key) {
+            node = node->right;
+        } else {
+            candidate = node;
+            node = node->left;
+        }
+    }
+    return iterator(candidate);
+}
+
+// The ranges start at the first key of subtrees a few levels down, taken
+// left to right. A node above them falls inside the range of the subtree
+// to its left, so every node is in exactly one range.
+template <typename K, typename T, typename Allocator>
+std::vector<typename Btree<K, T, Allocator>::iterator>
+Btree<K, T, Allocator>::split(size_type parts) const {
+    std::vector<Node *> frontier;
+    if (root_ != nullptr) frontier.push_back(root_);
+    while (frontier.size() < 8 * parts) {
+        std::vector<Node *> next;
+        for (Node *node : frontier) {
+            if (node->left != nullptr) next.push_back(node->left);
+            if (node->right != nullptr) next.push_back(node->right);
+        }
+        if (next.size() <= frontier.size()) break;
+        frontier.swap(next);
+    }
+    std::vector<iterator> bounds{begin()};
+    for (size_type part = 1; part < parts; ++part) {
+        const size_type index = part * frontier.size() / parts;
+        if (index == 0) continue;
+        Node *start = frontier[index]->minimalNode();
+        if (start != bounds.back().iter_) bounds.emplace_back(start);
+    }
+    bounds.push_back(end());
+    return bounds;
+}
+
+template <typename K, typename T, typename Allocator>
+bool Btree<K, T, Allocator>::contains(const_reference_key key) {
     std::pair<iterator, bool> result = search(key);
     return (result.second == true) ? true : false;
 }
 
-template <typename K, typename T>
-std::pair<typename Btree<K, T>::iterator, bool> Btree<K, T>::search(
-    const_reference_key key) {
+template <typename K, typename T, typename Allocator>
+std::pair<typename Btree<K, T, Allocator>::iterator, bool>
+Btree<K, T, Allocator>::search(const_reference_key key) {
     std::pair<iterator, bool> result;
     result.second = false;
     result.first = root_;
     Node *p_root = root_;
     if (!empty()) {
-        if (root_->data->first == key) {
+        if (root_->data.first == key) {
             result.first.iter_ = p_root;
             result.second = true;
         } else {
             for (;;) {
-                if (key < p_root->data->first && p_root->left != nullptr) {
-                    if (p_root->left->data->first == key) {
+                if (key < p_root->data.first && p_root->left != nullptr) {
+                    if (p_root->left->data.first == key) {
                         result.first.iter_ = p_root->left;
                         result.second = true;
                         return result;
                     } else {
                         p_root = p_root->left;
                     }
-                } else if (key > p_root->data->first &&
+                } else if (key > p_root->data.first &&
                            p_root->right != nullptr) {
-                    if (p_root->right->data->first == key) {
+                    if (p_root->right->data.first == key) {
                         result.first.iter_ = p_root->right;
                         result.second = true;
                         return result;
@@ -112,98 +191,269 @@ std::pair<typename Btree<K, T>::iterator, bool> Btree<K, T>::search(
     return result;
 }
 
-template <typename K, typename T>
-typename Btree<K, T>::iterator Btree<K, T>::insert(const_reference_key value) {
+template <typename K, typename T, typename Allocator>
+typename Btree<K, T, Allocator>::iterator Btree<K, T, Allocator>::insert(
+    const_reference_key value) {
+    return reinsert(createNode(std::piecewise_construct,
+                               std::forward_as_tuple(value), std::tuple<>()));
+}
+
+template <typename K, typename T, typename Allocator>
+typename Btree<K, T, Allocator>::iterator Btree<K, T, Allocator>::insert(
+    K &&value) {
+    return reinsert(createNode(std::piecewise_construct,
+                               std::forward_as_tuple(std::move(value)),
+                               std::tuple<>()));
+}
+
+template <typename K, typename T, typename Allocator>
+typename Btree<K, T, Allocator>::iterator Btree<K, T, Allocator>::reinsert(
+    Node *elm) {
     Node *p = root_;
     Node *q = nullptr;
-    iterator it;
-    Node *elm = new Node;
-    elm->data->first = value;
     ++size_;
     while (p) {
         q = p;
-        p = (elm->data->first < p->data->first) ? p->left : p->right;
+        p = (elm->data.first < p->data.first) ? p->left : p->right;
     }
     elm->parent = q;
+    elm->left = elm->right = nullptr;
+    elm->color = Color::RED;
     if (q == nullptr) {
         root_ = elm;
-        it.iter_ = root_;
-    } else if (elm->data->first < q->data->first) {
+    } else if (elm->data.first < q->data.first) {
         q->left = elm;
-        it.iter_ = q->left;
     } else {
         q->right = elm;
-        it.iter_ = q->right;
     }
-    return it;
+    insertFixup(elm);
+    return iterator(elm);
+}
+
+// Replaces the contents with items, which must be sorted by key and free of
+// duplicates. Splitting at the middle keeps every leaf within one level of
+// the others, so colouring the nodes below the last complete level red and
+// the rest black gives a valid red-black tree without any rotations.
+template <typename K, typename T, typename Allocator>
+void Btree<K, T, Allocator>::assignSorted(std::vector<value_type> &&items) {
+    clear();
+    size_type complete_levels = 0;
+    while ((size_type{2} << complete_levels) - 1 <= items.size())
+        ++complete_levels;
+    root_ = buildSorted(items.data(), items.size(), nullptr, 0,
+                        complete_levels);
+    size_ = items.size();
+}
+
+template <typename K, typename T, typename Allocator>
+typename Btree<K, T, Allocator>::Node *Btree<K, T, Allocator>::buildSorted(
+    value_type *items, size_type count, Node *parent, size_type depth,
+    size_type red_depth) {
+    if (count == 0) return nullptr;
+    const size_type middle = count / 2;
+    Node *node = createNode(std::move(items[middle]));
+    node->parent = parent;
+    node->color = depth >= red_depth ? Color::RED : Color::BLACK;
+    node->left = buildSorted(items, middle, node, depth + 1, red_depth);
+    node->right = buildSorted(items + middle + 1, count - middle - 1, node,
+                              depth + 1, red_depth);
+    return node;
 }
 
-template <typename K, typename T>
-void Btree<K, T>::erase(iterator pos) {
+template <typename K, typename T, typename Allocator>
+void Btree<K, T, Allocator>::erase(iterator pos) {
+    destroyNode(extract(pos));
+}
+
+template <typename K, typename T, typename Allocator>
+typename Btree<K, T, Allocator>::Node *Btree<K, T, Allocator>::extract(
+    iterator pos) {
     Node *current = pos.iter_;
     if (current == nullptr)
         throw std::out_of_range("position must not be nullptr!");
 
-    if (current->left == nullptr && current->right == nullptr) {
-        if (current->parent == nullptr) {
-            root_ = nullptr;
-        } else if (current == current->parent->left) {
-            current->parent->left = nullptr;
-        } else if (current == current->parent->right) {
-            current->parent->right = nullptr;
-        }
-        delete current;
-        current = nullptr;
-    } else if (current->left == nullptr && current->right != nullptr) {
-        if (current->parent != nullptr) {
-            if (current->parent->left == current) {
-                current->parent->left = current->right;
-            } else if (current->parent->right == current) {
-                current->parent->right = current->right;
-            }
+    Node *child = nullptr;
+    Node *child_parent = nullptr;
+    Color removed_color = current->color;
+    if (current->left == nullptr) {
+        child = current->right;
+        child_parent = current->parent;
+        transplant(current, current->right);
+    } else if (current->right == nullptr) {
+        child = current->left;
+        child_parent = current->parent;
+        transplant(current, current->left);
+    } else {
+        Node *replace = current->right->minimalNode();
+        removed_color = replace->color;
+        child = replace->right;
+        if (replace->parent == current) {
+            child_parent = replace;
         } else {
-            root_ = current->right;
+            child_parent = replace->parent;
+            transplant(replace, replace->right);
+            replace->right = current->right;
+            replace->right->parent = replace;
         }
-        current->right->parent = current->parent;
-        delete current;
-        current = nullptr;
-    } else if (current->left != nullptr && current->right == nullptr) {
-        if (current->parent != nullptr) {
-            if (current->parent->left == current) {
-                current->parent->left = current->left;
-            } else if (current->parent->right == current) {
-                current->parent->right = current->left;
+        transplant(current, replace);
+        replace->left = current->left;
+        replace->left->parent = replace;
+        replace->color = current->color;
+    }
+    --size_;
+    if (removed_color == Color::BLACK) eraseFixup(child, child_parent);
+    current->parent = current->left = current->right = nullptr;
+    return current;
+}
+
+template <typename K, typename T, typename Allocator>
+void Btree<K, T, Allocator>::rotateLeft(Node *node) {
+    Node *pivot = node->right;
+    node->right = pivot->left;
+    if (pivot->left) pivot->left->parent = node;
+    transplant(node, pivot);
+    pivot->left = node;
+    node->parent = pivot;
+}
+
+template <typename K, typename T, typename Allocator>
+void Btree<K, T, Allocator>::rotateRight(Node *node) {
+    Node *pivot = node->left;
+    node->left = pivot->right;
+    if (pivot->right) pivot->right->parent = node;
+    transplant(node, pivot);
+    pivot->right = node;
+    node->parent = pivot;
+}
+
+template <typename K, typename T, typename Allocator>
+void Btree<K, T, Allocator>::transplant(Node *node, Node *child) {
+    if (node->parent == nullptr) {
+        root_ = child;
+    } else if (node == node->parent->left) {
+        node->parent->left = child;
+    } else {
+        node->parent->right = child;
+    }
+    if (child) child->parent = node->parent;
+}
+
+template <typename K, typename T, typename Allocator>
+void Btree<K, T, Allocator>::insertFixup(Node *node) {
+    while (isRed(node->parent)) {
+        Node *parent = node->parent;
+        Node *grandparent = parent->parent;
+        if (parent == grandparent->left) {
+            Node *uncle = grandparent->right;
+            if (isRed(uncle)) {
+                parent->color = uncle->color = Color::BLACK;
+                grandparent->color = Color::RED;
+                node = grandparent;
+                continue;
+            }
+            if (node == parent->right) {
+                rotateLeft(parent);
+                std::swap(node, parent);
             }
+            parent->color = Color::BLACK;
+            grandparent->color = Color::RED;
+            rotateRight(grandparent);
         } else {
-            root_ = current->left;
+            Node *uncle = grandparent->left;
+            if (isRed(uncle)) {
+                parent->color = uncle->color = Color::BLACK;
+                grandparent->color = Color::RED;
+                node = grandparent;
+                continue;
+            }
+            if (node == parent->left) {
+                rotateRight(parent);
+                std::swap(node, parent);
+            }
+            parent->color = Color::BLACK;
+            grandparent->color = Color::RED;
+            rotateLeft(grandparent);
         }
-        current->left->parent = current->parent;
-        delete current;
-        current = nullptr;
-    } else {
-        Node *replace = current->right->minimalNode();
-        current->data->first = replace->data->first;
-        current->data->second = replace->data->second;
-        if (replace->parent->left == replace) {
-            replace->parent->left = replace->right;
+    }
+    root_->color = Color::BLACK;
+}
+
+template <typename K, typename T, typename Allocator>
+void Btree<K, T, Allocator>::eraseFixup(Node *node, Node *parent) {
+    // node may be a null leaf, so its parent is tracked separately.
+    while (node != root_ && !isRed(node)) {
+        if (node == parent->left) {
+            Node *sibling = parent->right;
+            if (isRed(sibling)) {
+                sibling->color = Color::BLACK;
+                parent->color = Color::RED;
+                rotateLeft(parent);
+                sibling = parent->right;
+            }
+            if (!isRed(sibling->left) && !isRed(sibling->right)) {
+                sibling->color = Color::RED;
+                node = parent;
+                parent = node->parent;
+            } else {
+                if (!isRed(sibling->right)) {
+                    sibling->left->color = Color::BLACK;
+                    sibling->color = Color::RED;
+                    rotateRight(sibling);
+                    sibling = parent->right;
+                }
+                sibling->color = parent->color;
+                parent->color = Color::BLACK;
+                sibling->right->color = Color::BLACK;
+                rotateLeft(parent);
+                node = root_;
+            }
         } else {
-            replace->parent->right = replace->right;
+            Node *sibling = parent->left;
+            if (isRed(sibling)) {
+                sibling->color = Color::BLACK;
+                parent->color = Color::RED;
+                rotateRight(parent);
+                sibling = parent->left;
+            }
+            if (!isRed(sibling->left) && !isRed(sibling->right)) {
+                sibling->color = Color::RED;
+                node = parent;
+                parent = node->parent;
+            } else {
+                if (!isRed(sibling->left)) {
+                    sibling->right->color = Color::BLACK;
+                    sibling->color = Color::RED;
+                    rotateLeft(sibling);
+                    sibling = parent->left;
+                }
+                sibling->color = parent->color;
+                parent->color = Color::BLACK;
+                sibling->left->color = Color::BLACK;
+                rotateRight(parent);
+                node = root_;
+            }
         }
-        delete replace;
-        replace = nullptr;
     }
+    if (node) node->color = Color::BLACK;
+}
+
+template <typename K, typename T, typename Allocator>
+typename Btree<K, T, Allocator>::size_type Btree<K, T, Allocator>::height(
+    const Node *node) const {
+    if (node == nullptr) return 0;
+    return 1 + std::max(height(node->left), height(node->right));
 }
 
-template <typename K, typename T>
-void Btree<K, T>::print(Node *root) {
+template <typename K, typename T, typename Allocator>
+void Btree<K, T, Allocator>::print(Node *root) {
     if (root == nullptr) return;
     print(root->left);
-    std::cout << root->data->first << " ";
+    std::cout << root->data.first << " ";
     print(root->right);
 }
 
-template <typename K, typename T>
-void Btree<K, T>::printTree(Node *elm, int depth) {
+template <typename K, typename T, typename Allocator>
+void Btree<K, T, Allocator>::printTree(Node *elm, int depth) {
     if (elm->right) {
         printTree(elm->right, depth + 4);
     }
@@ -213,7 +463,7 @@ void Btree<K, T>::printTree(Node *elm, int depth) {
     if (elm->right) {
         std::cout << " /\n" << std::setw(depth) << " ";
     }
-    std::cout << elm->data->first << "\n ";
+    std::cout << elm->data.first << "\n ";
     if (elm->left) {
         std::cout << std::setw(depth) << " "
                   << " \\\n";
@@ -221,15 +471,16 @@ void Btree<K, T>::printTree(Node *elm, int depth) {
     }
 }
 
-template <typename K, typename T>
-typename Btree<K, T>::Iterator Btree<K, T>::begin() const {
+template <typename K, typename T, typename Allocator>
+typename Btree<K, T, Allocator>::Iterator Btree<K, T, Allocator>::begin()
+    const {
     Iterator start;
     if (root_ != nullptr) start.iter_ = root_->minimalNode();
     return start;
 }
 
-template <typename K, typename T>
-typename Btree<K, T>::Iterator Btree<K, T>::end() const {
+template <typename K, typename T, typename Allocator>
+typename Btree<K, T, Allocator>::Iterator Btree<K, T, Allocator>::end() const {
     Iterator last;
     if (root_ != nullptr) {
         last.iter_ = nullptr;
@@ -237,30 +488,31 @@ typename Btree<K, T>::Iterator Btree<K, T>::end() const {
     return last;
 }
 
-template <typename K, typename T>
-void Btree<K, T>::Iterator::operator++() {
+template <typename K, typename T, typename Allocator>
+void Btree<K, T, Allocator>::Iterator::operator++() {
     if (iter_ != nullptr) iter_ = iter_->nextNode();
 }
 
-template <typename K, typename T>
-void Btree<K, T>::Iterator::operator--() {
+template <typename K, typename T, typename Allocator>
+void Btree<K, T, Allocator>::Iterator::operator--() {
     if (iter_->prevNode()) iter_ = iter_->prevNode();
 }
 
-template <typename K, typename T>
-bool Btree<K, T>::Iterator::operator==(const Iterator &other) {
+template <typename K, typename T, typename Allocator>
+bool Btree<K, T, Allocator>::Iterator::operator==(const Iterator &other) {
     return (this->iter_ == other.iter_) ? true : false;
 }
 
-template <typename K, typename T>
-bool Btree<K, T>::Iterator::operator!=(const Iterator &other) {
+template <typename K, typename T, typename Allocator>
+bool Btree<K, T, Allocator>::Iterator::operator!=(const Iterator &other) {
     return (this->iter_ != other.iter_) ? true : false;
 }
 
-template <typename K, typename T>
-typename Btree<K, T>::value_type Btree<K, T>::Iterator::operator*() {
+template <typename K, typename T, typename Allocator>
+typename Btree<K, T, Allocator>::value_type &
+Btree<K, T, Allocator>::Iterator::operator*() {
     if (iter_ == nullptr) throw std::out_of_range("Error! is not be a nullptr");
-    return *iter_->data;
+    return iter_->data;
 }
 
 };  // namespace stl
@@ -1,14 +1,24 @@
 #ifndef SRC_BTREE_H_
 #define SRC_BTREE_H_
 
+#include <algorithm>
 #include <iomanip>
 #include <iostream>
+#include <limits>
+#include <memory>
+#include <type_traits>
+#include <vector>
 
+#include "slab_allocator.h"
 #include "treeNode.h"
 
 namespace stl {
 
-template <typename K, typename T>
+// Allocator hands out the nodes, with the key/value pair stored inline.
+// The default slab allocator makes clear() and the destructor give the
+// memory back in whole slabs instead of one free per node.
+template <typename K, typename T,
+          typename Allocator = SlabAllocator<treeNode<K, T>>>
 class Btree {
    public:
     using map_type = T;
@@ -17,10 +27,14 @@ class Btree {
     using value_type = std::pair<K, T>;
     using size_type = size_t;
     using Node = treeNode<K, T>;
+    using allocator_type = Allocator;
 
    protected:
+    using node_traits = std::allocator_traits<Allocator>;
+
     Node *root_;
     size_type size_;
+    Allocator allocator_;
 
    public:
     class Iterator {
@@ -35,21 +49,34 @@ class Btree {
         void operator--();
         bool operator==(const Iterator &other);
         bool operator!=(const Iterator &other);
-        value_type operator*();
+        value_type &operator*();
     };
 
     using iterator = Iterator;
 
    protected:
     std::pair<iterator, bool> search(const_reference_key key);
+    static bool isRed(const Node *node) {
+        return node != nullptr && node->color == Color::RED;
+    }
+    void rotateLeft(Node *node);
+    void rotateRight(Node *node);
+    void transplant(Node *node, Node *child);
+    void insertFixup(Node *node);
+    void eraseFixup(Node *node, Node *parent);
+    size_type height(const Node *node) const;
+    template <typename... Args>
+    Node *createNode(Args &&...args);
+    Node *buildSorted(value_type *items, size_type count, Node *parent,
+                      size_type depth, size_type red_depth);
 
    public:
     //             Constructor & Destructor
 
     Btree() : size_(0), root_(nullptr) {}
     Btree(const std::initializer_list<K> &items);
-    Btree(const Btree<K, T> &other);
-    Btree<K, T> &operator=(Btree<K, T> &&other);
+    Btree(const Btree &other);
+    Btree &operator=(Btree &&other);
     ~Btree();
 
     // iterators
@@ -60,7 +87,14 @@ class Btree {
     //             methods
 
     iterator insert(const_reference_key &value);
+    iterator insert(K &&value);
     void erase(iterator pos);
+    // A node taken out by extract must go back in through reinsert or be
+    // handed to destroyNode.
+    Node *extract(iterator pos);
+    iterator reinsert(Node *node);
+    void destroyNode(Node *node);
+    void assignSorted(std::vector<value_type> &&items);
     void print(Node *root);
     void printTree(Node *elm, int depth);
     Node *getRoot() { return this->root_; }
@@ -68,10 +102,16 @@ class Btree {
     void clean(Node *root);
     bool empty() const { return !(root_ != nullptr); }
     size_t size() const { return size_; }
+    size_t height() const { return height(root_); }
     size_t max_size();
     void copy(Node *root);
-    void swap(Btree<K, T> &other);
+    void swap(Btree &other);
     iterator find(const_reference_key key);
+    // First node whose key is not less than key, found in one descent.
+    iterator lower_bound(const_reference_key key) const;
+    // Cuts the tree into at most `parts` consecutive ranges of similar
+    // size: range i is [bounds[i], bounds[i + 1]), in key order.
+    std::vector<iterator> split(size_type parts) const;
     bool contains(const_reference_key key);
 };
 
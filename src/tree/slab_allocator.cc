@@ -0,0 +1,69 @@
+#include "slab_allocator.h"
+
+namespace stl {
+
+template <typename T>
+SlabAllocator<T>::SlabAllocator(SlabAllocator &&other) noexcept
+    : slabs_(std::move(other.slabs_)),
+      free_(other.free_),
+      next_(other.next_),
+      end_(other.end_) {
+    other.slabs_.clear();
+    other.free_ = other.next_ = other.end_ = nullptr;
+}
+
+template <typename T>
+SlabAllocator<T> &SlabAllocator<T>::operator=(SlabAllocator &&other) noexcept {
+    if (this == &other) return *this;
+    slabs_ = std::move(other.slabs_);
+    free_ = other.free_;
+    next_ = other.next_;
+    end_ = other.end_;
+    other.slabs_.clear();
+    other.free_ = other.next_ = other.end_ = nullptr;
+    return *this;
+}
+
+template <typename T>
+T *SlabAllocator<T>::allocate(std::size_t count) {
+    if (count != 1)
+        return static_cast<T *>(::operator new(count * sizeof(T)));
+    Slot *slot = free_;
+    if (slot != nullptr) {
+        free_ = slot->next;
+    } else {
+        if (next_ == end_) addSlab();
+        slot = next_++;
+    }
+    return reinterpret_cast<T *>(slot->storage);
+}
+
+template <typename T>
+void SlabAllocator<T>::deallocate(T *object, std::size_t count) {
+    if (count != 1) {
+        ::operator delete(object);
+        return;
+    }
+    Slot *slot = reinterpret_cast<Slot *>(object);
+    slot->next = free_;
+    free_ = slot;
+}
+
+template <typename T>
+void SlabAllocator<T>::release() {
+    slabs_.clear();
+    free_ = next_ = end_ = nullptr;
+}
+
+template <typename T>
+void SlabAllocator<T>::addSlab() {
+    const auto last = static_cast<std::size_t>(
+        slabs_.empty() ? 0 : end_ - slabs_.back().get());
+    const std::size_t size =
+        slabs_.empty() ? kFirstSlab : std::min(kMaxSlab, last * 2);
+    slabs_.emplace_back(new Slot[size]);
+    next_ = slabs_.back().get();
+    end_ = next_ + size;
+}
+
+};  // namespace stl
@@ -0,0 +1,54 @@
+#ifndef SRC_SLAB_ALLOCATOR_H_
+#define SRC_SLAB_ALLOCATOR_H_
+
+#include <algorithm>
+#include <cstddef>
+#include <memory>
+#include <new>
+#include <vector>
+
+namespace stl {
+
+// Allocator for one object at a time, meant for tree nodes. Objects are cut
+// from slabs that double in size up to kMaxSlab objects, freed objects are
+// kept on a free list for reuse, and the slabs themselves go back to the
+// system only in release() or the destructor, all at once. A copy starts
+// out empty, since the objects belong to the allocator that made them.
+template <typename T>
+class SlabAllocator {
+   public:
+    using value_type = T;
+
+    SlabAllocator() : free_(nullptr), next_(nullptr), end_(nullptr) {}
+    SlabAllocator(const SlabAllocator &) : SlabAllocator() {}
+    SlabAllocator(SlabAllocator &&other) noexcept;
+    SlabAllocator &operator=(const SlabAllocator &other) = delete;
+    SlabAllocator &operator=(SlabAllocator &&other) noexcept;
+    ~SlabAllocator() = default;
+
+    T *allocate(std::size_t count);
+    void deallocate(T *object, std::size_t count);
+    // Drops every slab; the objects in them must be destroyed already.
+    void release();
+
+   private:
+    static constexpr std::size_t kFirstSlab = 64;
+    static constexpr std::size_t kMaxSlab = std::size_t{1} << 16;
+
+    union Slot {
+        Slot *next;
+        alignas(T) unsigned char storage[sizeof(T)];
+    };
+
+    void addSlab();
+
+    std::vector<std::unique_ptr<Slot[]>> slabs_;
+    Slot *free_;
+    Slot *next_;
+    Slot *end_;
+};
+
+};  // namespace stl
+
+#include "slab_allocator.cc"
+#endif  // SRC_SLAB_ALLOCATOR_H_
@@ -1,99 +1,114 @@
 namespace stl {
 
-template <typename K, typename T>
-map<K, T>::map(map<K, T> &&other) {
+template <typename K, typename T, typename Allocator>
+map<K, T, Allocator>::map(map<K, T, Allocator> &&other) {
     *this = std::move(other);
 }
 
-template <typename K, typename T>
-map<K, T>::map(const map<K, T> &other) {
-    for (auto value : other) insert(value);
+template <typename K, typename T, typename Allocator>
+map<K, T, Allocator>::map(const map<K, T, Allocator> &other) {
+    for (const auto &value : other) insert(value);
 }
 
-template <typename K, typename T>
-map<K, T>::map(std::initializer_list<value_type> const &items) {
+template <typename K, typename T, typename Allocator>
+map<K, T, Allocator>::map(std::initializer_list<value_type> const &items) {
     for (auto &item : items) insert(item);
 }
 
-template <typename K, typename T>
-map<K, T> &map<K, T>::operator=(map<K, T> &&other) {
-    if (this->root_ != nullptr) this->clear();
-    this->root_ = other.root_;
-    this->size_ = other.size_;
-    other.root_ = nullptr;
-    other.size_ = 0;
+template <typename K, typename T, typename Allocator>
+map<K, T, Allocator> &map<K, T, Allocator>::operator=(
+    map<K, T, Allocator> &&other) {
+    Btree<K, T, Allocator>::operator=(std::move(other));
     return *this;
 }
 
-template <typename K, typename T>
-typename map<K, T>::const_reference_value map<K, T>::operator[](
-    const_reference_key key) {
-    auto result = Btree<K, T>::search(key);
-    return result.first.iter_->data->second;
+template <typename K, typename T, typename Allocator>
+typename map<K, T, Allocator>::const_reference_value
+map<K, T, Allocator>::operator[](const_reference_key key) {
+    auto result = Btree<K, T, Allocator>::search(key);
+    return result.first.iter_->data.second;
 }
 
-template <typename K, typename T>
-typename map<K, T>::const_reference_value map<K, T>::at(
+template <typename K, typename T, typename Allocator>
+typename map<K, T, Allocator>::const_reference_value map<K, T, Allocator>::at(
     const_reference_key key) {
     if (!this->search(key).second) throw std::out_of_range("ERROR!");
     return (*this)[key];
 }
 
-template <typename K, typename T>
-typename map<K, T>::iteratorMap map<K, T>::begin() const {
+template <typename K, typename T, typename Allocator>
+typename map<K, T, Allocator>::iteratorMap map<K, T, Allocator>::begin() const {
     iteratorMap it;
     if (this->root_ != nullptr) it.iter_ = this->root_->minimalNode();
     return it;
 }
 
-template <typename K, typename T>
-typename map<K, T>::iteratorMap map<K, T>::end() const {
+template <typename K, typename T, typename Allocator>
+typename map<K, T, Allocator>::iteratorMap map<K, T, Allocator>::end() const {
     iteratorMap it;
     if (this->root_ != nullptr) it.iter_ = nullptr;
     return it;
 }
 
-template <typename K, typename T>
-typename map<K, T>::value_type map<K, T>::iteratorMap::operator*() {
+template <typename K, typename T, typename Allocator>
+typename map<K, T, Allocator>::value_type &
+map<K, T, Allocator>::iteratorMap::operator*() {
     if (this->iter_ == nullptr)
         throw std::invalid_argument("Error pointer is not be nullptr");
-    return this->operator*();
+    return iterator::operator*();
+}
+
+template <typename K, typename T, typename Allocator>
+std::pair<typename map<K, T, Allocator>::iterator, bool>
+map<K, T, Allocator>::insert(const_reference_key key,
+                             const_reference_value obj) {
+    std::pair<iterator, bool> result = Btree<K, T, Allocator>::search(key);
+    if (result.second) {
+        result.second = false;
+    } else {
+        result.first = this->reinsert(this->createNode(key, obj));
+        result.second = true;
+    }
+    return result;
 }
 
-template <typename K, typename T>
-std::pair<typename map<K, T>::iterator, bool> map<K, T>::insert(
-    const_reference_key key, const_reference_value obj) {
-    std::pair<iterator, bool> result = Btree<K, T>::search(key);
-    if (!this->contains(key)) {
-        result.first = Btree<K, T>::insert(key);
-        result.first.iter_->data->second = obj;
+template <typename K, typename T, typename Allocator>
+std::pair<typename map<K, T, Allocator>::iterator, bool>
+map<K, T, Allocator>::insert(key_type &&key, map_type &&obj) {
+    std::pair<iterator, bool> result = Btree<K, T, Allocator>::search(key);
+    if (result.second) {
+        result.second = false;
+    } else {
+        result.first =
+            this->reinsert(this->createNode(std::move(key), std::move(obj)));
         result.second = true;
     }
     return result;
 }
 
-template <typename K, typename T>
-std::pair<typename map<K, T>::iterator, bool> map<K, T>::insert_or_assign(
-    const_reference_key key, const_reference_value obj) {
+template <typename K, typename T, typename Allocator>
+std::pair<typename map<K, T, Allocator>::iterator, bool>
+map<K, T, Allocator>::insert_or_assign(const_reference_key key,
+                                       const_reference_value obj) {
     auto result = this->search(key);
-    if (!result.second) result.first = Btree<K, T>::insert(key);
-    result.first.iter_->data->second = obj;
+    if (!result.second) result.first = Btree<K, T, Allocator>::insert(key);
+    result.first.iter_->data.second = obj;
     result.second = !result.second;
     return result;
 }
 
-template <typename K, typename T>
-void map<K, T>::merge(map &other) {
+template <typename K, typename T, typename Allocator>
+void map<K, T, Allocator>::merge(map &other) {
     for (auto it = other.begin(); it != other.end(); ++it) {
         insert(*it);
     }
     other.clear();
 }
 
-template <typename K, typename T>
+template <typename K, typename T, typename Allocator>
 template <typename... Args>
-std::pair<typename map<K, T>::iterator, bool> map<K, T>::emplace(
-    Args &&...args) {
+std::pair<typename map<K, T, Allocator>::iterator, bool>
+map<K, T, Allocator>::emplace(Args &&...args) {
     std::pair<iterator, bool> result{nullptr, true};
     std::pair<K, T> items[] = {args...};
     for (std::pair<key_type, map_type> &item : items) {
@@ -4,8 +4,9 @@
 #include "btree.h"
 
 namespace stl {
-template <typename K, typename T>
-class map : public Btree<K, T> {
+template <typename K, typename T,
+          typename Allocator = SlabAllocator<treeNode<K, T>>>
+class map : public Btree<K, T, Allocator> {
    public:
     using map_type = T;
     using key_type = K;
@@ -14,32 +15,36 @@ class map : public Btree<K, T> {
     using value_type = std::pair<K, T>;
     using const_reference = const value_type &;
     using size_type = size_t;
-    using iterator = typename Btree<K, T>::Iterator;
+    using iterator = typename Btree<K, T, Allocator>::Iterator;
     using Node = treeNode<K, T>;
 
     class iteratorMap : public iterator {
        public:
         iteratorMap() : iterator::Iterator() {}
-        value_type operator*();
+        value_type &operator*();
     };
 
     iteratorMap begin() const;
     iteratorMap end() const;
 
-    map() : Btree<K, T>::Btree() {}
-    map(map<K, T> &&other);
-    explicit map(const map<K, T> &other);
+    map() : Btree<K, T, Allocator>::Btree() {}
+    map(map<K, T, Allocator> &&other);
+    explicit map(const map<K, T, Allocator> &other);
     explicit map(std::initializer_list<value_type> const &items);
-    map<K, T> &operator=(map<K, T> &&other);
+    map<K, T, Allocator> &operator=(map<K, T, Allocator> &&other);
     ~map() {}
 
     std::pair<iterator, bool> insert(const_reference_key key,
                                      const_reference_value obj);
+    std::pair<iterator, bool> insert(key_type &&key, map_type &&obj);
     std::pair<iterator, bool> insert(const_reference value) {
         return insert(value.first, value.second);
     }
+    std::pair<iterator, bool> insert(value_type &&value) {
+        return insert(std::move(value.first), std::move(value.second));
+    }
     std::pair<iterator, bool> search(const_reference_key key) {
-        return Btree<K, T>::search(key);
+        return Btree<K, T, Allocator>::search(key);
     }
     const_reference_value operator[](const_reference_key key);
     const_reference_value at(const_reference_key key);
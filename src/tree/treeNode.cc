@@ -5,6 +5,7 @@ namespace stl {
 template <typename K, typename T>
 treeNode<K, T> &treeNode<K, T>::operator=(const treeNode<K, T> &other) {
     data = other.data;
+    color = other.color;
     parent = other.parent;
     left = other.left;
     right = other.right;
@@ -32,39 +33,25 @@ treeNode<K, T> *treeNode<K, T>::maximalNode() {
 template <typename K, typename T>
 treeNode<K, T> *treeNode<K, T>::nextNode() {
     treeNode<K, T> *p = this;
-    if (p->right) {
-        return p->right->minimalNode();
-    } else if (p == p->parent->left && p->parent->left) {
-        return p->parent;
-    } else {
-        treeNode *q = p->parent;
-        if (q->parent == nullptr) return nullptr;
-        while (p == q->right) {
-            p = q;
-            if (q->parent == nullptr) return nullptr;
-            q = q->parent;
-        }
-        return q;
+    if (p->right) return p->right->minimalNode();
+    treeNode<K, T> *q = p->parent;
+    while (q != nullptr && p == q->right) {
+        p = q;
+        q = q->parent;
     }
+    return q;
 }
 
 template <typename K, typename T>
 treeNode<K, T> *treeNode<K, T>::prevNode() {
     treeNode<K, T> *p = this;
-    if (p->left) {
-        return p->left->maximalNode();
-    } else if (p == p->parent->right) {
-        return p->parent;
-    } else {
-        treeNode<K, T> *q = p->parent;
-        if (q->parent == nullptr) return nullptr;
-        while (p == q->left) {
-            p = q;
-            if (q->parent == nullptr) return nullptr;
-            q = q->parent;
-        }
-        return q;
+    if (p->left) return p->left->maximalNode();
+    treeNode<K, T> *q = p->parent;
+    while (q != nullptr && p == q->left) {
+        p = q;
+        q = q->parent;
     }
+    return q;
 }
 
 };  //  namespace stl
@@ -2,27 +2,30 @@
 #define SRC_TREENODE_H_
 
 #include <iostream>
+#include <utility>
 
 namespace stl {
 
+enum class Color { RED, BLACK };
+
 template <typename K, typename T>
 class treeNode {
    public:
     treeNode *right;
     treeNode *left;
     treeNode *parent;
-    std::pair<K, T> *data;
-
-    treeNode() : right(nullptr), left(nullptr), parent(nullptr) {
-        data = new std::pair<K, T>;
-    }
+    std::pair<K, T> data;
+    Color color;
+
+    template <typename... Args>
+    explicit treeNode(Args &&...args)
+        : right(nullptr),
+          left(nullptr),
+          parent(nullptr),
+          data(std::forward<Args>(args)...),
+          color(Color::RED) {}
     treeNode(const treeNode<K, T> &other) : treeNode() { *this = other; }
-    ~treeNode() {
-        if (data) {
-            delete data;
-            data = nullptr;
-        }
-    }
+    ~treeNode() = default;
 
     treeNode &operator=(const treeNode<K, T> &other);
 
@@ -0,0 +1,368 @@
+#include "write_ahead_log.h"
+
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <stdexcept>
+
+#include "mapped_file.h"
+#include "snapshot.h"
+
+namespace storage {
+
+namespace {
+
+constexpr char kMagic[8] = {'K', 'V', 'W', 'A', 'L', '\0', '\0', '\0'};
+constexpr std::uint32_t kVersion = 1;
+constexpr std::size_t kHeaderSize =
+    sizeof(kMagic) + 2 * sizeof(std::uint32_t);
+constexpr std::size_t kEntryHeaderSize = 2 * sizeof(std::uint32_t);
+
+enum UpdateField : std::uint8_t {
+    kSurname = 1 << 0,
+    kName = 1 << 1,
+    kBirthYear = 1 << 2,
+    kCity = 1 << 3,
+    kCountCoins = 1 << 4,
+    kExpiry = 1 << 5
+};
+
+template <typename Number>
+void Put(std::string &out, Number number) {
+    out.append(reinterpret_cast<const char *>(&number), sizeof(number));
+}
+
+void PutString(std::string &out, std::string_view text) {
+    Put(out, static_cast<std::uint32_t>(text.size()));
+    out.append(text);
+}
+
+template <typename Number>
+bool Take(std::string_view &in, Number &number) {
+    if (in.size() < sizeof(number)) return false;
+    std::memcpy(&number, in.data(), sizeof(number));
+    in.remove_prefix(sizeof(number));
+    return true;
+}
+
+bool TakeString(std::string_view &in, std::string &text) {
+    std::uint32_t length;
+    if (!Take(in, length) || in.size() < length) return false;
+    text.assign(in.data(), length);
+    in.remove_prefix(length);
+    return true;
+}
+
+void WriteFully(int fd, const char *data, std::size_t size) {
+    while (size > 0) {
+        const ssize_t written = write(fd, data, size);
+        if (written < 0) {
+            if (errno == EINTR) continue;
+            throw std::invalid_argument("File Error!");
+        }
+        data += written;
+        size -= static_cast<std::size_t>(written);
+    }
+}
+
+}  // namespace
+
+std::string LogEntry::EncodeSet(const key_t &key, const Data &value) {
+    std::string out;
+    Put(out, LogOp::kSet);
+    PutString(out, key);
+    PutString(out, value.GetSurname());
+    PutString(out, value.GetName());
+    Put(out, static_cast<std::int32_t>(value.GetBirthYear()));
+    PutString(out, value.GetCity());
+    Put(out, static_cast<std::int64_t>(value.GetCountCoins()));
+    const auto expiry = value.GetTimeLife();
+    Put(out, static_cast<std::uint8_t>(expiry.has_value()));
+    Put(out, static_cast<std::int64_t>(expiry.value_or(0)));
+    return out;
+}
+
+std::string LogEntry::EncodeUpdate(const key_t &key,
+                                   const OptionalData &update) {
+    std::string out;
+    Put(out, LogOp::kUpdate);
+    PutString(out, key);
+    std::uint8_t fields = 0;
+    if (update.surname) fields |= kSurname;
+    if (update.name) fields |= kName;
+    if (update.birth_year) fields |= kBirthYear;
+    if (update.city) fields |= kCity;
+    if (update.count_coins) fields |= kCountCoins;
+    if (update.expiry_time) fields |= kExpiry;
+    Put(out, fields);
+    if (update.surname) PutString(out, *update.surname);
+    if (update.name) PutString(out, *update.name);
+    if (update.birth_year)
+        Put(out, static_cast<std::int32_t>(*update.birth_year));
+    if (update.city) PutString(out, *update.city);
+    if (update.count_coins)
+        Put(out, static_cast<std::int64_t>(*update.count_coins));
+    if (update.expiry_time)
+        Put(out, static_cast<std::int64_t>(
+                     Data::Now() + static_cast<long>(*update.expiry_time)));
+    return out;
+}
+
+std::string LogEntry::EncodeDel(const key_t &key) {
+    std::string out;
+    Put(out, LogOp::kDel);
+    PutString(out, key);
+    return out;
+}
+
+std::string LogEntry::EncodeRename(const key_t &old_key,
+                                   const key_t &new_key) {
+    std::string out;
+    Put(out, LogOp::kRename);
+    PutString(out, old_key);
+    PutString(out, new_key);
+    return out;
+}
+
+bool LogEntry::Decode(std::string_view payload, LogEntry &entry) {
+    if (!Take(payload, entry.op) || !TakeString(payload, entry.key))
+        return false;
+    entry.expiry.reset();
+    switch (entry.op) {
+        case LogOp::kSet: {
+            std::string surname, name, city;
+            std::int32_t birth_year;
+            std::int64_t count_coins, expiry;
+            std::uint8_t has_expiry;
+            if (!TakeString(payload, surname) || !TakeString(payload, name) ||
+                !Take(payload, birth_year) || !TakeString(payload, city) ||
+                !Take(payload, count_coins) || !Take(payload, has_expiry) ||
+                !Take(payload, expiry))
+                return false;
+            entry.value = Data(std::move(surname), std::move(name), birth_year,
+                               std::move(city), static_cast<long>(count_coins));
+            if (has_expiry)
+                entry.value.SetExpiryTime(static_cast<long>(expiry));
+            return true;
+        }
+        case LogOp::kUpdate: {
+            std::uint8_t fields;
+            if (!Take(payload, fields)) return false;
+            entry.update = OptionalData();
+            std::string text;
+            std::int32_t birth_year;
+            std::int64_t number;
+            if (fields & kSurname) {
+                if (!TakeString(payload, text)) return false;
+                entry.update.surname = text;
+            }
+            if (fields & kName) {
+                if (!TakeString(payload, text)) return false;
+                entry.update.name = text;
+            }
+            if (fields & kBirthYear) {
+                if (!Take(payload, birth_year)) return false;
+                entry.update.birth_year = birth_year;
+            }
+            if (fields & kCity) {
+                if (!TakeString(payload, text)) return false;
+                entry.update.city = text;
+            }
+            if (fields & kCountCoins) {
+                if (!Take(payload, number)) return false;
+                entry.update.count_coins = static_cast<long>(number);
+            }
+            if (fields & kExpiry) {
+                if (!Take(payload, number)) return false;
+                entry.expiry = static_cast<long>(number);
+            }
+            return true;
+        }
+        case LogOp::kDel:
+            return true;
+        case LogOp::kRename:
+            return TakeString(payload, entry.new_key);
+    }
+    return false;
+}
+
+WriteAheadLog::WriteAheadLog(const std::string &filename, WalOptions options)
+    : filename_(filename),
+      options_(options),
+      fd_(-1),
+      appended_(0),
+      durable_(0),
+      flush_requested_(false),
+      stopping_(false),
+      failed_(false) {
+    Open();
+    flusher_ = std::thread([this] { Run(); });
+}
+
+WriteAheadLog::~WriteAheadLog() {
+    {
+        std::lock_guard lock(mutex_);
+        stopping_ = true;
+    }
+    wake_.notify_all();
+    flusher_.join();
+    if (fd_ >= 0) close(fd_);
+}
+
+void WriteAheadLog::Open() {
+    fd_ = open(filename_.c_str(), O_WRONLY | O_APPEND);
+    if (fd_ < 0) throw std::invalid_argument("File Error!");
+}
+
+void WriteAheadLog::Create(const std::string &filename,
+                           std::uint32_t generation) {
+    const std::string temp_filename = filename + ".tmp";
+    const int fd =
+        open(temp_filename.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0) throw std::invalid_argument("File Error!");
+    char header[kHeaderSize];
+    std::memcpy(header, kMagic, sizeof(kMagic));
+    std::memcpy(header + sizeof(kMagic), &kVersion, sizeof(kVersion));
+    std::memcpy(header + sizeof(kMagic) + sizeof(kVersion), &generation,
+                sizeof(generation));
+    bool written = true;
+    try {
+        WriteFully(fd, header, sizeof(header));
+    } catch (const std::invalid_argument &) {
+        written = false;
+    }
+    written = fsync(fd) == 0 && written;
+    close(fd);
+    if (!written ||
+        std::rename(temp_filename.c_str(), filename.c_str()) != 0) {
+        std::remove(temp_filename.c_str());
+        throw std::invalid_argument("File Error!");
+    }
+}
+
+std::optional<std::uint32_t> WriteAheadLog::Replay(
+    const std::string &filename, std::uint32_t generation,
+    const std::function<void(LogEntry &)> &apply, unsigned int &applied) {
+    applied = 0;
+    if (access(filename.c_str(), F_OK) != 0) return std::nullopt;
+    std::size_t intact;
+    std::uint32_t log_generation;
+    {
+        MappedFile file(filename);
+        const char *data = file.Data();
+        const std::size_t size = file.Size();
+        if (size < kHeaderSize || std::memcmp(data, kMagic, sizeof(kMagic)) ||
+            std::memcmp(data + sizeof(kMagic), &kVersion, sizeof(kVersion)))
+            throw std::invalid_argument("Log Error!");
+        std::memcpy(&log_generation,
+                    data + sizeof(kMagic) + sizeof(kVersion),
+                    sizeof(log_generation));
+        if (log_generation != generation) return log_generation;
+        LogEntry entry;
+        intact = kHeaderSize;
+        while (size - intact >= kEntryHeaderSize) {
+            std::uint32_t length, crc;
+            std::memcpy(&length, data + intact, sizeof(length));
+            std::memcpy(&crc, data + intact + sizeof(length), sizeof(crc));
+            const char *payload = data + intact + kEntryHeaderSize;
+            if (size - intact - kEntryHeaderSize < length ||
+                Crc32(payload, length) != crc ||
+                !LogEntry::Decode(std::string_view(payload, length), entry))
+                break;
+            apply(entry);
+            ++applied;
+            intact += kEntryHeaderSize + length;
+        }
+        if (intact == size) return log_generation;
+    }
+    // Whatever follows the last intact entry is the remains of a write cut
+    // short by a crash; new entries must not land behind it.
+    if (truncate(filename.c_str(), static_cast<off_t>(intact)) != 0)
+        throw std::invalid_argument("File Error!");
+    return log_generation;
+}
+
+std::uint64_t WriteAheadLog::Append(std::string_view entry) {
+    std::uint64_t sequence;
+    {
+        std::lock_guard lock(mutex_);
+        Put(pending_, static_cast<std::uint32_t>(entry.size()));
+        Put(pending_, Crc32(entry.data(), entry.size()));
+        pending_.append(entry);
+        sequence = ++appended_;
+    }
+    if (options_.sync != SyncPolicy::kInterval) wake_.notify_one();
+    return sequence;
+}
+
+void WriteAheadLog::WaitDurable(std::uint64_t sequence) {
+    if (options_.sync != SyncPolicy::kAlways) return;
+    std::unique_lock lock(mutex_);
+    durable_changed_.wait(lock,
+                          [&] { return durable_ >= sequence || failed_; });
+    if (failed_) throw std::invalid_argument("File Error!");
+}
+
+void WriteAheadLog::Sync() {
+    std::unique_lock lock(mutex_);
+    const std::uint64_t target = appended_;
+    flush_requested_ = true;
+    wake_.notify_one();
+    durable_changed_.wait(lock, [&] { return durable_ >= target || failed_; });
+    if (failed_) throw std::invalid_argument("File Error!");
+}
+
+void WriteAheadLog::Reset(std::uint32_t generation,
+                          const std::string &keep_as) {
+    Sync();
+    std::lock_guard lock(mutex_);
+    if (!keep_as.empty() &&
+        std::rename(filename_.c_str(), keep_as.c_str()) != 0)
+        throw std::invalid_argument("File Error!");
+    close(fd_);
+    fd_ = -1;
+    Create(filename_, generation);
+    Open();
+}
+
+void WriteAheadLog::Run() {
+    std::unique_lock lock(mutex_);
+    for (;;) {
+        auto ready = [this] {
+            return stopping_ || flush_requested_ ||
+                   (options_.sync != SyncPolicy::kInterval &&
+                    !pending_.empty());
+        };
+        if (options_.sync == SyncPolicy::kInterval)
+            wake_.wait_for(lock, options_.interval, ready);
+        else
+            wake_.wait(lock, ready);
+        const bool stop = stopping_;
+        std::string batch;
+        batch.swap(pending_);
+        const std::uint64_t last = appended_;
+        const int fd = fd_;
+        flush_requested_ = false;
+        lock.unlock();
+        bool ok = true;
+        if (!batch.empty()) {
+            try {
+                WriteFully(fd, batch.data(), batch.size());
+            } catch (const std::invalid_argument &) {
+                ok = false;
+            }
+            if (ok && options_.sync != SyncPolicy::kNone)
+                ok = fdatasync(fd) == 0;
+        }
+        lock.lock();
+        if (!ok) failed_ = true;
+        durable_ = last;
+        durable_changed_.notify_all();
+        if (stop && pending_.empty()) return;
+    }
+}
+
+}  // namespace storage
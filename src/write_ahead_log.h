@@ -0,0 +1,99 @@
+#pragma once
+
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <thread>
+
+#include "data.h"
+
+namespace storage {
+
+enum class SyncPolicy {
+    kAlways,    // an operation returns once its entry is on disk
+    kInterval,  // entries are written and synced every interval
+    kNone       // entries are written as they come, the OS decides when
+                // they reach the disk
+};
+
+struct WalOptions {
+    SyncPolicy sync = SyncPolicy::kAlways;
+    std::chrono::milliseconds interval{1000};
+};
+
+enum class LogOp : std::uint8_t { kSet = 1, kUpdate, kDel, kRename };
+
+// One logged mutation. Expiry is kept as an absolute time so replaying an
+// entry later does not extend the record's life.
+struct LogEntry {
+    LogOp op;
+    key_t key;
+    key_t new_key;
+    Data value;
+    OptionalData update;
+    std::optional<long> expiry;
+
+    static std::string EncodeSet(const key_t &key, const Data &value);
+    static std::string EncodeUpdate(const key_t &key,
+                                    const OptionalData &update);
+    static std::string EncodeDel(const key_t &key);
+    static std::string EncodeRename(const key_t &old_key,
+                                    const key_t &new_key);
+    static bool Decode(std::string_view payload, LogEntry &entry);
+};
+
+// Append-only log file:
+//   header  "KVWAL\0\0\0", uint32 version, uint32 generation
+//   entries uint32 payload size, uint32 CRC-32 of payload, payload
+// Appends go to an in-memory buffer and a background thread writes the
+// buffer out, so every entry that arrived while the previous write and
+// fsync were running shares the next one (group commit).
+class WriteAheadLog {
+   public:
+    WriteAheadLog(const std::string &filename, WalOptions options);
+    WriteAheadLog(const WriteAheadLog &other) = delete;
+    WriteAheadLog &operator=(const WriteAheadLog &other) = delete;
+    ~WriteAheadLog();
+
+    std::uint64_t Append(std::string_view entry);
+    void WaitDurable(std::uint64_t sequence);
+    void Sync();
+    // Starts the log over with an empty file of the given generation. The
+    // current file is renamed to keep_as when that is given, and dropped
+    // otherwise.
+    void Reset(std::uint32_t generation,
+               const std::string &keep_as = std::string());
+
+    static void Create(const std::string &filename, std::uint32_t generation);
+    // Applies every intact entry of an existing log of the given generation
+    // and cuts off a torn tail. A log of another generation is left alone.
+    // Returns the log's generation, or nothing if there is no log.
+    static std::optional<std::uint32_t> Replay(
+        const std::string &filename, std::uint32_t generation,
+        const std::function<void(LogEntry &)> &apply, unsigned int &applied);
+
+   private:
+    void Run();
+    void Open();
+
+    std::string filename_;
+    WalOptions options_;
+    int fd_;
+    std::string pending_;
+    std::uint64_t appended_;
+    std::uint64_t durable_;
+    bool flush_requested_;
+    bool stopping_;
+    bool failed_;
+    std::mutex mutex_;
+    std::condition_variable wake_;
+    std::condition_variable durable_changed_;
+    std::thread flusher_;
+};
+
+}  // namespace storage